@@ -85,6 +85,12 @@ android {
         }
     }
 
+    // Stored uncompressed so the native synth can map the SoundFont from the APK
+    // (.tsfb: fonts baked by app/src/main/cpp/tools/soundfont_bake.cpp)
+    androidResources {
+        noCompress += listOf("sf2", "tsfb")
+    }
+
     packaging {
         resources {
             excludes += "/META-INF/{AL2.0,LGPL2.1}"
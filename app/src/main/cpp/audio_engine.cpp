@@ -1,11 +1,18 @@
 #include "audio_engine.h"
+#include "latency_stats.h"
 #include "pitch_detector.h"
+#include "spectrum_analyzer.h"
+#include "telemetry.h"
+#include "trace.h"
 #include <oboe/Oboe.h>
 #include <android/log.h>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <memory>
 #include <vector>
 #include <chrono>
+#include <time.h>
 
 #define LOG_TAG "AudioEngine"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -16,6 +23,16 @@ namespace musicsheetflow {
 // Buffer size for pitch detection (must match aubio initialization)
 static constexpr int PITCH_BUFFER_SIZE = 2048;
 
+// Telemetry spectrum range: piano fundamentals and their first overtones
+static constexpr float SPECTRUM_MIN_HZ = 50.0f;
+static constexpr float SPECTRUM_MAX_HZ = 8000.0f;
+
+// Stream xruns and latency are queried this often, in seconds
+static constexpr float STREAM_STATS_INTERVAL = 0.1f;
+
+// Smoothing of the per-callback analysis load
+static constexpr float LOAD_SMOOTHING = 0.1f;
+
 class AudioEngineImpl : public AudioEngine, public oboe::AudioStreamDataCallback {
 public:
     AudioEngineImpl() = default;
@@ -32,12 +49,16 @@ public:
 
         LOGI("Starting audio input stream...");
 
+        // Fixed-point builds capture 16-bit PCM so analysis never touches float
+        oboe::AudioFormat format = kUseFixedPointPitch
+            ? oboe::AudioFormat::I16 : oboe::AudioFormat::Float;
+
         // Build audio stream with explicit settings for real devices
         oboe::AudioStreamBuilder builder;
         builder.setDirection(oboe::Direction::Input)
                ->setPerformanceMode(oboe::PerformanceMode::LowLatency)
                ->setSharingMode(oboe::SharingMode::Exclusive)
-               ->setFormat(oboe::AudioFormat::Float)
+               ->setFormat(format)
                ->setChannelCount(oboe::ChannelCount::Mono)
                ->setSampleRate(44100)
                ->setDataCallback(this);
@@ -58,8 +79,9 @@ public:
 
         // Get actual sample rate
         sampleRate_ = stream_->getSampleRate();
-        LOGI("Stream opened: sampleRate=%d, framesPerBurst=%d",
-             sampleRate_, stream_->getFramesPerBurst());
+        LOGI("Stream opened: sampleRate=%d, framesPerBurst=%d, format=%s",
+             sampleRate_, stream_->getFramesPerBurst(),
+             oboe::convertToText(stream_->getFormat()));
 
         // Create pitch detector and apply pending settings
         pitchDetector_ = createPitchDetector(sampleRate_, PITCH_BUFFER_SIZE);
@@ -67,9 +89,16 @@ public:
             pitchDetector_->setConfidenceThreshold(pendingConfidenceThreshold_);
             pitchDetector_->setSilenceThreshold(pendingSilenceThreshold_);
         }
+        spectrum_ = std::make_unique<SpectrumAnalyzer>(
+            sampleRate_, PITCH_BUFFER_SIZE, TELEMETRY_SPECTRUM_BANDS, SPECTRUM_MIN_HZ, SPECTRUM_MAX_HZ);
+        statsCountdown_ = 0;
+        captureAnchorFrame_ = -1;
+        windowPeak_ = 0.0f;
+        analysisLoad_ = 0.0f;
 
         // Reserve buffer space
         audioBuffer_.reserve(PITCH_BUFFER_SIZE);
+        pcmBuffer_.reserve(PITCH_BUFFER_SIZE);
 
         result = stream_->requestStart();
         if (result != oboe::Result::OK) {
@@ -90,7 +119,9 @@ public:
             stream_.reset();
         }
         pitchDetector_.reset();
+        spectrum_.reset();
         audioBuffer_.clear();
+        pcmBuffer_.clear();
     }
 
     void setNoiseGateThreshold(float thresholdDb) override {
@@ -116,30 +147,106 @@ public:
         pendingSilenceThreshold_ = thresholdDb;
     }
 
+    void setSpectrumEnabled(bool enabled) override {
+        spectrumEnabled_.store(enabled, std::memory_order_relaxed);
+    }
+
     oboe::DataCallbackResult onAudioReady(
             oboe::AudioStream* stream,
             void* audioData,
             int32_t numFrames) override {
+        TRACE_SCOPE("Input callback");
+        auto begin = std::chrono::steady_clock::now();
+        callbackNs_ = std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count();
+        // AAudio counts this callback's frames as read before calling it
+        callbackEndFrame_ = stream->getFramesRead();
+        updateStreamStats(stream, numFrames);
+
+        if (stream->getFormat() == oboe::AudioFormat::I16) {
+            analyze(pcmBuffer_, static_cast<const int16_t*>(audioData), numFrames);
+        } else {
+            analyze(audioBuffer_, static_cast<const float*>(audioData), numFrames);
+        }
 
-        auto* data = static_cast<float*>(audioData);
+        // Published with the next window
+        auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin).count();
+        float load = elapsedNs * 1e-9f * sampleRate_ / std::max(numFrames, 1);
+        analysisLoad_ += (load - analysisLoad_) * LOAD_SMOOTHING;
 
-        // Add samples to buffer
-        for (int i = 0; i < numFrames; ++i) {
-            audioBuffer_.push_back(data[i]);
+        return oboe::DataCallbackResult::Continue;
+    }
+
+private:
+    static float toFloat(float sample) { return sample; }
+    static float toFloat(int16_t sample) { return sample * (1.0f / 32768.0f); }
+
+    // Xrun count and latency, a few times a second: the latency takes a
+    // stream timestamp, which is more than a callback should do every time
+    void updateStreamStats(oboe::AudioStream* stream, int32_t numFrames) {
+        statsCountdown_ -= numFrames;
+        if (statsCountdown_ > 0) {
+            return;
         }
+        statsCountdown_ = static_cast<int>(sampleRate_ * STREAM_STATS_INTERVAL);
+        auto xruns = stream->getXRunCount();
+        if (xruns) {
+            xruns_ = static_cast<uint32_t>(xruns.value());
+            TRACE_COUNTER("Input xruns", xruns_);
+        }
+        auto latency = stream->calculateLatencyMillis();
+        latencyMillis_ = latency ? static_cast<float>(latency.value()) : 0.0f;
+        auto timestamp = stream->getTimestamp(CLOCK_MONOTONIC);
+        if (timestamp) {
+            captureAnchorFrame_ = timestamp.value().position;
+            captureAnchorNs_ = timestamp.value().timestamp;
+        }
+    }
+
+    // When a frame of the stream reached the microphone. Without stream
+    // timestamps (OpenSL ES) this is when the callback got it, which leaves
+    // out the input latency.
+    int64_t captureTimeNs(int64_t frame) const {
+        if (captureAnchorFrame_ >= 0) {
+            return captureAnchorNs_ + (frame - captureAnchorFrame_) * 1000000000LL / sampleRate_;
+        }
+        return callbackNs_ - (callbackEndFrame_ - frame) * 1000000000LL / sampleRate_;
+    }
+
+    // Buffer incoming samples and run detection on each full window
+    template <typename Sample>
+    void analyze(std::vector<Sample>& buffer, const Sample* data, int32_t numFrames) {
+        for (int32_t i = 0; i < numFrames; ++i) {
+            windowPeak_ = std::max(windowPeak_, std::fabs(toFloat(data[i])));
+        }
+
+        // Add samples to buffer
+        buffer.insert(buffer.end(), data, data + numFrames);
 
         // Process when we have enough samples
-        while (audioBuffer_.size() >= PITCH_BUFFER_SIZE) {
+        while (buffer.size() >= PITCH_BUFFER_SIZE) {
             // Calculate RMS for noise gate
             float rms = 0.0f;
             for (int i = 0; i < PITCH_BUFFER_SIZE; ++i) {
-                rms += audioBuffer_[i] * audioBuffer_[i];
+                float sample = toFloat(buffer[i]);
+                rms += sample * sample;
             }
             rms = std::sqrt(rms / PITCH_BUFFER_SIZE);
 
+            auto windowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            // Samples after the window arrived with it, in the same callback
+            int64_t captureNs = captureTimeNs(
+                callbackEndFrame_ - static_cast<int64_t>(buffer.size() - PITCH_BUFFER_SIZE));
+            bool gateOpen = rms >= noiseGateThreshold_;
+            PitchResult result{0.0f, 0.0f, -1, 0};
+
             // Only process if above noise gate
-            if (rms >= noiseGateThreshold_ && pitchDetector_ && pitchCallback_) {
-                PitchResult result = pitchDetector_->detect(audioBuffer_.data(), PITCH_BUFFER_SIZE);
+            if (gateOpen && pitchDetector_ && pitchCallback_) {
+                {
+                    TRACE_SCOPE("Pitch detection");
+                    result = pitchDetector_->detect(buffer.data(), PITCH_BUFFER_SIZE);
+                }
 
                 if (result.midiNote >= 0) {
                     auto now = std::chrono::steady_clock::now();
@@ -151,28 +258,76 @@ public:
                         result.confidence,
                         result.midiNote,
                         result.centDeviation,
-                        timestampNs
+                        timestampNs,
+                        captureNs
                     };
+                    LatencyStats* latency = getLatencyStats();
+                    latency->record(LatencyStage::Buffering, windowNs - captureNs);
+                    latency->record(LatencyStage::Detection, timestampNs - windowNs);
                     pitchCallback_(event);
                 }
             }
+            publishWindow(buffer.data(), rms, gateOpen, result, windowNs);
 
             // Remove processed samples (with 50% overlap for better detection)
-            audioBuffer_.erase(audioBuffer_.begin(), audioBuffer_.begin() + PITCH_BUFFER_SIZE / 2);
+            buffer.erase(buffer.begin(), buffer.begin() + PITCH_BUFFER_SIZE / 2);
         }
+    }
 
-        return oboe::DataCallbackResult::Continue;
+    // One analysis window into the telemetry block
+    template <typename Sample>
+    void publishWindow(const Sample* window, float rms, bool gateOpen,
+                       const PitchResult& pitch, int64_t timestampNs) {
+        InputTelemetry& telemetry = getEngineTelemetry()->input;
+        bool spectrum = spectrum_ && spectrumEnabled_.load(std::memory_order_relaxed);
+        if (spectrum) {
+            // Into a local copy first: the FFT is too long to hold the seqlock
+            TRACE_SCOPE("Spectrum");
+            spectrum_->analyze(window, spectrumBands_);
+        }
+
+        EngineTelemetry::beginWrite(telemetry);
+        telemetry.gateOpen = gateOpen ? 1 : 0;
+        telemetry.rms = rms;
+        telemetry.peak = windowPeak_;
+        bool pitched = pitch.midiNote >= 0;
+        telemetry.frequency = pitched ? pitch.frequency : 0.0f;
+        telemetry.confidence = pitched ? pitch.confidence : 0.0f;
+        telemetry.analysisLoad = analysisLoad_;
+        telemetry.xruns = xruns_;
+        telemetry.latencyMillis = latencyMillis_;
+        telemetry.spectrumValid = spectrum ? 1 : 0;
+        telemetry.timestampNs = timestampNs;
+        if (spectrum) {
+            std::copy(std::begin(spectrumBands_), std::end(spectrumBands_), telemetry.spectrum);
+        }
+        EngineTelemetry::endWrite(telemetry);
+        windowPeak_ = 0.0f;
     }
 
-private:
     std::shared_ptr<oboe::AudioStream> stream_;
     std::unique_ptr<PitchDetector> pitchDetector_;
+    std::unique_ptr<SpectrumAnalyzer> spectrum_;
+    std::atomic<bool> spectrumEnabled_{false};
     std::vector<float> audioBuffer_;
+    std::vector<int16_t> pcmBuffer_;  // Used when capturing in AudioFormat::I16
     int sampleRate_ = 44100;
     float noiseGateThreshold_ = 0.005f;  // -46dB default (more sensitive)
     float pendingConfidenceThreshold_ = 0.3f;
     float pendingSilenceThreshold_ = -50.0f;
     PitchCallback pitchCallback_ = nullptr;
+
+    // Telemetry, audio thread only
+    float windowPeak_ = 0.0f;
+    float analysisLoad_ = 0.0f;
+    float latencyMillis_ = 0.0f;
+    uint32_t xruns_ = 0;
+    int statsCountdown_ = 0;
+    int64_t callbackNs_ = 0;         // When the current callback started
+    int64_t callbackEndFrame_ = 0;   // Stream frame after its last sample
+    int64_t captureAnchorFrame_ = -1;  // Last input timestamp, -1 if none yet
+    int64_t captureAnchorNs_ = 0;
+    float spectrumBands_[TELEMETRY_SPECTRUM_BANDS] = {};
 };
 
 // Singleton instance
@@ -11,7 +11,8 @@ struct PitchEvent {
     float confidence;      // 0.0-1.0
     int midiNote;          // 0-127
     int centDeviation;     // -50 to +50
-    int64_t timestampNs;   // System timestamp
+    int64_t timestampNs;   // System timestamp, when detection finished
+    int64_t captureNs;     // When the window's last sample reached the microphone
 };
 
 using PitchCallback = std::function<void(const PitchEvent&)>;
@@ -28,6 +29,10 @@ public:
     // Pitch detection settings
     virtual void setConfidenceThreshold(float threshold) = 0;
     virtual void setSilenceThreshold(float thresholdDb) = 0;
+
+    // Publish the input spectrum to the telemetry block (off by default;
+    // it costs an FFT per analysis window)
+    virtual void setSpectrumEnabled(bool enabled) = 0;
 };
 
 // Factory function - returns the singleton instance
@@ -1,7 +1,11 @@
 #include <jni.h>
 #include <android/log.h>
 #include "audio_engine.h"
+#include "latency_stats.h"
+#include "midi_engine.h"
 #include "pitch_detector.h"
+#include "telemetry.h"
+#include "trace.h"
 
 #define LOG_TAG "JNI_Bridge"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -17,8 +21,75 @@ static JavaVM* g_jvm = nullptr;
 static jobject g_callback = nullptr;
 static jmethodID g_onPitchDetected = nullptr;
 
+// @CriticalNative: Kotlin records the stages after the native callback
+// with it, once per pitch event
+static void recordLatency(jint stage, jlong nanos) {
+    if (stage >= 0 && stage < static_cast<jint>(musicsheetflow::LatencyStage::Count)) {
+        musicsheetflow::getLatencyStats()->record(static_cast<musicsheetflow::LatencyStage>(stage), nanos);
+    }
+}
+
+// @CriticalNative: copy one half of the telemetry block into the snapshot
+// Kotlin reads, under its seqlock
+static void snapshotInputTelemetry() {
+    musicsheetflow::EngineTelemetry::read(musicsheetflow::getEngineTelemetry()->input,
+                                          musicsheetflow::getTelemetrySnapshot()->input);
+}
+
+static void snapshotOutputTelemetry() {
+    musicsheetflow::EngineTelemetry::read(musicsheetflow::getEngineTelemetry()->output,
+                                          musicsheetflow::getTelemetrySnapshot()->output);
+}
+
+static bool registerEngineTelemetryNatives(JNIEnv* env) {
+    jclass telemetryClass = env->FindClass("net/tigr/musicsheetflow/audio/EngineTelemetry");
+    if (!telemetryClass) {
+        env->ExceptionClear();
+        LOGE("EngineTelemetry class not found");
+        return false;
+    }
+    static const JNINativeMethod methods[] = {
+        {"nativeSnapshotInput", "()V", reinterpret_cast<void*>(snapshotInputTelemetry)},
+        {"nativeSnapshotOutput", "()V", reinterpret_cast<void*>(snapshotOutputTelemetry)},
+    };
+    jint result = env->RegisterNatives(telemetryClass, methods, sizeof(methods) / sizeof(methods[0]));
+    env->DeleteLocalRef(telemetryClass);
+    if (result != JNI_OK) {
+        env->ExceptionClear();
+        LOGE("Failed to register telemetry natives");
+        return false;
+    }
+    return true;
+}
+
+static bool registerAudioEngineNatives(JNIEnv* env) {
+    jclass engineClass = env->FindClass("net/tigr/musicsheetflow/audio/NativeAudioEngine");
+    if (!engineClass) {
+        env->ExceptionClear();
+        LOGE("NativeAudioEngine class not found");
+        return false;
+    }
+    static const JNINativeMethod methods[] = {
+        {"nativeRecordLatency", "(IJ)V", reinterpret_cast<void*>(recordLatency)},
+    };
+    jint result = env->RegisterNatives(engineClass, methods, sizeof(methods) / sizeof(methods[0]));
+    env->DeleteLocalRef(engineClass);
+    if (result != JNI_OK) {
+        env->ExceptionClear();
+        LOGE("Failed to register audio engine natives");
+        return false;
+    }
+    return true;
+}
+
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
     g_jvm = vm;
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        registerAudioEngineNatives(env);
+        registerEngineTelemetryNatives(env);
+        musicsheetflow::registerMidiEngineNatives(env);
+    }
     LOGI("Native library loaded");
     return JNI_VERSION_1_6;
 }
@@ -68,6 +139,90 @@ Java_net_tigr_musicsheetflow_audio_NativeAudioEngine_nativeSetSilenceThreshold(
     engine->setSilenceThreshold(thresholdDb);
 }
 
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeAudioEngine_nativeSetSpectrumEnabled(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled) {
+    auto* engine = musicsheetflow::getAudioEngine();
+    engine->setSpectrumEnabled(enabled == JNI_TRUE);
+}
+
+// Per stage, in LatencyStage order:
+// [count, mean, max, p50, p90, p99, p99.9], durations in milliseconds
+JNIEXPORT jdoubleArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeAudioEngine_nativeGetLatencyStats(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean reset) {
+    constexpr int stages = static_cast<int>(musicsheetflow::LatencyStage::Count);
+    constexpr int fields = 7;
+    auto* stats = musicsheetflow::getLatencyStats();
+    jdouble values[stages * fields];
+    for (int stage = 0; stage < stages; stage++) {
+        auto summary = stats->summary(static_cast<musicsheetflow::LatencyStage>(stage));
+        jdouble* out = values + stage * fields;
+        out[0] = static_cast<jdouble>(summary.count);
+        out[1] = summary.mean;
+        out[2] = summary.max;
+        out[3] = summary.p50;
+        out[4] = summary.p90;
+        out[5] = summary.p99;
+        out[6] = summary.p999;
+    }
+    if (reset == JNI_TRUE) {
+        stats->reset();
+    }
+    jdoubleArray result = env->NewDoubleArray(stages * fields);
+    env->SetDoubleArrayRegion(result, 0, stages * fields, values);
+    return result;
+}
+
+// The snapshot of the telemetry block (see EngineTelemetry) that
+// nativeSnapshotInput/Output fill; it lives as long as the library
+JNIEXPORT jobject JNICALL
+Java_net_tigr_musicsheetflow_audio_EngineTelemetry_nativeGetBuffer(
+        JNIEnv* env,
+        jobject thiz) {
+    auto* telemetry = musicsheetflow::getTelemetrySnapshot();
+    return env->NewDirectByteBuffer(telemetry, sizeof(*telemetry));
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeTrace_nativeStart(
+        JNIEnv* env,
+        jobject thiz) {
+    musicsheetflow::Trace::start();
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeTrace_nativeStop(
+        JNIEnv* env,
+        jobject thiz) {
+    musicsheetflow::Trace::stop();
+}
+
+JNIEXPORT jboolean JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeTrace_nativeIsRecording(
+        JNIEnv* env,
+        jobject thiz) {
+    return musicsheetflow::Trace::isRecording() ? JNI_TRUE : JNI_FALSE;
+}
+
+// Perfetto protobuf, or Chrome JSON when perfetto is false
+JNIEXPORT jboolean JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeTrace_nativeWrite(
+        JNIEnv* env,
+        jobject thiz,
+        jstring path,
+        jboolean perfetto) {
+    const char* pathStr = env->GetStringUTFChars(path, nullptr);
+    bool written = perfetto == JNI_TRUE ? musicsheetflow::Trace::writePerfetto(pathStr)
+                                        : musicsheetflow::Trace::writeChromeJson(pathStr);
+    env->ReleaseStringUTFChars(path, pathStr);
+    return written ? JNI_TRUE : JNI_FALSE;
+}
+
 JNIEXPORT void JNICALL
 Java_net_tigr_musicsheetflow_audio_NativeAudioEngine_nativeSetCallback(
         JNIEnv* env,
@@ -84,13 +239,14 @@ Java_net_tigr_musicsheetflow_audio_NativeAudioEngine_nativeSetCallback(
         g_onPitchDetected = env->GetMethodID(
                 callbackClass,
                 "onPitchDetected",
-                "(FFIIJ)V"  // float freq, float conf, int midi, int cents, long timestamp
+                "(FFIIJJ)V"  // float freq, float conf, int midi, int cents, long timestamp, long capture
         );
 
         // Set up native callback
         auto* engine = musicsheetflow::getAudioEngine();
         engine->setPitchCallback([](const musicsheetflow::PitchEvent& event) {
             if (g_jvm == nullptr || g_callback == nullptr) return;
+            TRACE_SCOPE("Pitch delivery");
 
             JNIEnv* env;
             bool attached = false;
@@ -109,7 +265,8 @@ Java_net_tigr_musicsheetflow_audio_NativeAudioEngine_nativeSetCallback(
                         event.confidence,
                         event.midiNote,
                         event.centDeviation,
-                        event.timestampNs
+                        event.timestampNs,
+                        event.captureNs
                 );
             }
 
@@ -0,0 +1,93 @@
+#include "latency_stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace musicsheetflow {
+
+int LatencyHistogram::bucketOf(int64_t micros) {
+    if (micros < SUB_BUCKETS) {
+        return static_cast<int>(std::max<int64_t>(micros, 0));
+    }
+    micros = std::min<int64_t>(micros, (int64_t{1} << (MAX_EXPONENT + 1)) - 1);
+    int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(micros));
+    int shift = exponent - SUB_BUCKET_BITS;
+    int sub = static_cast<int>(micros >> shift) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + shift * SUB_BUCKETS + sub;
+}
+
+double LatencyHistogram::bucketMidMicros(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    int sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+    double low = static_cast<double>(int64_t{SUB_BUCKETS + sub} << shift);
+    return low + (int64_t{1} << shift) / 2.0;
+}
+
+void LatencyHistogram::record(int64_t nanos) {
+    int64_t micros = std::max<int64_t>(nanos / 1000, 0);
+    counts_[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    totalMicros_.fetch_add(micros, std::memory_order_relaxed);
+    int64_t max = maxMicros_.load(std::memory_order_relaxed);
+    while (micros > max &&
+           !maxMicros_.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySummary LatencyHistogram::summary() const {
+    uint32_t counts[BUCKETS];
+    int64_t count = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        counts[i] = counts_[i].load(std::memory_order_relaxed);
+        count += counts[i];
+    }
+    LatencySummary summary;
+    if (count == 0) {
+        return summary;
+    }
+    double max = maxMicros_.load(std::memory_order_relaxed);
+    summary.count = count;
+    summary.mean = totalMicros_.load(std::memory_order_relaxed) / 1000.0 / count;
+    summary.max = max / 1000.0;
+
+    // Smallest bucket holding at least `fraction` of the values
+    auto percentile = [&](double fraction) {
+        auto rank = static_cast<int64_t>(std::ceil(fraction * count));
+        int64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(bucketMidMicros(i), max) / 1000.0;
+            }
+        }
+        return max / 1000.0;
+    };
+    summary.p50 = percentile(0.5);
+    summary.p90 = percentile(0.9);
+    summary.p99 = percentile(0.99);
+    summary.p999 = percentile(0.999);
+    return summary;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    totalMicros_.store(0, std::memory_order_relaxed);
+    maxMicros_.store(0, std::memory_order_relaxed);
+}
+
+void LatencyStats::reset() {
+    for (auto& histogram : histograms_) {
+        histogram.reset();
+    }
+}
+
+static LatencyStats g_latencyStats;
+
+LatencyStats* getLatencyStats() {
+    return &g_latencyStats;
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace musicsheetflow {
+
+// Stages of a pitch event from the microphone to the UI
+enum class LatencyStage : int {
+    Buffering,  // Window's last sample captured -> detection starts
+    Detection,  // Detection runs
+    Delivery,   // Detection done -> Kotlin callback runs (JNI)
+    Dispatch,   // Kotlin callback -> consumed by the UI collector
+    Total,      // Captured -> consumed
+    Count
+};
+
+// Distribution of one stage since the last reset, in milliseconds
+struct LatencySummary {
+    int64_t count = 0;
+    double mean = 0.0;
+    double max = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+};
+
+/**
+ * Lock-free duration histogram in the style of HdrHistogram.
+ *
+ * Values are kept in microseconds. Each power of two is split into
+ * SUB_BUCKETS linear buckets, so any recorded value lands within 1/16 of
+ * its true size from 1 us up to MAX_MICROS, in a fixed 448 counters.
+ * record() is wait-free and may run on the audio thread; summaries read
+ * the counters while recording goes on, so they may miss the last few
+ * values but never block a writer.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_EXPONENT = 30;  // 2^30 us, about 18 minutes
+    static constexpr int BUCKETS = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(int64_t nanos);
+    LatencySummary summary() const;
+    void reset();
+
+private:
+    static int bucketOf(int64_t micros);
+    static double bucketMidMicros(int bucket);
+
+    std::atomic<uint32_t> counts_[BUCKETS] = {};
+    std::atomic<int64_t> totalMicros_{0};
+    std::atomic<int64_t> maxMicros_{0};
+};
+
+// One histogram per stage, for the whole process
+class LatencyStats {
+public:
+    void record(LatencyStage stage, int64_t nanos) {
+        histograms_[static_cast<int>(stage)].record(nanos);
+    }
+    LatencySummary summary(LatencyStage stage) const {
+        return histograms_[static_cast<int>(stage)].summary();
+    }
+    void reset();
+
+private:
+    LatencyHistogram histograms_[static_cast<int>(LatencyStage::Count)];
+};
+
+LatencyStats* getLatencyStats();
+
+}  // namespace musicsheetflow
@@ -0,0 +1,200 @@
+#include "metronome.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cmath>
+
+#define LOG_TAG "Metronome"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+namespace musicsheetflow {
+
+// Synth click shape: short sine burst, higher and louder on the downbeat
+static constexpr float CLICK_LENGTH_SEC = 0.030f;
+static constexpr float CLICK_ATTACK_SEC = 0.001f;
+static constexpr float CLICK_DECAY_SEC = 0.006f;
+static constexpr float ACCENT_FREQ = 1760.0f;
+static constexpr float BEAT_FREQ = 1320.0f;
+static constexpr float ACCENT_LEVEL = 0.5f;
+static constexpr float BEAT_LEVEL = 0.35f;
+
+// GM percussion, same notes as NativeMidiEngine.playMetronomeClick
+static constexpr int PERCUSSION_CHANNEL = 9;
+static constexpr int LOW_WOODBLOCK = 76;
+static constexpr int HIGH_WOODBLOCK = 77;
+
+static void buildClick(std::vector<float>& click, int sampleRate, float freq, float level) {
+    auto length = static_cast<size_t>(CLICK_LENGTH_SEC * sampleRate);
+    float attack = CLICK_ATTACK_SEC * sampleRate;
+    float decay = CLICK_DECAY_SEC * sampleRate;
+    float phaseStep = 2.0f * static_cast<float>(M_PI) * freq / sampleRate;
+
+    click.resize(length);
+    for (size_t i = 0; i < length; ++i) {
+        float t = static_cast<float>(i);
+        float envelope = std::min(1.0f, t / attack) * std::exp(-t / decay);
+        click[i] = level * envelope * std::sin(phaseStep * t);
+    }
+}
+
+Metronome::Metronome(TempoMap& tempoMap) : tempoMap_(tempoMap) {
+    setSampleRate(sampleRate_);
+}
+
+void Metronome::start(int countInBeats) {
+    running_.store(true, std::memory_order_release);
+    send({Control::Type::Start, static_cast<float>(std::max(0, countInBeats))});
+}
+
+void Metronome::stop() {
+    running_.store(false, std::memory_order_release);
+    send({Control::Type::Stop, 0.0f});
+}
+
+void Metronome::setBeatsPerMeasure(int beats) {
+    send({Control::Type::Meter, static_cast<float>(std::max(1, beats))});
+}
+
+void Metronome::setSound(ClickSound sound) {
+    send({Control::Type::Sound, static_cast<float>(static_cast<int>(sound))});
+}
+
+void Metronome::setAudible(bool audible) {
+    send({Control::Type::Audible, audible ? 1.0f : 0.0f});
+}
+
+bool Metronome::pollBeat(BeatEvent& event) {
+    return beats_.pop(event);
+}
+
+int64_t Metronome::beatFrame(double beat) {
+    double position;
+    int64_t frame;
+    uint32_t sequence;
+    do {
+        sequence = positionSequence_.load(std::memory_order_acquire);
+        position = positionBeat_.load(std::memory_order_relaxed);
+        frame = positionFrame_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) != 0 || sequence != positionSequence_.load(std::memory_order_relaxed));
+
+    if (!isRunning() || frame < 0) {
+        return -1;
+    }
+    return frame + static_cast<int64_t>(std::llround(tempoMap_.framesBetweenLatest(position, beat)));
+}
+
+void Metronome::send(const Control& control) {
+    if (!controls_.push(control)) {
+        LOGW("Metronome control queue full, dropping command %d", static_cast<int>(control.type));
+    }
+}
+
+void Metronome::setSampleRate(int sampleRate) {
+    sampleRate_ = sampleRate;
+    click_ = nullptr;
+    buildClick(accentClick_, sampleRate, ACCENT_FREQ, ACCENT_LEVEL);
+    buildClick(beatClick_, sampleRate, BEAT_FREQ, BEAT_LEVEL);
+}
+
+void Metronome::process(int64_t blockStart, int32_t numFrames, MidiEventSink& sink) {
+    Control control;
+    while (controls_.pop(control)) {
+        applyControl(control);
+    }
+
+    onsetCount_ = 0;
+    if (!active_) {
+        return;
+    }
+
+    double endPosition = tempoMap_.advance(position_, numFrames);
+    while (beat_ < endPosition) {
+        auto offset = static_cast<int32_t>(std::lround(tempoMap_.framesBetween(position_, beat_)));
+        offset = std::min(std::max(offset, 0), numFrames - 1);
+        triggerBeat(blockStart + offset, offset, sink);
+    }
+    position_ = endPosition;
+    publishPosition(blockStart + numFrames);
+}
+
+void Metronome::publishPosition(int64_t frame) {
+    uint32_t sequence = positionSequence_.load(std::memory_order_relaxed);
+    positionSequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    positionBeat_.store(position_, std::memory_order_relaxed);
+    positionFrame_.store(frame, std::memory_order_relaxed);
+    positionSequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void Metronome::applyControl(const Control& control) {
+    switch (control.type) {
+        case Control::Type::Start:
+            active_ = true;
+            beat_ = -static_cast<int32_t>(control.value);
+            position_ = beat_;  // First beat at this block's start
+            break;
+        case Control::Type::Stop:
+            active_ = false;  // A click already sounding rings out
+            break;
+        case Control::Type::Meter:
+            beatsPerMeasure_ = static_cast<int>(control.value);
+            break;
+        case Control::Type::Sound:
+            sound_ = static_cast<ClickSound>(static_cast<int>(control.value));
+            break;
+        case Control::Type::Audible:
+            audible_ = control.value != 0.0f;
+            break;
+    }
+}
+
+void Metronome::triggerBeat(int64_t frame, int32_t offset, MidiEventSink& sink) {
+    int32_t inMeasure = ((beat_ % beatsPerMeasure_) + beatsPerMeasure_) % beatsPerMeasure_;
+    bool accent = inMeasure == 0;
+
+    if (audible_ || beat_ < 0) {
+        if (sound_ == ClickSound::Woodblock) {
+            int note = accent ? HIGH_WOODBLOCK : LOW_WOODBLOCK;
+            auto release = frame + static_cast<int64_t>(CLICK_LENGTH_SEC * 4 * sampleRate_);
+            sink.post(MidiCommand::noteOn(PERCUSSION_CHANNEL, note, accent ? 1.0f : 0.7f, frame));
+            sink.post(MidiCommand::noteOff(PERCUSSION_CHANNEL, note, release));
+        } else if (onsetCount_ < MAX_ONSETS_PER_BLOCK) {
+            onsets_[onsetCount_++] = {offset, accent};
+        }
+    }
+
+    beats_.push({frame, beat_});  // Full queue: the UI is not listening
+    beat_++;
+}
+
+void Metronome::mix(float* output, int32_t numFrames) {
+    int32_t pos = 0;
+    for (int i = 0; i < onsetCount_; ++i) {
+        mixClick(output + pos * 2, onsets_[i].offset - pos);
+        click_ = onsets_[i].accent ? &accentClick_ : &beatClick_;
+        clickPos_ = 0;
+        pos = onsets_[i].offset;
+    }
+    mixClick(output + pos * 2, numFrames - pos);
+    onsetCount_ = 0;
+}
+
+// Add the sounding click to stereo interleaved output
+void Metronome::mixClick(float* output, int32_t numFrames) {
+    if (!click_) {
+        return;
+    }
+    size_t count = std::min(static_cast<size_t>(numFrames), click_->size() - clickPos_);
+    const float* samples = click_->data() + clickPos_;
+    for (size_t i = 0; i < count; ++i) {
+        output[i * 2] += samples[i];
+        output[i * 2 + 1] += samples[i];
+    }
+    clickPos_ += count;
+    if (clickPos_ >= click_->size()) {
+        click_ = nullptr;
+    }
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "lock_free_queue.h"
+#include "sequencer.h"
+#include "tempo_map.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace musicsheetflow {
+
+enum class ClickSound : uint8_t {
+    Synth = 0,      // Short sine burst mixed into the output
+    Woodblock = 1   // GM percussion woodblock from the loaded SoundFont
+};
+
+// One metronome beat as it will reach the output. Beats before 0 are count-in.
+struct BeatEvent {
+    int64_t frame;   // Output frame of the click onset
+    int32_t beat;    // -countIn..-1 during count-in, then 0, 1, 2...
+};
+
+/**
+ * Click generator running on the output frame clock.
+ *
+ * The metronome keeps its position in beats and finds each beat's frame
+ * through the shared TempoMap, not from timers, so the click never drifts
+ * against the synth and follows the score's tempo changes. Beat n clicks
+ * at score beat n; count-in beats come before 0 at the opening tempo. Each
+ * beat is reported with its exact output frame for the UI to align
+ * practice timing. Control methods may be called from any thread and take
+ * effect at the next callback.
+ */
+class Metronome {
+public:
+    explicit Metronome(TempoMap& tempoMap);
+
+    // Control thread API
+    void start(int countInBeats);  // First beat at the next render block
+    void stop();
+    void setBeatsPerMeasure(int beats);
+    void setSound(ClickSound sound);
+    void setAudible(bool audible);  // Count-in beats always click
+    bool pollBeat(BeatEvent& event);
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+    // Output frame where a beat clicks, or was due, from the latest block
+    // rendered; -1 while stopped
+    int64_t beatFrame(double beat);
+
+    // Called while the output stream is stopped (builds the click waveforms)
+    void setSampleRate(int sampleRate);
+
+    // Audio thread API: process() before rendering the synth, mix() after
+    void process(int64_t blockStart, int32_t numFrames, MidiEventSink& sink);
+    void mix(float* output, int32_t numFrames);
+
+private:
+    struct Control {
+        enum class Type : uint8_t { Start, Stop, Meter, Sound, Audible };
+        Type type;
+        float value;
+    };
+
+    // Synth click started inside the current block
+    struct ClickOnset {
+        int32_t offset;
+        bool accent;
+    };
+
+    static constexpr int MAX_ONSETS_PER_BLOCK = 8;
+
+    void send(const Control& control);
+    void applyControl(const Control& control);
+    void triggerBeat(int64_t frame, int32_t offset, MidiEventSink& sink);
+    void mixClick(float* output, int32_t numFrames);
+    void publishPosition(int64_t frame);
+
+    TempoMap& tempoMap_;
+
+    // Audio thread state
+    bool active_ = false;
+    bool audible_ = false;
+    ClickSound sound_ = ClickSound::Synth;
+    int beatsPerMeasure_ = 4;
+    int32_t beat_ = 0;        // Number of the next beat
+    double position_ = 0.0;   // Beat at the start of the next block
+    int sampleRate_ = 44100;
+
+    // Synth click playback
+    std::vector<float> accentClick_;
+    std::vector<float> beatClick_;
+    const std::vector<float>* click_ = nullptr;
+    size_t clickPos_ = 0;
+    ClickOnset onsets_[MAX_ONSETS_PER_BLOCK];
+    int onsetCount_ = 0;
+
+    std::atomic<bool> running_{false};
+
+    // Position at the end of the latest block, for beatFrame(); `positionSequence_`
+    // is odd while the pair is being written
+    std::atomic<uint32_t> positionSequence_{0};
+    std::atomic<double> positionBeat_{0.0};
+    std::atomic<int64_t> positionFrame_{-1};
+    LockFreeQueue<Control, 32> controls_;
+    LockFreeQueue<BeatEvent, 64> beats_;  // To the UI; dropped when not polled
+};
+
+}  // namespace musicsheetflow
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace musicsheetflow {
+
+// Fixed-size synth command, queued by control threads and applied to
+// TinySoundFont on the audio thread only.
+//
+// `frame` is the target position on the output stream's frame clock
+// (frames rendered since the engine was created). The render loop splits
+// at that frame so the event lands sample-accurately; IMMEDIATE or any
+// frame already in the past applies at the start of the next callback.
+//
+// Kotlin packs commands in this layout into the command buffer and submits
+// a batch with one JNI call; the offsets are part of that contract.
+struct MidiCommand {
+    static constexpr int64_t IMMEDIATE = 0;
+
+    enum class Type : uint8_t {
+        NoteOn,
+        NoteOff,
+        AllNotesOff,
+        SetPreset,
+        SetVolume,
+    };
+
+    Type type;       // offset 0
+    uint8_t channel; // offset 1
+    int16_t data1;   // offset 2: note number, or preset number for SetPreset
+    int16_t data2;   // offset 4: bank for SetPreset
+    float value;     // offset 8: velocity (NoteOn) or volume (SetVolume)
+    int64_t frame;   // offset 16: target output frame, IMMEDIATE for as soon as possible
+
+    static MidiCommand noteOn(int channel, int note, float velocity, int64_t frame = IMMEDIATE) {
+        return {Type::NoteOn, static_cast<uint8_t>(channel), static_cast<int16_t>(note), 0,
+                velocity, frame};
+    }
+
+    static MidiCommand noteOff(int channel, int note, int64_t frame = IMMEDIATE) {
+        return {Type::NoteOff, static_cast<uint8_t>(channel), static_cast<int16_t>(note), 0,
+                0.0f, frame};
+    }
+
+    // Also cancels every scheduled event queued before it
+    static MidiCommand allNotesOff() {
+        return {Type::AllNotesOff, 0, 0, 0, 0.0f, IMMEDIATE};
+    }
+
+    static MidiCommand setPreset(int channel, int preset, int bank) {
+        return {Type::SetPreset, static_cast<uint8_t>(channel), static_cast<int16_t>(preset),
+                static_cast<int16_t>(bank), 0.0f, IMMEDIATE};
+    }
+
+    static MidiCommand setVolume(float volume) {
+        return {Type::SetVolume, 0, 0, 0, volume, IMMEDIATE};
+    }
+};
+static_assert(sizeof(MidiCommand) == 24 && offsetof(MidiCommand, value) == 8 &&
+              offsetof(MidiCommand, frame) == 16, "Command layout is shared with Kotlin");
+
+}  // namespace musicsheetflow
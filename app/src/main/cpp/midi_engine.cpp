@@ -1,10 +1,24 @@
 #include "midi_engine.h"
+#include "midi_command.h"
+#include "lock_free_queue.h"
+#include "midi_file.h"
+#include "mixer.h"
+#include "render_ahead.h"
+#include "soundfont_memory.h"
+#include "synth_slot.h"
+#include "telemetry.h"
+#include "trace.h"
 #include <oboe/Oboe.h>
 #include <android/log.h>
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <mutex>
+#include <thread>
 #include <vector>
+#include <time.h>
 #include <unistd.h>
 
 #define TSF_IMPLEMENTATION
@@ -13,74 +27,133 @@
 #define LOG_TAG "MidiEngine"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
 
 namespace musicsheetflow {
 
-class MidiEngineImpl : public MidiEngine, public oboe::AudioStreamDataCallback {
+// Commands buffered between render callbacks (a dense chord burst is ~20)
+static constexpr size_t COMMAND_QUEUE_SIZE = 1024;
+
+// Immediate commands for the live synth
+static constexpr size_t LIVE_COMMAND_QUEUE_SIZE = 256;
+
+// Render-ahead lookahead, in bursts
+static constexpr int MAX_RENDER_AHEAD_BURSTS = 8;
+
+// Future-timestamped commands held on the audio thread until their frame
+static constexpr size_t SCHEDULED_EVENT_CAPACITY = 4096;
+
+// Voice pool: a sustained piano passage with stereo samples and release
+// tails stays well under 64; the bounds keep Kotlin from starving or
+// bloating it
+static constexpr int DEFAULT_MAX_VOICES = 64;
+static constexpr int MIN_MAX_VOICES = 8;
+static constexpr int MAX_MAX_VOICES = 256;
+
+// Channels created with the font, so no MIDI channel allocates on the callback
+static constexpr int MIDI_CHANNELS = 16;
+
+// Mixer buses the timeline renders, in BlockSource order
+static constexpr Mixer::Bus TIMELINE_BUSES[] = {Mixer::Score, Mixer::Click};
+static constexpr int TIMELINE_BUS_COUNT = 2;
+
+// Output telemetry is published this often, in seconds
+static constexpr float TELEMETRY_INTERVAL = 0.1f;
+
+// Smoothing of the per-callback render load in the telemetry
+static constexpr float LOAD_SMOOTHING = 0.1f;
+
+static int64_t monotonicNanos() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+class MidiEngineImpl : public MidiEngine,
+                       public oboe::AudioStreamDataCallback,
+                       private MidiEventSink,
+                       private BlockSource {
 public:
-    MidiEngineImpl() = default;
+    MidiEngineImpl() {
+        scheduled_.reserve(SCHEDULED_EVENT_CAPACITY);
+    }
 
     ~MidiEngineImpl() override {
         stop();
-        if (tsf_) {
-            tsf_close(tsf_);
-            tsf_ = nullptr;
+        // The slots free the synths they still hold as they go
+        std::lock_guard<std::mutex> lock(fontMutex_);
+        reclaimSynths();
+        if (font_) {
+            tsf_close(font_);
+            font_ = nullptr;
         }
     }
 
+    // Loads parse on the calling thread (Kotlin calls them off the main
+    // thread) while the callback keeps playing the old font
     bool loadSoundFont(const std::string& path) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        if (tsf_) {
-            tsf_close(tsf_);
-            tsf_ = nullptr;
-        }
-
-        tsf_ = tsf_load_filename(path.c_str());
-        if (!tsf_) {
+        tsf* loaded = tsf_load_filename(path.c_str());
+        if (!loaded) {
             LOGE("Failed to load SoundFont: %s", path.c_str());
             return false;
         }
+        int presets = tsf_get_presetcount(loaded);
+        if (!publishFont(loaded, nullptr)) {
+            return false;
+        }
+        LOGI("SoundFont loaded: %s (%d presets)", path.c_str(), presets);
+        return true;
+    }
 
-        // Set output mode to stereo interleaved, 44100 Hz
-        tsf_set_output(tsf_, TSF_STEREO_INTERLEAVED, sampleRate_, 0.0f);
-
-        tsf_set_volume(tsf_, 1.0f);
+    bool loadSoundFontAsset(AAssetManager* assets, const std::string& name) override {
+        // Buffer mode maps an entry stored uncompressed straight from the APK;
+        // a compressed one is inflated into a heap buffer instead
+        AAsset* asset = AAssetManager_open(assets, name.c_str(), AASSET_MODE_BUFFER);
+        if (!asset) {
+            LOGE("SoundFont asset not found: %s", name.c_str());
+            return false;
+        }
+        std::shared_ptr<AAsset> mapping(asset, AAsset_close);
+        const void* data = AAsset_getBuffer(asset);
+        off_t length = AAsset_getLength(asset);
 
-        // Set up channel 0 for piano (General MIDI preset 0)
-        tsf_channel_set_presetnumber(tsf_, 0, 0, 0);
-        tsf_channel_set_volume(tsf_, 0, 1.0f);
+        tsf* loaded = data ? tsf_load_mapped(data, static_cast<int>(length)) : nullptr;
+        if (!loaded) {
+            LOGE("Failed to load SoundFont asset: %s", name.c_str());
+            return false;
+        }
+        int presets = tsf_get_presetcount(loaded);
+        if (!publishFont(loaded, mapping)) {
+            return false;
+        }
 
-        // Set up channel 9 for percussion (GM drum kit, bank 128)
-        tsf_channel_set_presetnumber(tsf_, 9, 0, 1);  // Preset 0, bank 1 for percussion
-        tsf_channel_set_volume(tsf_, 9, 1.0f);
+        LOGI("SoundFont mapped: %s (%d presets, %lld KB, %s)", name.c_str(),
+             presets, static_cast<long long>(length) / 1024,
+             AAsset_isAllocated(asset) ? "inflated, asset is compressed" : "in place");
 
-        LOGI("SoundFont loaded: %s (%d presets)", path.c_str(), tsf_get_presetcount(tsf_));
+        // Only the presets the channels have selected need to be in RAM now
+        int64_t pianoBytes = prefetchPreset(0, false);
+        int64_t drumBytes = prefetchPreset(0, true);
+        LOGI("Piano and drums resident: %lld KB + %lld KB",
+             static_cast<long long>(pianoBytes) / 1024, static_cast<long long>(drumBytes) / 1024);
         return true;
     }
 
     bool loadSoundFontFromMemory(const void* data, int size) {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        if (tsf_) {
-            tsf_close(tsf_);
-            tsf_ = nullptr;
-        }
-
-        tsf_ = tsf_load_memory(data, size);
-        if (!tsf_) {
+        tsf* loaded = tsf_load_memory(data, size);
+        if (!loaded) {
             LOGE("Failed to load SoundFont from memory");
             return false;
         }
-
-        tsf_set_output(tsf_, TSF_STEREO_INTERLEAVED, sampleRate_, 0.0f);
-
+        if (!publishFont(loaded, nullptr)) {
+            return false;
+        }
         LOGI("SoundFont loaded from memory (%d bytes)", size);
         return true;
     }
 
     bool isLoaded() const override {
-        return tsf_ != nullptr;
+        return loaded_.load(std::memory_order_acquire);
     }
 
     void noteOn(int note, float velocity) override {
@@ -92,49 +165,201 @@ public:
     }
 
     void noteOnChannel(int channel, int note, float velocity) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (tsf_) {
-            tsf_channel_note_on(tsf_, channel, note, velocity);
-        }
+        enqueue(MidiCommand::noteOn(channel, note, velocity));
     }
 
     void noteOffChannel(int channel, int note) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (tsf_) {
-            tsf_channel_note_off(tsf_, channel, note);
-        }
+        enqueue(MidiCommand::noteOff(channel, note));
     }
 
     void setChannelPreset(int channel, int preset, int bank) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (tsf_) {
-            tsf_channel_set_presetnumber(tsf_, channel, preset, bank);
-            LOGI("Channel %d set to preset %d, bank %d", channel, preset, bank);
-        }
+        // Page the samples in here so the first note does not fault on the callback
+        prefetchPreset(preset, bank != 0);
+        enqueue(MidiCommand::setPreset(channel, preset, bank));
     }
 
     void allNotesOff() override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (tsf_) {
-            tsf_note_off_all(tsf_);
-        }
+        enqueue(MidiCommand::allNotesOff());
     }
 
-    void batchNoteOn(const int* notes, const float* velocities, int count) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (tsf_) {
-            for (int i = 0; i < count; i++) {
-                tsf_channel_note_on(tsf_, 0, notes[i], velocities[i]);
+    int submit(const MidiCommand* commands, int count) override {
+        int queued = 0;
+        for (int i = 0; i < count; i++) {
+            MidiCommand command = commands[i];
+            if (command.channel >= MIDI_CHANNELS) {
+                continue;
             }
+            switch (command.type) {
+                case MidiCommand::Type::NoteOn:
+                case MidiCommand::Type::NoteOff:
+                    if (command.data1 < 0 || command.data1 > 127) {
+                        continue;
+                    }
+                    command.value = std::clamp(command.value, 0.0f, 1.0f);
+                    command.frame = std::max<int64_t>(command.frame, MidiCommand::IMMEDIATE);
+                    break;
+                case MidiCommand::Type::AllNotesOff:
+                    command.frame = MidiCommand::IMMEDIATE;
+                    break;
+                case MidiCommand::Type::SetVolume:
+                    command.value = std::clamp(command.value, 0.0f, 1.0f);
+                    command.frame = MidiCommand::IMMEDIATE;
+                    break;
+                default:
+                    continue;
+            }
+            enqueue(command);
+            queued++;
         }
+        return queued;
     }
 
     void setVolume(float volume) override {
-        std::lock_guard<std::mutex> lock(mutex_);
-        volume_ = volume;
-        if (tsf_) {
-            tsf_set_volume(tsf_, volume);
+        enqueue(MidiCommand::setVolume(volume));
+    }
+
+    int64_t getFramePosition() const override {
+        return framePosition_.load(std::memory_order_acquire);
+    }
+
+    int getSampleRate() const override {
+        return sampleRate_;
+    }
+
+    void scheduleNoteOn(int channel, int note, float velocity, int64_t frame) override {
+        enqueue(MidiCommand::noteOn(channel, note, velocity, frame));
+    }
+
+    void scheduleNoteOff(int channel, int note, int64_t frame) override {
+        enqueue(MidiCommand::noteOff(channel, note, frame));
+    }
+
+    Sequencer& sequencer() override {
+        return sequencer_;
+    }
+
+    TempoMap& tempoMap() override {
+        return tempoMap_;
+    }
+
+    Metronome& metronome() override {
+        return metronome_;
+    }
+
+    int64_t getFrameTimeNanos(int64_t frame) override {
+        double nanosPerFrame = 1e9 / sampleRate_;
+        if (stream_) {
+            // Stream positions count from 0 at each start; ours keep running
+            auto timestamp = stream_->getTimestamp(CLOCK_MONOTONIC);
+            if (timestamp) {
+                int64_t streamFrame = frame - streamFrameBase_;
+                return timestamp.value().timestamp +
+                       static_cast<int64_t>((streamFrame - timestamp.value().position) * nanosPerFrame);
+            }
+        }
+
+        // No presentation timestamp yet: assume the frame plays as the
+        // callback hands it over
+        int64_t playing = outputFrame_.load(std::memory_order_acquire);
+        return monotonicNanos() + static_cast<int64_t>((frame - playing) * nanosPerFrame);
+    }
+
+    void setMaxVoices(int voices) override {
+        voices = std::clamp(voices, MIN_MAX_VOICES, MAX_MAX_VOICES);
+        // The playing pool is never reallocated: a synth with the new size
+        // replaces it like a new font would
+        std::lock_guard<std::mutex> lock(fontMutex_);
+        maxVoices_.store(voices, std::memory_order_relaxed);
+        if (font_ && !offerSynth()) {
+            LOGE("Failed to resize voice pool to %d", voices);
+            return;
         }
+        LOGI("Voice pool: %d voices", voices);
+    }
+
+    VoiceStats getVoiceStats(bool resetPeak) override {
+        VoiceStats stats;
+        stats.active = activeVoices_.load(std::memory_order_relaxed);
+        stats.peak = resetPeak ? peakVoices_.exchange(0, std::memory_order_relaxed)
+                               : peakVoices_.load(std::memory_order_relaxed);
+        stats.stolen = stolenVoices_.load(std::memory_order_relaxed);
+        stats.capacity = maxVoices_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void setRenderBudget(float fraction) override {
+        renderBudget_.setBudget(fraction);
+    }
+
+    RenderLoad getRenderLoad(bool resetPeak) override {
+        return renderBudget_.getLoad(resetPeak);
+    }
+
+    bool setParallelRender(bool enabled) override {
+        if (!enabled) {
+            renderPool_.setEnabled(false);
+            return false;
+        }
+        int workers = VoiceRenderPool::recommendedWorkers();
+        if (workers == 0) {
+            LOGI("Parallel render not used: %u cores", std::thread::hardware_concurrency());
+            return false;
+        }
+        // Workers start once and then idle; the callback uses them only while enabled
+        if (!renderPool_.start(workers)) {
+            return false;
+        }
+        renderPool_.setEnabled(true);
+        return true;
+    }
+
+    RenderBenchmark benchmarkRender(int voices) override {
+        RenderBenchmark result;
+        withFontCopy([&](tsf* synth) {
+            tsf_set_output(synth, TSF_STEREO_INTERLEAVED, sampleRate_, 0.0f);
+            result = VoiceRenderPool::benchmark(synth, voices, VoiceRenderPool::recommendedWorkers());
+        });
+        return result;
+    }
+
+    std::vector<float> renderOffline(const std::vector<SequenceNote>& notes,
+                                     const OfflineRenderOptions& options) override {
+        std::vector<float> pcm;
+        withFontCopy([&](tsf* font) {
+            pcm = OfflineRenderer::render(font, notes.data(), static_cast<int>(notes.size()), options);
+        });
+        LOGI("Offline render: %d notes, %.1f s", static_cast<int>(notes.size()),
+             pcm.size() / 2.0 / options.sampleRate);
+        return pcm;
+    }
+
+    void setRenderAhead(int bursts) override {
+        renderAheadBursts_.store(std::clamp(bursts, 0, MAX_RENDER_AHEAD_BURSTS),
+                                 std::memory_order_relaxed);
+    }
+
+    void setBusGain(int bus, float gain) override {
+        if (bus >= 0 && bus < Mixer::BusCount) {
+            mixer_.setGain(static_cast<Mixer::Bus>(bus), gain);
+        }
+    }
+
+    void setBusPan(int bus, float pan) override {
+        if (bus >= 0 && bus < Mixer::BusCount) {
+            mixer_.setPan(static_cast<Mixer::Bus>(bus), pan);
+        }
+    }
+
+    MixStats getMixStats(bool reset) override {
+        return mixer_.getStats(reset);
+    }
+
+    std::vector<PresetMemory> getPresetMemory() override {
+        std::vector<PresetMemory> presets;
+        withFontCopy([&](tsf* font) {
+            presets = SoundFontMemory::report(font);
+        });
+        return presets;
     }
 
     bool start() override {
@@ -146,16 +371,7 @@ public:
 
         // Retry loop for emulator compatibility (audio service may take time)
         for (int attempt = 1; attempt <= 5; attempt++) {
-            oboe::AudioStreamBuilder builder;
-            builder.setDirection(oboe::Direction::Output)
-                   ->setPerformanceMode(oboe::PerformanceMode::None)
-                   ->setSharingMode(oboe::SharingMode::Shared)
-                   ->setFormat(oboe::AudioFormat::Float)
-                   ->setChannelCount(oboe::ChannelCount::Stereo)
-                   ->setDataCallback(this);
-
-            // Don't specify sample rate, let system choose
-            result = builder.openStream(stream_);
+            result = openOutputStream();
             if (result == oboe::Result::OK) {
                 break;
             }
@@ -171,13 +387,40 @@ public:
             }
         }
 
+        // Start at the smallest buffer (two bursts) and let the tuner grow it
+        // one burst per underrun; only AAudio reports underruns
+        latencyTuner_ = std::make_unique<oboe::LatencyTuner>(*stream_);
+
         // Update sample rate to match stream
-        sampleRate_ = stream_->getSampleRate();
-        if (tsf_) {
-            tsf_set_output(tsf_, TSF_STEREO_INTERLEAVED, sampleRate_, 0.0f);
-            tsf_set_volume(tsf_, 1.0f);
-            LOGI("TSF output configured: sampleRate=%d, stereo interleaved", sampleRate_);
+        int sampleRate = stream_->getSampleRate();
+        sampleRate_.store(sampleRate, std::memory_order_relaxed);
+        tempoMap_.setSampleRate(sampleRate);
+        metronome_.setSampleRate(sampleRate);
+        mixer_.setSampleRate(sampleRate);
+        streamFrameBase_ = framePosition_.load(std::memory_order_relaxed);
+
+        // Callback is not running yet, so this thread may touch the synth
+        for (SynthSlot* slot : {&synth_, &live_}) {
+            slot->install(sampleRate);
+            slot->setOutput(sampleRate);
+        }
+        if (synth_.synth()) {
+            LOGI("TSF output configured: sampleRate=%d, stereo interleaved", sampleRate);
+        }
+        int64_t frame = framePosition_.load(std::memory_order_relaxed);
+        drainCommands(frame);
+        // Taps queued while stopped are stale; releases and settings still apply
+        drainLiveCommands(false);
+        outputFrame_.store(frame, std::memory_order_relaxed);
+
+        int bursts = renderAheadBursts_.load(std::memory_order_relaxed);
+        if (bursts > 0) {
+            int32_t burst = stream_->getFramesPerBurst();
+            if (!renderAhead_.start(this, TIMELINE_BUS_COUNT, frame, burst, burst * bursts)) {
+                LOGW("Render-ahead not started, rendering in the callback");
+            }
         }
+        renderingAhead_.store(renderAhead_.isRunning(), std::memory_order_release);
 
         result = stream_->requestStart();
         if (result != oboe::Result::OK) {
@@ -185,43 +428,520 @@ public:
             return false;
         }
 
-        LOGI("MIDI engine started: sampleRate=%d", sampleRate_);
+        LOGI("MIDI engine started: sampleRate=%d, framesPerBurst=%d, bufferSize=%d, %s/%s, "
+             "rendering %d frames ahead",
+             sampleRate, stream_->getFramesPerBurst(), stream_->getBufferSizeInFrames(),
+             oboe::convertToText(stream_->getPerformanceMode()),
+             oboe::convertToText(stream_->getSharingMode()),
+             renderAhead_.isRunning() ? renderAhead_.lookaheadFrames() : 0);
         return true;
     }
 
     void stop() override {
+        sequencer_.pause();
+        metronome_.stop();
         if (stream_) {
             stream_->requestStop();
             stream_->close();
             stream_.reset();
         }
-        allNotesOff();
+        latencyTuner_.reset();
+        if (renderAhead_.isRunning()) {
+            renderAhead_.stop();
+            LOGI("Render-ahead stopped, %lld frames missed",
+                 static_cast<long long>(renderAhead_.missedFrames()));
+        }
+        renderingAhead_.store(false, std::memory_order_release);
+
+        // Callback has stopped: apply what is left in the queue here and
+        // drop events scheduled for a timeline that is no longer advancing.
+        // Nothing is left to finish the notes of a replaced synth.
+        int sampleRate = sampleRate_;
+        for (SynthSlot* slot : {&synth_, &live_}) {
+            slot->dropReplaced();
+            slot->install(sampleRate);
+            slot->dropReplaced();
+        }
+        int64_t now = framePosition_.load(std::memory_order_relaxed);
+        drainCommands(now);
+        drainLiveCommands();
+        sequencer_.process(now, 0, *this);
+        metronome_.process(now, 0, *this);
+        scheduled_.clear();
+        for (SynthSlot* slot : {&synth_, &live_}) {
+            if (slot->synth()) {
+                tsf_note_off_all(slot->synth());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(fontMutex_);
+        reclaimSynths();
     }
 
     oboe::DataCallbackResult onAudioReady(
             oboe::AudioStream* stream,
             void* audioData,
             int32_t numFrames) override {
-
+        TRACE_SCOPE("Output callback");
+        int64_t begin = monotonicNanos();
         auto* output = static_cast<float*>(audioData);
+        bool ahead = renderingAhead_.load(std::memory_order_acquire);
+        float* timeline[TIMELINE_BUS_COUNT];
+        for (int i = 0; i < TIMELINE_BUS_COUNT; i++) {
+            timeline[i] = mixer_.bus(TIMELINE_BUSES[i]);
+        }
 
-        // Try to acquire mutex - if blocked, output silence to avoid audio glitches
-        std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
-        if (lock.owns_lock() && tsf_) {
-            tsf_render_float(tsf_, output, numFrames, 0);
-        } else {
-            memset(output, 0, numFrames * 2 * sizeof(float));
+        // Mixer buses hold MAX_FRAMES; a longer callback is mixed in pieces
+        for (int32_t done = 0; done < numFrames;) {
+            int32_t frames = std::min(numFrames - done, Mixer::MAX_FRAMES);
+            int64_t frame = outputFrame_.load(std::memory_order_relaxed);
+            if (ahead) {
+                // The synth thread has rendered this already; only live
+                // notes are synthesized here
+                renderAhead_.read(timeline, frames, frame);
+            } else {
+                renderBlock(timeline, frames, frame);
+            }
+            renderLive(mixer_.bus(Mixer::Keyboard), frames);
+            mixer_.mix(output + done * 2, frames);
+            outputFrame_.store(frame + frames, std::memory_order_release);
+            done += frames;
         }
 
+        if (latencyTuner_) {
+            latencyTuner_->tune();
+        }
+        publishTelemetry(stream, output, numFrames, begin);
         return oboe::DataCallbackResult::Continue;
     }
 
+    double getOutputLatencyMillis() override {
+        return stream_ ? outputLatencyMillis(stream_.get()) : 0.0;
+    }
+
 private:
-    tsf* tsf_ = nullptr;
+    double outputLatencyMillis(oboe::AudioStream* stream) {
+        // Frames queued ahead of the callback wait their turn on top of the
+        // stream's own latency (live notes skip that queue)
+        double ahead = renderingAhead_.load(std::memory_order_relaxed)
+                       ? renderAhead_.lookaheadFrames() * 1000.0 / sampleRate_ : 0.0;
+        auto latency = stream->calculateLatencyMillis();
+        if (latency) {
+            return latency.value() + ahead;
+        }
+        // No timestamps (OpenSL ES): the buffer is the dominant part
+        return stream->getBufferSizeInFrames() * 1000.0 / sampleRate_ + ahead;
+    }
+
+    // Output state for the telemetry block. The load and peak cover every
+    // callback; the rest, which takes a stream timestamp, is written a few
+    // times a second.
+    void publishTelemetry(oboe::AudioStream* stream, const float* output, int32_t numFrames,
+                          int64_t begin) {
+        int sampleRate = sampleRate_.load(std::memory_order_relaxed);
+        for (int32_t i = 0; i < numFrames * 2; i++) {
+            telemetryPeak_ = std::max(telemetryPeak_, std::fabs(output[i]));
+        }
+        float load = (monotonicNanos() - begin) * 1e-9f * sampleRate / std::max(numFrames, 1);
+        telemetryLoad_ += (load - telemetryLoad_) * LOAD_SMOOTHING;
+
+        telemetryCountdown_ -= numFrames;
+        if (telemetryCountdown_ > 0) {
+            return;
+        }
+        telemetryCountdown_ = static_cast<int>(sampleRate * TELEMETRY_INTERVAL);
+        auto xruns = stream->getXRunCount();
+        float latency = static_cast<float>(outputLatencyMillis(stream));
+        if (xruns) {
+            TRACE_COUNTER("Output xruns", xruns.value());
+        }
+
+        OutputTelemetry& telemetry = getEngineTelemetry()->output;
+        EngineTelemetry::beginWrite(telemetry);
+        telemetry.activeVoices = activeVoices_.load(std::memory_order_relaxed);
+        telemetry.renderLoad = telemetryLoad_;
+        if (xruns) {
+            telemetry.xruns = static_cast<uint32_t>(xruns.value());
+        }
+        telemetry.latencyMillis = latency;
+        telemetry.peak = telemetryPeak_;
+        telemetry.frame = outputFrame_.load(std::memory_order_relaxed);
+        EngineTelemetry::endWrite(telemetry);
+        telemetryPeak_ = 0.0f;
+    }
+
+    // Run fn on a private copy of the current font, outside fontMutex_. The
+    // first copy of a font creates the count its copies share, so copies of
+    // font_ are made under the lock that guards its replacement; fn may copy
+    // its own font further on any thread.
+    template <typename Fn>
+    bool withFontCopy(Fn&& fn) {
+        tsf* copy = nullptr;
+        std::shared_ptr<AAsset> samples;  // Keeps mapped samples alive for the copy
+        {
+            std::lock_guard<std::mutex> lock(fontMutex_);
+            reclaimSynths();
+            if (font_) {
+                copy = tsf_copy(font_);
+                samples = fontAsset_;
+            }
+        }
+        if (!copy) {
+            return false;
+        }
+
+        fn(copy);
+
+        tsf_close(copy);
+        return true;
+    }
+
+    // Make a newly loaded font current: it replaces font_ and a synth
+    // playing it is offered to the audio thread
+    bool publishFont(tsf* font, std::shared_ptr<AAsset> samples) {
+        std::lock_guard<std::mutex> lock(fontMutex_);
+        tsf* previous = font_;
+        std::shared_ptr<AAsset> previousSamples = std::move(fontAsset_);
+        font_ = font;
+        fontAsset_ = std::move(samples);
+        if (!offerSynth()) {
+            LOGE("Failed to allocate a synth for the SoundFont");
+            font_ = previous;
+            fontAsset_ = std::move(previousSamples);
+            tsf_close(font);
+            return false;
+        }
+        // The old font's data stays alive while its playing copies do
+        if (previous) {
+            tsf_close(previous);
+        }
+        loaded_.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Build playing instances of font_, for the timeline and for live
+    // notes; their slots swap them in at the start of a block. Caller holds
+    // fontMutex_.
+    bool offerSynth() {
+        reclaimSynths();
+        tsf* synth = tsf_copy(font_);
+        tsf* live = tsf_copy(font_);
+        if (!synth || !live || !configureSoundFont(synth) || !configureSoundFont(live)) {
+            tsf_close(synth);
+            tsf_close(live);
+            return false;
+        }
+        synth_.offer(new SynthFont{synth, fontAsset_});
+        live_.offer(new SynthFont{live, fontAsset_});
+        return true;
+    }
+
+    // Free synths the audio thread has swapped out. Caller holds fontMutex_.
+    void reclaimSynths() {
+        SynthFont* old = nullptr;
+        while (retiredSynths_.pop(old)) {
+            tsf_close(old->synth);
+            delete old;
+        }
+    }
+
+    // Fault in the samples a channel selecting this preset will play;
+    // returns their size in bytes
+    int64_t prefetchPreset(int preset, bool drums) {
+        int64_t bytes = 0;
+        withFontCopy([&](tsf* font) {
+            int index = SoundFontMemory::findPreset(font, preset, drums);
+            if (index < 0) {
+                return;
+            }
+            auto ranges = SoundFontMemory::presetRanges(font, index);
+            SoundFontMemory::prefetch(ranges);
+            bytes = SoundFontMemory::totalBytes(ranges);
+        });
+        return bytes;
+    }
+
+    // Output format, voice pool and channels of a new synth, allocated here
+    // so the audio thread only has to set values when it swaps the synth in
+    bool configureSoundFont(tsf* synth) {
+        tsf_set_output(synth, TSF_STEREO_INTERLEAVED, sampleRate_, 0.0f);
+        if (!tsf_set_max_voices(synth, maxVoices_.load(std::memory_order_relaxed))) {
+            LOGE("Failed to allocate voice pool");
+            return false;
+        }
+        for (int channel = 0; channel < MIDI_CHANNELS; channel++) {
+            if (!tsf_channel_set_volume(synth, channel, 1.0f)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // BlockSource: the synth, sequencer and metronome for one block of the
+    // timeline, onto the TIMELINE_BUSES. Runs on the callback, or on the
+    // synth thread when rendering ahead.
+    void renderBlock(float* const* buses, int32_t numFrames, int64_t blockStart) override {
+        TRACE_SCOPE("Render block");
+        float* score = buses[0];
+        float* click = buses[1];
+        memset(click, 0, numFrames * 2 * sizeof(float));
+
+        // A new font or voice pool takes over between blocks
+        synth_.install(sampleRate_);
+        tsf* synth = synth_.synth();
+        if (synth) {
+            int64_t begin = monotonicNanos();
+            renderBudget_.begin(synth, maxVoices_.load(std::memory_order_relaxed));
+            drainCommands(blockStart);
+            tempoMap_.update();
+            sequencer_.process(blockStart, numFrames, *this);
+            metronome_.process(blockStart, numFrames, *this);
+            renderScheduled(score, numFrames, blockStart);
+            synth_.renderReplaced(score, numFrames, sampleRate_);
+            int64_t scored = monotonicNanos();
+            metronome_.mix(click, numFrames);
+            renderBudget_.end(numFrames, sampleRate_);
+            mixer_.addRenderTime(Mixer::Score, scored - begin);
+            mixer_.addRenderTime(Mixer::Click, monotonicNanos() - scored);
+            publishVoiceStats(synth);
+        } else {
+            memset(score, 0, numFrames * 2 * sizeof(float));
+        }
+
+        framePosition_.store(blockStart + numFrames, std::memory_order_release);
+    }
+
+    // Notes played live, always rendered on the callback
+    void renderLive(float* output, int32_t numFrames) {
+        live_.install(sampleRate_);
+        drainLiveCommands();
+        if (!live_.synth()) {
+            memset(output, 0, numFrames * 2 * sizeof(float));
+            return;
+        }
+        TRACE_SCOPE("Synthesize live");
+        int64_t begin = monotonicNanos();
+        tsf_render_float(live_.synth(), output, numFrames, 0);
+        live_.renderReplaced(output, numFrames, sampleRate_);
+        mixer_.addRenderTime(Mixer::Keyboard, monotonicNanos() - begin);
+    }
+
+    void drainLiveCommands(bool playNotes = true) {
+        MidiCommand command;
+        int drained = 0;
+        while (liveCommands_.pop(command)) {
+            bool play = playNotes || command.type != MidiCommand::Type::NoteOn;
+            if (play && live_.synth() && command.channel < MIDI_CHANNELS) {
+                live_.apply(command);
+            }
+            drained++;
+        }
+        traceDrained("Live commands drained", drained, liveDrainedTraced_);
+    }
+
+    // Commands taken off a queue per drain, traced when it changes so an
+    // idle queue costs nothing
+    static void traceDrained(const char* name, int drained, int& traced) {
+        if (drained != traced) {
+            TRACE_COUNTER(name, drained);
+            traced = drained;
+        }
+    }
+
+    // Voice counters for getVoiceStats(), from the timeline's render thread
+    void publishVoiceStats(tsf* synth) {
+        int active = tsf_active_voice_count(synth);
+        activeVoices_.store(active, std::memory_order_relaxed);
+        TRACE_COUNTER("Active voices", active);
+        int stolen = tsf_get_stolen_voice_count(synth, 1);
+        if (stolen) {
+            stolenVoices_.fetch_add(stolen, std::memory_order_relaxed);
+        }
+        int blockPeak = tsf_get_peak_voice_count(synth, 1);
+        int peak = peakVoices_.load(std::memory_order_relaxed);
+        while (blockPeak > peak &&
+               !peakVoices_.compare_exchange_weak(peak, blockPeak, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Open the output with the lowest latency the device offers. Exclusive
+    // mode gets an MMAP stream on devices that support it; shared low latency
+    // works wherever AAudio does; the last config is for emulators.
+    oboe::Result openOutputStream() {
+        static constexpr struct {
+            oboe::PerformanceMode performanceMode;
+            oboe::SharingMode sharingMode;
+        } configs[] = {
+            {oboe::PerformanceMode::LowLatency, oboe::SharingMode::Exclusive},
+            {oboe::PerformanceMode::LowLatency, oboe::SharingMode::Shared},
+            {oboe::PerformanceMode::None, oboe::SharingMode::Shared},
+        };
+
+        oboe::Result result = oboe::Result::ErrorInternal;
+        for (const auto& config : configs) {
+            // Callback size is left to the device so every callback renders
+            // exactly one burst
+            oboe::AudioStreamBuilder builder;
+            builder.setDirection(oboe::Direction::Output)
+                   ->setPerformanceMode(config.performanceMode)
+                   ->setSharingMode(config.sharingMode)
+                   ->setFormat(oboe::AudioFormat::Float)
+                   ->setChannelCount(oboe::ChannelCount::Stereo)
+                   ->setDataCallback(this);
+
+            // Don't specify sample rate, let system choose
+            result = builder.openStream(stream_);
+            if (result == oboe::Result::OK) {
+                return result;
+            }
+            LOGW("Output stream %s/%s unavailable: %s",
+                 oboe::convertToText(config.performanceMode),
+                 oboe::convertToText(config.sharingMode),
+                 oboe::convertToText(result));
+        }
+        return result;
+    }
+
+    // MidiEventSink: sequencer output, already on the audio thread
+    void post(const MidiCommand& command) override {
+        if (scheduled_.size() < SCHEDULED_EVENT_CAPACITY) {
+            scheduled_.push_back({command, nextSeq_++});
+            std::push_heap(scheduled_.begin(), scheduled_.end(), laterThan);
+        } else if (synth_.synth()) {
+            apply(command);
+        }
+    }
+
+    void enqueue(const MidiCommand& command) {
+        if (command.frame == MidiCommand::IMMEDIATE) {
+            // A note played now goes to the live synth on the Keyboard bus,
+            // which the callback renders even when the timeline is rendered
+            // ahead. Note-offs also reach notes the timeline started;
+            // settings apply to both.
+            if (!liveCommands_.push(command)) {
+                // Queue full: the stream is stopped or stalled
+                if (droppedLiveCommands_.fetch_add(1, std::memory_order_relaxed) == 0) {
+                    LOGW("Live MIDI command queue full, dropping commands");
+                }
+            }
+            if (command.type == MidiCommand::Type::NoteOn) {
+                return;
+            }
+        }
+        if (!commands_.push(command)) {
+            // Queue full: the callback is not draining (stream stopped or stalled)
+            if (droppedCommands_.fetch_add(1, std::memory_order_relaxed) == 0) {
+                LOGW("MIDI command queue full, dropping commands");
+            }
+        }
+    }
+
+    // Heap entry for a future command; seq keeps same-frame events in
+    // submission order (e.g. a note-off before a repeated note-on)
+    struct ScheduledEvent {
+        MidiCommand command;
+        uint32_t seq;
+    };
+
+    static bool laterThan(const ScheduledEvent& a, const ScheduledEvent& b) {
+        return a.command.frame != b.command.frame ? a.command.frame > b.command.frame
+                                                  : a.seq > b.seq;
+    }
+
+    // Apply queued commands that are due and park the rest in scheduled_.
+    // Runs on the audio thread while the stream is started, otherwise on the
+    // control thread.
+    void drainCommands(int64_t now) {
+        MidiCommand command;
+        int drained = 0;
+        while (commands_.pop(command)) {
+            drained++;
+            if (!synth_.synth()) continue;
+            if (command.frame > now && scheduled_.size() < SCHEDULED_EVENT_CAPACITY) {
+                scheduled_.push_back({command, nextSeq_++});
+                std::push_heap(scheduled_.begin(), scheduled_.end(), laterThan);
+            } else {
+                // Due, or no room left to hold it: play late rather than drop
+                apply(command);
+            }
+        }
+        traceDrained("Commands drained", drained, drainedTraced_);
+    }
+
+    // Render numFrames, splitting at scheduled event frames so each event
+    // starts exactly on its target frame instead of the next buffer boundary
+    void renderScheduled(float* output, int32_t numFrames, int64_t blockStart) {
+        TRACE_SCOPE("Synthesize score");
+        int32_t rendered = 0;
+        while (rendered < numFrames) {
+            int64_t now = blockStart + rendered;
+            while (!scheduled_.empty() && scheduled_.front().command.frame <= now) {
+                std::pop_heap(scheduled_.begin(), scheduled_.end(), laterThan);
+                apply(scheduled_.back().command);
+                scheduled_.pop_back();
+            }
+
+            int32_t segment = numFrames - rendered;
+            if (!scheduled_.empty()) {
+                segment = static_cast<int32_t>(
+                    std::min<int64_t>(segment, scheduled_.front().command.frame - now));
+            }
+            renderPool_.render(synth_.synth(), output + rendered * 2, segment);
+            rendered += segment;
+        }
+    }
+
+    void apply(const MidiCommand& command) {
+        if (command.channel >= MIDI_CHANNELS) {
+            return;  // tsf would grow its channel table here on the callback
+        }
+        synth_.apply(command);
+        if (command.type == MidiCommand::Type::AllNotesOff) {
+            scheduled_.clear();
+        }
+    }
+
+    // Loaded font, never played itself; its copies are
+    tsf* font_ = nullptr;
+    std::shared_ptr<AAsset> fontAsset_;  // Backs font_'s samples when loaded from the APK
+    std::mutex fontMutex_;  // Guards font_ and reclaiming; the callback never takes it
+    std::atomic<bool> loaded_{false};
+    RetiredSynths retiredSynths_;
+    SynthSlot synth_{retiredSynths_};  // Plays the timeline
+    SynthSlot live_{retiredSynths_};   // Plays immediate notes
+
     std::shared_ptr<oboe::AudioStream> stream_;
-    std::mutex mutex_;
-    int sampleRate_ = 44100;
-    float volume_ = 0.8f;
+    std::unique_ptr<oboe::LatencyTuner> latencyTuner_;  // Used on the audio thread only
+    LockFreeQueue<MidiCommand, COMMAND_QUEUE_SIZE> commands_;
+    LockFreeQueue<MidiCommand, LIVE_COMMAND_QUEUE_SIZE> liveCommands_;
+    std::atomic<uint32_t> droppedCommands_{0};
+    std::atomic<uint32_t> droppedLiveCommands_{0};
+    std::vector<ScheduledEvent> scheduled_;  // Min-heap by frame, audio thread only
+    uint32_t nextSeq_ = 0;
+    int drainedTraced_ = 0;      // Last drain counts traced, with the queues' consumers
+    int liveDrainedTraced_ = 0;
+    std::atomic<int64_t> framePosition_{0};  // Rendered up to here
+    std::atomic<int64_t> outputFrame_{0};    // Played by the callback up to here
+    int64_t streamFrameBase_ = 0;  // outputFrame_ when the stream started
+    RenderAhead renderAhead_;
+    std::atomic<int> renderAheadBursts_{0};
+    std::atomic<bool> renderingAhead_{false};
+    TempoMap tempoMap_;
+    Sequencer sequencer_{tempoMap_};
+    Metronome metronome_{tempoMap_};
+    VoiceRenderPool renderPool_;
+    RenderBudget renderBudget_;
+    Mixer mixer_;
+    std::atomic<int> maxVoices_{DEFAULT_MAX_VOICES};  // Written under fontMutex_
+    std::atomic<int> activeVoices_{0};
+    std::atomic<int> peakVoices_{0};
+    std::atomic<int> stolenVoices_{0};
+    std::atomic<int> sampleRate_{44100};  // Also read by loads on other threads
+
+    // Telemetry, output callback only
+    float telemetryPeak_ = 0.0f;
+    float telemetryLoad_ = 0.0f;
+    int telemetryCountdown_ = 0;
 };
 
 std::unique_ptr<MidiEngine> createMidiEngine() {
@@ -238,6 +958,124 @@ MidiEngine* getMidiEngine() {
     return g_midiEngine.get();
 }
 
+// Compiled score arrays from Kotlin, indexed by note
+static std::vector<SequenceNote> readSequence(
+        JNIEnv* env,
+        jdoubleArray onsets,
+        jfloatArray durations,
+        jintArray notes,
+        jfloatArray velocities,
+        jintArray channels) {
+    jsize count = env->GetArrayLength(onsets);
+    std::vector<jdouble> onsetArr(count);
+    std::vector<jfloat> durationArr(count);
+    std::vector<jint> noteArr(count);
+    std::vector<jfloat> velocityArr(count);
+    std::vector<jint> channelArr(count);
+    env->GetDoubleArrayRegion(onsets, 0, count, onsetArr.data());
+    env->GetFloatArrayRegion(durations, 0, count, durationArr.data());
+    env->GetIntArrayRegion(notes, 0, count, noteArr.data());
+    env->GetFloatArrayRegion(velocities, 0, count, velocityArr.data());
+    env->GetIntArrayRegion(channels, 0, count, channelArr.data());
+
+    std::vector<SequenceNote> sequence(count);
+    for (jsize i = 0; i < count; i++) {
+        sequence[i] = {
+            onsetArr[i],
+            durationArr[i],
+            velocityArr[i],
+            static_cast<uint8_t>(channelArr[i] & 0x0F),
+            static_cast<uint8_t>(noteArr[i] & 0x7F)
+        };
+    }
+    return sequence;
+}
+
+// Offline render settings from Kotlin; programs may be null or hold up to 16
+static OfflineRenderOptions readRenderOptions(
+        JNIEnv* env,
+        jfloat tempo,
+        jint sampleRate,
+        jintArray programs) {
+    OfflineRenderOptions options;
+    options.tempo = tempo;
+    options.sampleRate = sampleRate;
+    if (programs) {
+        jsize count = std::min<jsize>(env->GetArrayLength(programs), 16);
+        jint values[16];
+        env->GetIntArrayRegion(programs, 0, count, values);
+        for (jsize i = 0; i < count; i++) {
+            options.channelPresets[i] = values[i] & 0x7F;
+        }
+    }
+    return options;
+}
+
+// Commands Kotlin packs between two submits; a ten-finger chord with its
+// releases is 20
+static constexpr int COMMAND_BUFFER_CAPACITY = 256;
+
+// Written by Kotlin through a direct ByteBuffer, one batch at a time (Kotlin
+// serializes writers), and read only inside submitCommands
+static MidiCommand g_commandBuffer[COMMAND_BUFFER_CAPACITY];
+
+static jobject getCommandBuffer(JNIEnv* env, jclass clazz) {
+    return env->NewDirectByteBuffer(g_commandBuffer, sizeof(g_commandBuffer));
+}
+
+// @CriticalNative: no JNIEnv or class argument and primitives only, so the
+// call costs little more than a C call. None of them may block.
+static jint submitCommands(jint count) {
+    TRACE_SCOPE("Submit commands");
+    count = std::clamp(count, 0, COMMAND_BUFFER_CAPACITY);
+    return getMidiEngine()->submit(g_commandBuffer, count);
+}
+
+static jlong getFramePosition() {
+    return getMidiEngine()->getFramePosition();
+}
+
+static jint getSampleRate() {
+    return getMidiEngine()->getSampleRate();
+}
+
+// Kotlin has no fences to read the live playhead with (VarHandle needs API
+// 33), so it reads this copy, filled by snapshotPlayhead
+static SequencerPlayhead g_playheadSnapshot{};
+
+static jobject getPlayheadBuffer(JNIEnv* env, jclass clazz) {
+    return env->NewDirectByteBuffer(&g_playheadSnapshot, sizeof(g_playheadSnapshot));
+}
+
+static void snapshotPlayhead() {
+    getMidiEngine()->sequencer().readPlayhead(g_playheadSnapshot);
+}
+
+bool registerMidiEngineNatives(JNIEnv* env) {
+    jclass engineClass = env->FindClass("net/tigr/musicsheetflow/audio/NativeMidiEngine");
+    if (!engineClass) {
+        env->ExceptionClear();
+        LOGE("NativeMidiEngine class not found");
+        return false;
+    }
+    static const JNINativeMethod methods[] = {
+        {"nativeGetCommandBuffer", "()Ljava/nio/ByteBuffer;", reinterpret_cast<void*>(getCommandBuffer)},
+        {"nativeSubmitCommands", "(I)I", reinterpret_cast<void*>(submitCommands)},
+        {"nativeGetFramePosition", "()J", reinterpret_cast<void*>(getFramePosition)},
+        {"nativeGetSampleRate", "()I", reinterpret_cast<void*>(getSampleRate)},
+        {"nativeGetPlayheadBuffer", "()Ljava/nio/ByteBuffer;", reinterpret_cast<void*>(getPlayheadBuffer)},
+        {"nativeSnapshotPlayhead", "()V", reinterpret_cast<void*>(snapshotPlayhead)},
+    };
+    jint result = env->RegisterNatives(engineClass, methods, sizeof(methods) / sizeof(methods[0]));
+    env->DeleteLocalRef(engineClass);
+    if (result != JNI_OK) {
+        env->ExceptionClear();
+        LOGE("Failed to register MIDI engine natives");
+        return false;
+    }
+    return true;
+}
+
 }  // namespace musicsheetflow
 
 // JNI functions
@@ -254,6 +1092,22 @@ Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeLoadSoundFont(
     return result ? JNI_TRUE : JNI_FALSE;
 }
 
+JNIEXPORT jboolean JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeLoadSoundFontAsset(
+        JNIEnv* env,
+        jobject thiz,
+        jobject assetManager,
+        jstring name) {
+    AAssetManager* assets = AAssetManager_fromJava(env, assetManager);
+    if (!assets) {
+        return JNI_FALSE;
+    }
+    const char* nameStr = env->GetStringUTFChars(name, nullptr);
+    bool result = musicsheetflow::getMidiEngine()->loadSoundFontAsset(assets, nameStr);
+    env->ReleaseStringUTFChars(name, nameStr);
+    return result ? JNI_TRUE : JNI_FALSE;
+}
+
 JNIEXPORT jboolean JNICALL
 Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeStart(
         JNIEnv* env,
@@ -269,83 +1123,462 @@ Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeStop(
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeNoteOn(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetChannelPreset(
         JNIEnv* env,
         jobject thiz,
-        jint note,
-        jfloat velocity) {
-    musicsheetflow::getMidiEngine()->noteOn(note, velocity);
+        jint channel,
+        jint preset,
+        jint bank) {
+    musicsheetflow::getMidiEngine()->setChannelPreset(channel, preset, bank);
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeNoteOff(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeLoadSequence(
         JNIEnv* env,
         jobject thiz,
-        jint note) {
-    musicsheetflow::getMidiEngine()->noteOff(note);
+        jdoubleArray onsets,
+        jfloatArray durations,
+        jintArray notes,
+        jfloatArray velocities,
+        jintArray channels) {
+    auto sequence = musicsheetflow::readSequence(env, onsets, durations, notes, velocities, channels);
+    musicsheetflow::getMidiEngine()->sequencer().load(sequence.data(), static_cast<int>(sequence.size()));
+}
+
+// Parses a .mid file and hands it to the sequencer with the file's tempo
+// map and programs. Returns [noteCount, tempoCount, lengthBeats,
+// programs x16, (beat, bpm) per tempo, (onset, duration, note, velocity,
+// channel) per note], or null if the file cannot be read.
+JNIEXPORT jdoubleArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeLoadMidiFile(
+        JNIEnv* env,
+        jobject thiz,
+        jbyteArray data) {
+    jsize size = env->GetArrayLength(data);
+    std::vector<jbyte> bytes(size);
+    env->GetByteArrayRegion(data, 0, size, bytes.data());
+
+    musicsheetflow::MidiFileData midi;
+    if (!musicsheetflow::MidiFile::parse(bytes.data(), bytes.size(), midi)) {
+        LOGE("Not a readable MIDI file (%d bytes)", size);
+        return nullptr;
+    }
+
+    auto* engine = musicsheetflow::getMidiEngine();
+    for (int channel = 0; channel < 16; channel++) {
+        if (midi.programs[channel] >= 0) {
+            engine->setChannelPreset(channel, midi.programs[channel], channel == 9 ? 1 : 0);
+        }
+    }
+    auto noteCount = static_cast<int>(midi.notes.size());
+    auto tempoCount = static_cast<int>(midi.tempos.size());
+    std::vector<musicsheetflow::TempoSegment> tempos;
+    for (const auto& tempo : midi.tempos) {
+        tempos.push_back({tempo.beat, tempo.bpm, false});
+    }
+    engine->tempoMap().set(tempos.data(), tempoCount);
+    engine->sequencer().load(midi.notes.data(), noteCount);
+
+    std::vector<jdouble> values;
+    values.reserve(3 + 16 + tempoCount * 2 + noteCount * 5);
+    values.push_back(noteCount);
+    values.push_back(tempoCount);
+    values.push_back(midi.lengthBeats);
+    values.insert(values.end(), std::begin(midi.programs), std::end(midi.programs));
+    for (const auto& tempo : midi.tempos) {
+        values.push_back(tempo.beat);
+        values.push_back(tempo.bpm);
+    }
+    for (const auto& note : midi.notes) {
+        values.push_back(note.onsetBeats);
+        values.push_back(note.durationBeats);
+        values.push_back(note.note);
+        values.push_back(note.velocity);
+        values.push_back(note.channel);
+    }
+    jdoubleArray result = env->NewDoubleArray(static_cast<jsize>(values.size()));
+    env->SetDoubleArrayRegion(result, 0, static_cast<jsize>(values.size()), values.data());
+    return result;
+}
+
+JNIEXPORT jfloatArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeRenderOffline(
+        JNIEnv* env,
+        jobject thiz,
+        jdoubleArray onsets,
+        jfloatArray durations,
+        jintArray notes,
+        jfloatArray velocities,
+        jintArray channels,
+        jfloat tempo,
+        jint sampleRate,
+        jintArray programs) {
+    auto sequence = musicsheetflow::readSequence(env, onsets, durations, notes, velocities, channels);
+    auto options = musicsheetflow::readRenderOptions(env, tempo, sampleRate, programs);
+    auto pcm = musicsheetflow::getMidiEngine()->renderOffline(sequence, options);
+    if (pcm.empty()) {
+        return nullptr;
+    }
+    jfloatArray result = env->NewFloatArray(static_cast<jsize>(pcm.size()));
+    if (result) {
+        env->SetFloatArrayRegion(result, 0, static_cast<jsize>(pcm.size()), pcm.data());
+    }
+    return result;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeRenderOfflineWav(
+        JNIEnv* env,
+        jobject thiz,
+        jdoubleArray onsets,
+        jfloatArray durations,
+        jintArray notes,
+        jfloatArray velocities,
+        jintArray channels,
+        jfloat tempo,
+        jint sampleRate,
+        jintArray programs,
+        jstring path,
+        jboolean floatSamples) {
+    auto sequence = musicsheetflow::readSequence(env, onsets, durations, notes, velocities, channels);
+    auto options = musicsheetflow::readRenderOptions(env, tempo, sampleRate, programs);
+    auto pcm = musicsheetflow::getMidiEngine()->renderOffline(sequence, options);
+    if (pcm.empty()) {
+        return JNI_FALSE;
+    }
+    const char* pathChars = env->GetStringUTFChars(path, nullptr);
+    std::string pathStr(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    bool ok = musicsheetflow::OfflineRenderer::writeWav(
+        pathStr, pcm.data(), static_cast<int64_t>(pcm.size() / 2), options.sampleRate, floatSamples == JNI_TRUE);
+    if (!ok) {
+        LOGE("Failed to write %s", pathStr.c_str());
+    }
+    return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerPlay(
+        JNIEnv* env,
+        jobject thiz) {
+    musicsheetflow::getMidiEngine()->sequencer().play();
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerPause(
+        JNIEnv* env,
+        jobject thiz) {
+    musicsheetflow::getMidiEngine()->sequencer().pause();
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeAllNotesOff(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerStop(
         JNIEnv* env,
         jobject thiz) {
-    musicsheetflow::getMidiEngine()->allNotesOff();
+    musicsheetflow::getMidiEngine()->sequencer().stop();
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetVolume(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerSeek(
         JNIEnv* env,
         jobject thiz,
-        jfloat volume) {
-    musicsheetflow::getMidiEngine()->setVolume(volume);
+        jdouble beat) {
+    musicsheetflow::getMidiEngine()->sequencer().seek(beat);
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeNoteOnChannel(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerSetTempo(
         JNIEnv* env,
         jobject thiz,
-        jint channel,
-        jint note,
-        jfloat velocity) {
-    musicsheetflow::getMidiEngine()->noteOnChannel(channel, note, velocity);
+        jfloat bpm) {
+    musicsheetflow::getMidiEngine()->tempoMap().setTempo(bpm);
 }
 
+// One entry per segment start; ramps[i] glides to the next entry's tempo
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeNoteOffChannel(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetTempoMap(
         JNIEnv* env,
         jobject thiz,
-        jint channel,
-        jint note) {
-    musicsheetflow::getMidiEngine()->noteOffChannel(channel, note);
+        jdoubleArray beats,
+        jfloatArray bpms,
+        jbooleanArray ramps) {
+    jsize count = env->GetArrayLength(beats);
+    std::vector<jdouble> beatArr(count);
+    std::vector<jfloat> bpmArr(count);
+    std::vector<jboolean> rampArr(count);
+    env->GetDoubleArrayRegion(beats, 0, count, beatArr.data());
+    env->GetFloatArrayRegion(bpms, 0, count, bpmArr.data());
+    env->GetBooleanArrayRegion(ramps, 0, count, rampArr.data());
+
+    std::vector<musicsheetflow::TempoSegment> segments(count);
+    for (jsize i = 0; i < count; i++) {
+        segments[i] = {beatArr[i], bpmArr[i], rampArr[i] == JNI_TRUE};
+    }
+    musicsheetflow::getMidiEngine()->tempoMap().set(segments.data(), count);
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetChannelPreset(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetTempoScale(
         JNIEnv* env,
         jobject thiz,
-        jint channel,
-        jint preset,
-        jint bank) {
-    musicsheetflow::getMidiEngine()->setChannelPreset(channel, preset, bank);
+        jfloat scale) {
+    musicsheetflow::getMidiEngine()->tempoMap().setScale(scale);
 }
 
 JNIEXPORT void JNICALL
-Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeBatchNoteOn(
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerSetLoop(
         JNIEnv* env,
         jobject thiz,
-        jintArray notes,
-        jfloatArray velocities) {
-    jint* noteArr = env->GetIntArrayElements(notes, nullptr);
-    jfloat* velArr = env->GetFloatArrayElements(velocities, nullptr);
-    jsize count = env->GetArrayLength(notes);
+        jdouble startBeat,
+        jdouble endBeat) {
+    musicsheetflow::getMidiEngine()->sequencer().setLoop(startBeat, endBeat);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSequencerClearLoop(
+        JNIEnv* env,
+        jobject thiz) {
+    musicsheetflow::getMidiEngine()->sequencer().clearLoop();
+}
 
-    auto* engine = dynamic_cast<musicsheetflow::MidiEngineImpl*>(musicsheetflow::getMidiEngine());
-    if (engine) {
-        engine->batchNoteOn(noteArr, velArr, count);
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeStart(
+        JNIEnv* env,
+        jobject thiz,
+        jint countInBeats) {
+    musicsheetflow::getMidiEngine()->metronome().start(countInBeats);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeStop(
+        JNIEnv* env,
+        jobject thiz) {
+    musicsheetflow::getMidiEngine()->metronome().stop();
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeSetTempo(
+        JNIEnv* env,
+        jobject thiz,
+        jfloat bpm) {
+    musicsheetflow::getMidiEngine()->tempoMap().setTempo(bpm);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeSetBeatsPerMeasure(
+        JNIEnv* env,
+        jobject thiz,
+        jint beats) {
+    musicsheetflow::getMidiEngine()->metronome().setBeatsPerMeasure(beats);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeSetSound(
+        JNIEnv* env,
+        jobject thiz,
+        jint sound) {
+    musicsheetflow::getMidiEngine()->metronome().setSound(
+        sound == 1 ? musicsheetflow::ClickSound::Woodblock : musicsheetflow::ClickSound::Synth);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeSetAudible(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean audible) {
+    musicsheetflow::getMidiEngine()->metronome().setAudible(audible == JNI_TRUE);
+}
+
+// Fill the arrays with pending beats; returns how many were written
+JNIEXPORT jint JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativePollBeatEvents(
+        JNIEnv* env,
+        jobject thiz,
+        jintArray beats,
+        jlongArray frames,
+        jlongArray timesNanos) {
+    auto* engine = musicsheetflow::getMidiEngine();
+    jsize capacity = env->GetArrayLength(beats);
+    std::vector<jint> beatArr(capacity);
+    std::vector<jlong> frameArr(capacity);
+    std::vector<jlong> timeArr(capacity);
+
+    jsize count = 0;
+    musicsheetflow::BeatEvent event;
+    while (count < capacity && engine->metronome().pollBeat(event)) {
+        beatArr[count] = event.beat;
+        frameArr[count] = event.frame;
+        timeArr[count] = engine->getFrameTimeNanos(event.frame);
+        count++;
     }
 
-    env->ReleaseIntArrayElements(notes, noteArr, 0);
-    env->ReleaseFloatArrayElements(velocities, velArr, 0);
+    if (count > 0) {
+        env->SetIntArrayRegion(beats, 0, count, beatArr.data());
+        env->SetLongArrayRegion(frames, 0, count, frameArr.data());
+        env->SetLongArrayRegion(timesNanos, 0, count, timeArr.data());
+    }
+    return count;
+}
+
+// When a metronome beat (fractional for notes between beats) is heard, on
+// the CLOCK_MONOTONIC clock; -1 while the metronome is stopped
+JNIEXPORT jlong JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeMetronomeBeatTimeNanos(
+        JNIEnv* env,
+        jobject thiz,
+        jdouble beat) {
+    auto* engine = musicsheetflow::getMidiEngine();
+    int64_t frame = engine->metronome().beatFrame(beat);
+    return frame < 0 ? -1 : engine->getFrameTimeNanos(frame);
+}
+
+JNIEXPORT jdouble JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeGetOutputLatencyMillis(
+        JNIEnv* env,
+        jobject thiz) {
+    return musicsheetflow::getMidiEngine()->getOutputLatencyMillis();
+}
+
+JNIEXPORT jboolean JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetParallelRender(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled) {
+    return musicsheetflow::getMidiEngine()->setParallelRender(enabled == JNI_TRUE) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetRenderAhead(
+        JNIEnv* env,
+        jobject thiz,
+        jint bursts) {
+    musicsheetflow::getMidiEngine()->setRenderAhead(bursts);
+}
+
+// Writes [voices, workers, serialMicros, parallelMicros] into result
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeBenchmarkRender(
+        JNIEnv* env,
+        jobject thiz,
+        jint voices,
+        jdoubleArray result) {
+    auto benchmark = musicsheetflow::getMidiEngine()->benchmarkRender(voices);
+    jdouble values[4] = {
+        static_cast<jdouble>(benchmark.voices),
+        static_cast<jdouble>(benchmark.workers),
+        benchmark.serialMicros,
+        benchmark.parallelMicros
+    };
+    env->SetDoubleArrayRegion(result, 0, 4, values);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetMaxVoices(
+        JNIEnv* env,
+        jobject thiz,
+        jint voices) {
+    musicsheetflow::getMidiEngine()->setMaxVoices(voices);
+}
+
+// [active, peak, stolen, capacity]
+JNIEXPORT jintArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeGetVoiceStats(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean resetPeak) {
+    auto stats = musicsheetflow::getMidiEngine()->getVoiceStats(resetPeak == JNI_TRUE);
+    jint values[4] = {stats.active, stats.peak, stats.stolen, stats.capacity};
+    jintArray result = env->NewIntArray(4);
+    env->SetIntArrayRegion(result, 0, 4, values);
+    return result;
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetRenderBudget(
+        JNIEnv* env,
+        jobject thiz,
+        jfloat fraction) {
+    musicsheetflow::getMidiEngine()->setRenderBudget(fraction);
+}
+
+// [level, load, peak load, budget, over budget, degraded, restored, culled voices]
+JNIEXPORT jdoubleArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeGetRenderLoad(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean resetPeak) {
+    auto load = musicsheetflow::getMidiEngine()->getRenderLoad(resetPeak == JNI_TRUE);
+    jdouble values[8] = {
+        static_cast<jdouble>(load.level),
+        load.load,
+        load.peakLoad,
+        load.budget,
+        static_cast<jdouble>(load.overBudget),
+        static_cast<jdouble>(load.degraded),
+        static_cast<jdouble>(load.restored),
+        static_cast<jdouble>(load.culledVoices)
+    };
+    jdoubleArray result = env->NewDoubleArray(8);
+    env->SetDoubleArrayRegion(result, 0, 8, values);
+    return result;
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetBusGain(
+        JNIEnv* env,
+        jobject thiz,
+        jint bus,
+        jfloat gain) {
+    musicsheetflow::getMidiEngine()->setBusGain(bus, gain);
+}
+
+JNIEXPORT void JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeSetBusPan(
+        JNIEnv* env,
+        jobject thiz,
+        jint bus,
+        jfloat pan) {
+    musicsheetflow::getMidiEngine()->setBusPan(bus, pan);
+}
+
+// [gain, pan, peak, load] per bus, then the lowest limiter gain
+JNIEXPORT jdoubleArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeGetMixStats(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean reset) {
+    auto stats = musicsheetflow::getMidiEngine()->getMixStats(reset == JNI_TRUE);
+    constexpr int count = musicsheetflow::Mixer::BusCount * 4 + 1;
+    jdouble values[count];
+    for (int bus = 0; bus < musicsheetflow::Mixer::BusCount; bus++) {
+        values[bus * 4] = stats.buses[bus].gain;
+        values[bus * 4 + 1] = stats.buses[bus].pan;
+        values[bus * 4 + 2] = stats.buses[bus].peak;
+        values[bus * 4 + 3] = stats.buses[bus].load;
+    }
+    values[count - 1] = stats.limiterGain;
+    jdoubleArray result = env->NewDoubleArray(count);
+    env->SetDoubleArrayRegion(result, 0, count, values);
+    return result;
+}
+
+// Four values per preset: bank, preset number, sample bytes, resident bytes
+JNIEXPORT jlongArray JNICALL
+Java_net_tigr_musicsheetflow_audio_NativeMidiEngine_nativeGetPresetMemory(
+        JNIEnv* env,
+        jobject thiz) {
+    auto presets = musicsheetflow::getMidiEngine()->getPresetMemory();
+    std::vector<jlong> values;
+    values.reserve(presets.size() * 4);
+    for (const auto& preset : presets) {
+        values.push_back(preset.bank);
+        values.push_back(preset.preset);
+        values.push_back(preset.sampleBytes);
+        values.push_back(preset.residentBytes);
+    }
+    jlongArray result = env->NewLongArray(static_cast<jsize>(values.size()));
+    env->SetLongArrayRegion(result, 0, static_cast<jsize>(values.size()), values.data());
+    return result;
 }
 
 }  // extern "C"
@@ -1,21 +1,52 @@
 #pragma once
 
+#include "metronome.h"
+#include "midi_command.h"
+#include "mixer.h"
+#include "offline_render.h"
+#include "render_budget.h"
+#include "sequencer.h"
+#include "soundfont_memory.h"
+#include "tempo_map.h"
+#include "voice_render_pool.h"
+#include <android/asset_manager.h>
+#include <jni.h>
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace musicsheetflow {
 
+// Synth voice pool usage
+struct VoiceStats {
+    int active;    // Voices playing after the last render callback
+    int peak;      // Most voices playing at once since the last reset
+    int stolen;    // Voices cut off to start new notes since the engine was created
+    int capacity;  // Pool size
+};
+
 class MidiEngine {
 public:
     virtual ~MidiEngine() = default;
 
+    // Fonts are .sf2 or baked by tools/soundfont_bake (tsf detects which).
+    // Loading blocks the caller, not the output: the new font takes over
+    // between two render callbacks and notes already sounding finish on
+    // the old one.
     virtual bool loadSoundFont(const std::string& path) = 0;
+    // Load a SoundFont stored in the APK; an uncompressed entry is mapped
+    // and its samples are used in place
+    virtual bool loadSoundFontAsset(AAssetManager* assets, const std::string& name) = 0;
     virtual bool isLoaded() const = 0;
 
     virtual void noteOn(int note, float velocity = 0.8f) = 0;
     virtual void noteOff(int note) = 0;
     virtual void allNotesOff() = 0;
-    virtual void batchNoteOn(const int* notes, const float* velocities, int count) = 0;
+    // Queue a batch of immediate or scheduled commands at once; returns how
+    // many were valid. Presets are left out: setChannelPreset pages their
+    // samples in, which may block.
+    virtual int submit(const MidiCommand* commands, int count) = 0;
 
     virtual void noteOnChannel(int channel, int note, float velocity = 0.8f) = 0;
     virtual void noteOffChannel(int channel, int note) = 0;
@@ -23,6 +54,65 @@ public:
 
     virtual void setVolume(float volume) = 0;  // 0.0 - 1.0
 
+    // Sample-accurate scheduling on the output frame clock
+    virtual int64_t getFramePosition() const = 0;  // Frames rendered so far
+    virtual int getSampleRate() const = 0;
+    virtual void scheduleNoteOn(int channel, int note, float velocity, int64_t frame) = 0;
+    virtual void scheduleNoteOff(int channel, int note, int64_t frame) = 0;
+
+    // Score sequencer played from the render callback
+    virtual Sequencer& sequencer() = 0;
+
+    // Tempo changes and practice speed, shared by the sequencer and metronome
+    virtual TempoMap& tempoMap() = 0;
+
+    // Click generator mixed into the output
+    virtual Metronome& metronome() = 0;
+
+    // CLOCK_MONOTONIC time at which an output frame reaches the speaker
+    virtual int64_t getFrameTimeNanos(int64_t frame) = 0;
+
+    // Time from rendering a frame to hearing it; 0 while stopped
+    virtual double getOutputLatencyMillis() = 0;
+
+    // Fixed voice pool: note-ons take free voices or steal one, so the render
+    // callback never allocates. Resizing swaps in a new synth the way a
+    // font load does.
+    virtual void setMaxVoices(int voices) = 0;
+    virtual VoiceStats getVoiceStats(bool resetPeak) = 0;
+
+    // Share of each callback period the synth may take before it trades
+    // quality for speed (see RenderBudget), and what it has done about it
+    virtual void setRenderBudget(float fraction) = 0;
+    virtual RenderLoad getRenderLoad(bool resetPeak) = 0;
+
+    // Render the timeline this many bursts ahead on a synth thread, so a slow
+    // block no longer underruns the stream; immediate notes are still
+    // synthesized in the callback. 0 (the default) renders in the callback.
+    // Takes effect at the next start().
+    virtual void setRenderAhead(int bursts) = 0;
+
+    // Output mix: notes played now go to the Keyboard bus, everything on the
+    // timeline to Score, and the synthesized click to Click (see Mixer)
+    virtual void setBusGain(int bus, float gain) = 0;
+    virtual void setBusPan(int bus, float pan) = 0;
+    virtual MixStats getMixStats(bool reset) = 0;
+
+    // Spread dense polyphony over worker threads; false when the device has
+    // too few cores for it to pay off
+    virtual bool setParallelRender(bool enabled) = 0;
+
+    // Render a compiled score with the loaded font, off the output stream and
+    // as fast as the CPU allows (see OfflineRenderer); empty without a font
+    virtual std::vector<float> renderOffline(const std::vector<SequenceNote>& notes,
+                                             const OfflineRenderOptions& options) = 0;
+
+    // Sample memory of every preset in the loaded font, and how much is paged in
+    virtual std::vector<PresetMemory> getPresetMemory() = 0;
+
+    // Time a block of `voices` held notes rendered serially and in parallel
+    virtual RenderBenchmark benchmarkRender(int voices) = 0;
+
     virtual bool start() = 0;
     virtual void stop() = 0;
 };
@@ -30,4 +120,7 @@ public:
 // Factory function
 std::unique_ptr<MidiEngine> createMidiEngine();
 
+// Registers NativeMidiEngine's hot entry points, from JNI_OnLoad
+bool registerMidiEngineNatives(JNIEnv* env);
+
 }  // namespace musicsheetflow
@@ -0,0 +1,130 @@
+#include "midi_file.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <deque>
+
+#define TML_IMPLEMENTATION
+#define TML_NO_STDIO
+#include "third_party/tml.h"
+
+namespace musicsheetflow {
+
+static constexpr int MIDI_CHANNELS = 16;
+static constexpr int MIDI_KEYS = 128;
+
+// Beats snap to this grid. tml rounds message times down to whole
+// milliseconds; 1/96 beat holds 64th notes and their triplets while
+// absorbing that rounding at any practical tempo.
+static constexpr double BEAT_GRID = 96.0;
+
+// SMF default until the file sets a tempo: 120 BPM
+static constexpr double DEFAULT_MICROS_PER_BEAT = 500000.0;
+
+static double snapToGrid(double beat) {
+    return std::round(beat * BEAT_GRID) / BEAT_GRID;
+}
+
+namespace {
+
+struct OpenNote {
+    double onset;
+    float velocity;
+};
+
+}  // namespace
+
+bool MidiFile::parse(const void* data, size_t size, MidiFileData& out) {
+    if (!data || size == 0 || size > INT_MAX) {
+        return false;
+    }
+    tml_message* first = tml_load_memory(data, static_cast<int>(size));
+    if (!first) {
+        return false;
+    }
+
+    out.notes.clear();
+    out.tempos.assign(1, {0.0, static_cast<float>(60e6 / DEFAULT_MICROS_PER_BEAT)});
+    std::fill(std::begin(out.programs), std::end(out.programs), -1);
+    out.lengthBeats = 0.0;
+
+    int firstPrograms[MIDI_CHANNELS];
+    std::fill(std::begin(firstPrograms), std::end(firstPrograms), -1);
+    std::vector<std::deque<OpenNote>> open(MIDI_CHANNELS * MIDI_KEYS);
+
+    // Beats are counted from the last tempo change, which sits on the grid,
+    // so millisecond rounding does not build up over many changes
+    double tempoBeat = 0.0;
+    unsigned int tempoMillis = 0;
+    double microsPerBeat = DEFAULT_MICROS_PER_BEAT;
+
+    for (tml_message* message = first; message; message = message->next) {
+        double beat = snapToGrid(tempoBeat + (message->time - tempoMillis) * 1000.0 / microsPerBeat);
+        out.lengthBeats = std::max(out.lengthBeats, beat);
+        int channel = message->channel & 0x0F;
+        int key = message->key & 0x7F;
+        int velocity = message->velocity & 0x7F;
+
+        switch (message->type) {
+            case TML_SET_TEMPO: {
+                int micros = tml_get_tempo_value(message);
+                if (micros <= 0) {
+                    break;
+                }
+                tempoBeat = beat;
+                tempoMillis = message->time;
+                microsPerBeat = micros;
+                auto bpm = static_cast<float>(60e6 / micros);
+                if (out.tempos.back().beat == beat) {
+                    out.tempos.back().bpm = bpm;  // Several tracks may set it at once
+                } else if (out.tempos.back().bpm != bpm) {
+                    out.tempos.push_back({beat, bpm});
+                }
+                break;
+            }
+            case TML_PROGRAM_CHANGE:
+                if (firstPrograms[channel] < 0) {
+                    firstPrograms[channel] = message->program & 0x7F;
+                }
+                break;
+            case TML_NOTE_ON:
+                if (velocity > 0) {
+                    open[channel * MIDI_KEYS + key].push_back({beat, velocity / 127.0f});
+                    break;
+                }
+                [[fallthrough]];  // Running-status files release with velocity 0
+            case TML_NOTE_OFF: {
+                std::deque<OpenNote>& held = open[channel * MIDI_KEYS + key];
+                if (held.empty()) {
+                    break;  // Stray note-off
+                }
+                const OpenNote& note = held.front();
+                out.notes.push_back({note.onset, static_cast<float>(beat - note.onset), note.velocity,
+                                     static_cast<uint8_t>(channel), static_cast<uint8_t>(key)});
+                held.pop_front();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    tml_free(first);
+
+    // Notes never released end with the file
+    for (int index = 0; index < MIDI_CHANNELS * MIDI_KEYS; index++) {
+        for (const OpenNote& note : open[index]) {
+            out.notes.push_back({note.onset, static_cast<float>(out.lengthBeats - note.onset), note.velocity,
+                                 static_cast<uint8_t>(index / MIDI_KEYS), static_cast<uint8_t>(index % MIDI_KEYS)});
+        }
+    }
+
+    std::stable_sort(out.notes.begin(), out.notes.end(),
+                     [](const SequenceNote& a, const SequenceNote& b) { return a.onsetBeats < b.onsetBeats; });
+    for (const SequenceNote& note : out.notes) {
+        // GM channels start on program 0 until told otherwise
+        out.programs[note.channel] = std::max(firstPrograms[note.channel], 0);
+    }
+    return true;
+}
+
+}  // namespace musicsheetflow
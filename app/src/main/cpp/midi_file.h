@@ -0,0 +1,39 @@
+#pragma once
+
+#include "sequencer.h"
+#include <cstddef>
+#include <vector>
+
+namespace musicsheetflow {
+
+// Tempo in force from `beat` on
+struct TempoChange {
+    double beat;
+    float bpm;
+};
+
+// A Standard MIDI File compiled into the sequencer's note list
+struct MidiFileData {
+    std::vector<SequenceNote> notes;  // In onset order
+    std::vector<TempoChange> tempos;  // Starts at beat 0
+    int programs[16];                 // GM program per channel, -1 where no notes play
+    double lengthBeats = 0.0;         // Up to the last message
+};
+
+/**
+ * Reads .mid files with TinySoundFont's tml loader.
+ *
+ * tml resolves the file to messages timed in milliseconds; the tempo
+ * changes among them map those times back to beats, which the sequencer
+ * and the score tracker work in. Each note-off closes the earliest open
+ * note-on on its key, and a channel keeps the first program it selects.
+ *
+ * Uses only tml and the standard library, so the host tools build it too.
+ */
+class MidiFile {
+public:
+    // False if `data` is not a readable Standard MIDI File
+    static bool parse(const void* data, size_t size, MidiFileData& out);
+};
+
+}  // namespace musicsheetflow
@@ -0,0 +1,152 @@
+#include "mixer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace musicsheetflow {
+
+// Gain and balance changes glide over this long
+static constexpr float RAMP_MILLIS = 10.0f;
+
+static constexpr float MAX_BUS_GAIN = 2.0f;
+
+// -1 dBFS, so the limited sum has room for the DAC's reconstruction peaks
+static constexpr float LIMITER_THRESHOLD = 0.891f;
+
+// The limiter clamps instantly and lets go over this long
+static constexpr float LIMITER_RELEASE_MILLIS = 120.0f;
+
+// Balance law for stereo sources: centre leaves both sides at unity
+static void balanceGains(float gain, float pan, float& left, float& right) {
+    left = gain * std::min(1.0f, 1.0f - pan);
+    right = gain * std::min(1.0f, 1.0f + pan);
+}
+
+Mixer::Mixer() {
+    for (auto& bus : buses_) {
+        bus.assign(static_cast<size_t>(MAX_FRAMES) * 2, 0.0f);
+    }
+    setSampleRate(sampleRate_);
+}
+
+void Mixer::setSampleRate(int sampleRate) {
+    sampleRate_ = sampleRate;
+    rampLength_ = std::max(1, static_cast<int32_t>(RAMP_MILLIS * sampleRate / 1000.0f));
+    releaseCoefficient_ = 1.0f - std::exp(-1000.0f / (LIMITER_RELEASE_MILLIS * sampleRate));
+}
+
+void Mixer::setGain(Bus bus, float gain) {
+    channels_[bus].gain.store(std::clamp(gain, 0.0f, MAX_BUS_GAIN), std::memory_order_relaxed);
+}
+
+void Mixer::setPan(Bus bus, float pan) {
+    channels_[bus].pan.store(std::clamp(pan, -1.0f, 1.0f), std::memory_order_relaxed);
+}
+
+MixStats Mixer::getStats(bool reset) {
+    MixStats stats;
+    int64_t frames = reset ? mixedFrames_.exchange(0, std::memory_order_relaxed)
+                           : mixedFrames_.load(std::memory_order_relaxed);
+    double audioNanos = frames * 1e9 / sampleRate_;
+    for (int i = 0; i < BusCount; i++) {
+        Channel& channel = channels_[i];
+        BusStats& bus = stats.buses[i];
+        bus.gain = channel.gain.load(std::memory_order_relaxed);
+        bus.pan = channel.pan.load(std::memory_order_relaxed);
+        int64_t nanos;
+        if (reset) {
+            bus.peak = channel.peak.exchange(0.0f, std::memory_order_relaxed);
+            nanos = channel.renderNanos.exchange(0, std::memory_order_relaxed);
+        } else {
+            bus.peak = channel.peak.load(std::memory_order_relaxed);
+            nanos = channel.renderNanos.load(std::memory_order_relaxed);
+        }
+        bus.load = audioNanos > 0.0 ? static_cast<float>(nanos / audioNanos) : 0.0f;
+    }
+    stats.limiterGain = reset ? limiterLow_.exchange(1.0f, std::memory_order_relaxed)
+                              : limiterLow_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Mixer::addRenderTime(Bus bus, int64_t nanos) {
+    channels_[bus].renderNanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+void Mixer::mix(float* output, int32_t numFrames) {
+    std::fill(output, output + numFrames * 2, 0.0f);
+    for (int i = 0; i < BusCount; i++) {
+        mixBus(channels_[i], buses_[i].data(), output, numFrames);
+    }
+    limit(output, numFrames);
+    mixedFrames_.fetch_add(numFrames, std::memory_order_relaxed);
+}
+
+void Mixer::mixBus(Channel& channel, const float* input, float* output, int32_t numFrames) {
+    float targetLeft, targetRight;
+    balanceGains(channel.gain.load(std::memory_order_relaxed),
+                 channel.pan.load(std::memory_order_relaxed), targetLeft, targetRight);
+    if (targetLeft != channel.targetLeft || targetRight != channel.targetRight) {
+        // Glide from wherever the last ramp got to
+        channel.targetLeft = targetLeft;
+        channel.targetRight = targetRight;
+        channel.rampFrames = rampLength_;
+        channel.stepLeft = (targetLeft - channel.left) / rampLength_;
+        channel.stepRight = (targetRight - channel.right) / rampLength_;
+    }
+
+    float peak = 0.0f;
+    int32_t frame = 0;
+    for (; frame < numFrames && channel.rampFrames > 0; frame++, channel.rampFrames--) {
+        channel.left += channel.stepLeft;
+        channel.right += channel.stepRight;
+        float left = input[frame * 2] * channel.left;
+        float right = input[frame * 2 + 1] * channel.right;
+        output[frame * 2] += left;
+        output[frame * 2 + 1] += right;
+        peak = std::max(peak, std::max(std::fabs(left), std::fabs(right)));
+    }
+    if (channel.rampFrames == 0) {
+        channel.left = channel.targetLeft;
+        channel.right = channel.targetRight;
+    }
+    if (channel.left == 0.0f && channel.right == 0.0f) {
+        frame = numFrames;  // Muted
+    }
+    const float gainLeft = channel.left;
+    const float gainRight = channel.right;
+    for (; frame < numFrames; frame++) {
+        float left = input[frame * 2] * gainLeft;
+        float right = input[frame * 2 + 1] * gainRight;
+        output[frame * 2] += left;
+        output[frame * 2 + 1] += right;
+        peak = std::max(peak, std::max(std::fabs(left), std::fabs(right)));
+    }
+
+    if (peak > channel.peak.load(std::memory_order_relaxed)) {
+        channel.peak.store(peak, std::memory_order_relaxed);
+    }
+}
+
+// Peak limiter: the gain drops at once to keep each frame under the
+// threshold and recovers exponentially, so loud chords are tamed without
+// the harmonics of hard clipping
+void Mixer::limit(float* output, int32_t numFrames) {
+    float gain = limiterGain_;
+    float lowest = gain;
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        float left = output[frame * 2];
+        float right = output[frame * 2 + 1];
+        float peak = std::max(std::fabs(left), std::fabs(right));
+        float target = peak > LIMITER_THRESHOLD ? LIMITER_THRESHOLD / peak : 1.0f;
+        gain = target < gain ? target : gain + (1.0f - gain) * releaseCoefficient_;
+        gain = std::min(gain, target);
+        lowest = std::min(lowest, gain);
+        output[frame * 2] = left * gain;
+        output[frame * 2 + 1] = right * gain;
+    }
+    limiterGain_ = gain;
+    if (lowest < limiterLow_.load(std::memory_order_relaxed)) {
+        limiterLow_.store(lowest, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace musicsheetflow
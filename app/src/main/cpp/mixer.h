@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace musicsheetflow {
+
+// Output level and render cost of one mixer bus
+struct BusStats {
+    float gain = 1.0f;
+    float pan = 0.0f;
+    float peak = 0.0f;  // Highest sample after gain since the last reset
+    float load = 0.0f;  // Render time as a share of the audio it produced
+};
+
+struct MixStats;
+
+/**
+ * Sums the engine's sound sources into the output stream.
+ *
+ * Each source renders into its own preallocated stereo bus. The mixer
+ * applies the bus gain and balance, ramped so a change never clicks, adds
+ * the buses up and runs the sum through a peak limiter. Sources report
+ * their render time per bus, from whichever thread renders them.
+ */
+class Mixer {
+public:
+    enum Bus {
+        Score,     // Sequencer, scheduled notes and woodblock clicks
+        Keyboard,  // Notes played live
+        Click,     // Synthesized metronome click
+        BusCount
+    };
+
+    // Longest block mix() takes; the callback splits longer ones
+    static constexpr int32_t MAX_FRAMES = 1024;
+
+    Mixer();
+
+    // Control thread, stream stopped
+    void setSampleRate(int sampleRate);
+
+    // Any thread; picked up at the next block
+    void setGain(Bus bus, float gain);  // 0.0 - 2.0
+    void setPan(Bus bus, float pan);    // -1.0 (left) - 1.0 (right)
+    MixStats getStats(bool reset);
+
+    // Render threads
+    void addRenderTime(Bus bus, int64_t nanos);
+
+    // Audio thread: the buses, each MAX_FRAMES stereo frames, and their sum
+    // into output (numFrames <= MAX_FRAMES)
+    float* bus(Bus bus) { return buses_[bus].data(); }
+    void mix(float* output, int32_t numFrames);
+
+private:
+    struct alignas(64) Channel {
+        std::atomic<float> gain{1.0f};
+        std::atomic<float> pan{0.0f};
+        std::atomic<float> peak{0.0f};
+        std::atomic<int64_t> renderNanos{0};
+
+        // Audio thread
+        float left = 1.0f;
+        float right = 1.0f;
+        float targetLeft = 1.0f;
+        float targetRight = 1.0f;
+        float stepLeft = 0.0f;
+        float stepRight = 0.0f;
+        int32_t rampFrames = 0;  // Left in the current ramp
+    };
+
+    void mixBus(Channel& channel, const float* input, float* output, int32_t numFrames);
+    void limit(float* output, int32_t numFrames);
+
+    std::vector<float> buses_[BusCount];
+    Channel channels_[BusCount];
+    std::atomic<int64_t> mixedFrames_{0};
+    std::atomic<float> limiterLow_{1.0f};
+    int sampleRate_ = 44100;
+    int32_t rampLength_ = 441;
+    float releaseCoefficient_ = 0.0f;
+    float limiterGain_ = 1.0f;  // Audio thread
+};
+
+struct MixStats {
+    BusStats buses[Mixer::BusCount];
+    float limiterGain = 1.0f;  // Lowest limiter gain since the last reset
+};
+
+}  // namespace musicsheetflow
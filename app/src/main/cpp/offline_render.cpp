@@ -0,0 +1,222 @@
+#include "offline_render.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "third_party/tsf.h"
+
+namespace musicsheetflow {
+
+// Render calls never cross a multiple of this, so the scout and the chunks
+// cut the timeline (and tsf's effect blocks) at the same frames
+static constexpr int32_t GRID_FRAMES = 1024;
+
+// The grid step before each chunk boundary is rendered for real by the scout,
+// long enough for the voice lowpass filters to settle
+static constexpr int32_t WARMUP_FRAMES = GRID_FRAMES;
+
+static constexpr int MIDI_CHANNELS = 16;
+static constexpr int DRUM_CHANNEL = 9;
+
+namespace {
+
+struct OfflineEvent {
+    int64_t frame;
+    float velocity;  // 0 for note-off
+    uint8_t channel;
+    uint8_t note;
+};
+
+// Play position of one synth instance along the event list
+struct Cursor {
+    int64_t frame = 0;
+    size_t event = 0;
+};
+
+std::vector<OfflineEvent> compileEvents(const SequenceNote* notes, int count, double framesPerBeat) {
+    std::vector<OfflineEvent> events;
+    events.reserve(static_cast<size_t>(count) * 2);
+    for (int i = 0; i < count; i++) {
+        const SequenceNote& note = notes[i];
+        if (note.channel >= MIDI_CHANNELS || note.velocity <= 0.0f) {
+            continue;
+        }
+        double onset = std::max(0.0, note.onsetBeats);
+        int64_t on = std::llround(onset * framesPerBeat);
+        int64_t off = std::max(on + 1, static_cast<int64_t>(std::llround((onset + note.durationBeats) * framesPerBeat)));
+        events.push_back({on, note.velocity, note.channel, note.note});
+        events.push_back({off, 0.0f, note.channel, note.note});
+    }
+    // Note-offs first on a shared frame, so repeated notes retrigger
+    std::stable_sort(events.begin(), events.end(), [](const OfflineEvent& a, const OfflineEvent& b) {
+        return a.frame != b.frame ? a.frame < b.frame : (a.velocity == 0.0f && b.velocity != 0.0f);
+    });
+    return events;
+}
+
+// Play from cursor.frame up to `to`, applying events on their frames. With
+// output null the voices are only advanced (tsf_render_skip).
+void advance(tsf* synth, const std::vector<OfflineEvent>& events, Cursor& cursor, int64_t to, float* output) {
+    while (cursor.frame < to) {
+        while (cursor.event < events.size() && events[cursor.event].frame <= cursor.frame) {
+            const OfflineEvent& event = events[cursor.event++];
+            if (event.velocity > 0.0f) {
+                tsf_channel_note_on(synth, event.channel, event.note, event.velocity);
+            } else {
+                tsf_channel_note_off(synth, event.channel, event.note);
+            }
+        }
+        int64_t end = std::min(to, (cursor.frame / GRID_FRAMES + 1) * GRID_FRAMES);
+        if (cursor.event < events.size()) {
+            end = std::min(end, events[cursor.event].frame);
+        }
+        int32_t frames = static_cast<int32_t>(end - cursor.frame);
+        if (output) {
+            tsf_render_float(synth, output, frames, 0);
+            output += frames * 2;
+        } else {
+            tsf_render_skip(synth, frames);
+        }
+        cursor.frame = end;
+    }
+}
+
+}  // namespace
+
+std::vector<float> OfflineRenderer::render(tsf* font, const SequenceNote* notes, int count,
+                                           const OfflineRenderOptions& options) {
+    std::vector<float> output;
+    if (!font || count <= 0 || options.sampleRate <= 0 || options.tempo <= 0.0f) {
+        return output;
+    }
+    std::vector<OfflineEvent> events = compileEvents(notes, count, options.sampleRate * 60.0 / options.tempo);
+    if (events.empty()) {
+        return output;
+    }
+
+    tsf* scout = tsf_copy(font);
+    if (!scout) {
+        return output;
+    }
+    tsf_set_output(scout, TSF_STEREO_INTERLEAVED, options.sampleRate, 0.0f);
+    bool ready = tsf_set_max_voices(scout, std::max(1, options.maxVoices)) != 0;
+    for (int channel = 0; ready && channel < MIDI_CHANNELS; channel++) {
+        ready = tsf_channel_set_presetnumber(scout, channel, options.channelPresets[channel],
+                                             channel == DRUM_CHANNEL) != 0;
+        ready = ready && tsf_channel_set_volume(scout, channel, 1.0f) != 0;
+    }
+
+    // Scout pass: the state each chunk starts from, and the total length
+    int64_t chunkFrames = std::max<int64_t>(
+        1, std::llround(options.chunkSeconds * options.sampleRate / GRID_FRAMES)) * GRID_FRAMES;
+    int64_t lastEvent = events.back().frame;
+    int64_t tailLimit = lastEvent + std::llround(std::max(0.0, options.maxTailSeconds) * options.sampleRate);
+    std::vector<tsf*> starts;
+    std::vector<Cursor> startCursors;
+    std::vector<float> warmup(static_cast<size_t>(WARMUP_FRAMES) * 2);
+    Cursor cursor;
+    int64_t totalFrames = 0;
+    tsf* start = ready ? tsf_copy_playing(scout) : nullptr;
+    ready = start != nullptr;
+    if (ready) {
+        starts.push_back(start);
+        startCursors.push_back(cursor);
+    }
+    while (ready) {
+        int64_t next = cursor.frame + GRID_FRAMES;
+        bool beforeBoundary = next % chunkFrames == 0;
+        advance(scout, events, cursor, next, beforeBoundary ? warmup.data() : nullptr);
+        if (cursor.frame > lastEvent &&
+            (tsf_active_voice_count(scout) == 0 || cursor.frame >= tailLimit)) {
+            totalFrames = cursor.frame;
+            break;
+        }
+        if (beforeBoundary) {
+            start = tsf_copy_playing(scout);
+            ready = start != nullptr;
+            if (ready) {
+                starts.push_back(start);
+                startCursors.push_back(cursor);
+            }
+        }
+    }
+
+    if (ready) {
+        output.assign(static_cast<size_t>(totalFrames) * 2, 0.0f);
+        std::atomic<size_t> nextChunk{0};
+        auto renderChunks = [&]() {
+            for (size_t chunk = nextChunk++; chunk < starts.size(); chunk = nextChunk++) {
+                Cursor chunkCursor = startCursors[chunk];
+                int64_t end = std::min(totalFrames, chunkCursor.frame + chunkFrames);
+                advance(starts[chunk], events, chunkCursor, end, output.data() + chunkCursor.frame * 2);
+            }
+        };
+
+        int threads = options.threads > 0 ? options.threads
+                                          : static_cast<int>(std::thread::hardware_concurrency());
+        threads = std::clamp(threads, 1, static_cast<int>(starts.size()));
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; i++) {
+            workers.emplace_back(renderChunks);
+        }
+        renderChunks();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    for (tsf* chunkStart : starts) {
+        tsf_close(chunkStart);
+    }
+    tsf_close(scout);
+    return output;
+}
+
+bool OfflineRenderer::writeWav(const std::string& path, const float* samples, int64_t frames,
+                               int sampleRate, bool floatSamples) {
+    const uint16_t channels = 2;
+    const uint16_t bytesPerSample = floatSamples ? 4 : 2;
+    uint64_t dataBytes = static_cast<uint64_t>(frames) * channels * bytesPerSample;
+    if (frames < 0 || sampleRate <= 0 || dataBytes > 0xFFFFFFFFull - 36) {
+        return false;
+    }
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    // Little-endian fields, as on every target the app and tools build for
+    auto put32 = [file](uint32_t value) { fwrite(&value, 4, 1, file); };
+    auto put16 = [file](uint16_t value) { fwrite(&value, 2, 1, file); };
+    fwrite("RIFF", 1, 4, file);
+    put32(static_cast<uint32_t>(36 + dataBytes));
+    fwrite("WAVEfmt ", 1, 8, file);
+    put32(16);
+    put16(floatSamples ? 3 : 1);  // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+    put16(channels);
+    put32(static_cast<uint32_t>(sampleRate));
+    put32(static_cast<uint32_t>(sampleRate) * channels * bytesPerSample);
+    put16(channels * bytesPerSample);
+    put16(bytesPerSample * 8);
+    fwrite("data", 1, 4, file);
+    put32(static_cast<uint32_t>(dataBytes));
+
+    size_t values = static_cast<size_t>(frames) * channels;
+    bool ok;
+    if (floatSamples) {
+        ok = fwrite(samples, sizeof(float), values, file) == values;
+    } else {
+        std::vector<int16_t> pcm(values);
+        for (size_t i = 0; i < values; i++) {
+            float value = std::clamp(samples[i], -1.0f, 1.0f);
+            pcm[i] = static_cast<int16_t>(std::lrintf(value * 32767.0f));
+        }
+        ok = fwrite(pcm.data(), sizeof(int16_t), values, file) == values;
+    }
+    return fclose(file) == 0 && ok;
+}
+
+}  // namespace musicsheetflow
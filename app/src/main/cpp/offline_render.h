@@ -0,0 +1,46 @@
+#pragma once
+
+#include "sequencer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct tsf;
+
+namespace musicsheetflow {
+
+struct OfflineRenderOptions {
+    int sampleRate = 44100;
+    float tempo = 120.0f;         // BPM
+    int maxVoices = 64;
+    int channelPresets[16] = {};  // GM program per channel; channel 9 selects drum kits
+    double chunkSeconds = 10.0;   // Output rendered per parallel job
+    int threads = 0;              // 0: one per core
+    double maxTailSeconds = 10.0; // Longest release kept after the last note
+};
+
+/**
+ * Renders a compiled score without an output stream, as fast as the CPU allows.
+ *
+ * A serial scout pass first walks the score with tsf_render_skip, which moves
+ * envelopes and sample positions on without touching samples, and renders
+ * only the few milliseconds before each chunk boundary so the filters settle.
+ * At every boundary it hands a copy of its voice state to the chunk starting
+ * there. The chunks then render in parallel, each starting from the state
+ * the previous one ends in, so the output does not depend on the thread count.
+ *
+ * Uses only tsf and the standard library, so the host tools build it too.
+ */
+class OfflineRenderer {
+public:
+    // Stereo interleaved float PCM; empty when there are no notes or the font
+    // could not be set up. `font` is only copied, never rendered.
+    static std::vector<float> render(tsf* font, const SequenceNote* notes, int count,
+                                     const OfflineRenderOptions& options);
+
+    // Stereo 16-bit PCM, or 32-bit float when floatSamples is set
+    static bool writeWav(const std::string& path, const float* samples, int64_t frames,
+                         int sampleRate, bool floatSamples);
+};
+
+}  // namespace musicsheetflow
@@ -60,9 +60,11 @@ public:
             return result;
         }
 
-        // Copy samples to aubio input vector
-        for (int i = 0; i < numSamples; ++i) {
-            fvec_set_sample(input_, samples[i], i);
+        // Copy samples to aubio input vector (skipped when converted in place)
+        if (samples != input_->data) {
+            for (int i = 0; i < numSamples; ++i) {
+                fvec_set_sample(input_, samples[i], i);
+            }
         }
 
         // Run pitch detection
@@ -86,19 +88,25 @@ public:
         return result;
     }
 
-private:
-    int frequencyToMidi(float freq) {
-        // MIDI note = 69 + 12 * log2(freq / 440)
-        return static_cast<int>(std::round(69.0f + 12.0f * std::log2(freq / 440.0f)));
-    }
+    PitchResult detect(const int16_t* samples, int numSamples) override {
+#ifdef HAVE_AUBIO
+        if (numSamples != bufferSize_) {
+            return {0.0f, 0.0f, -1, 0};
+        }
 
-    int calculateCentDeviation(float freq, int midiNote) {
-        // Expected frequency for MIDI note
-        float expected = 440.0f * std::pow(2.0f, (midiNote - 69) / 12.0f);
-        // Cents = 1200 * log2(actual / expected)
-        return static_cast<int>(std::round(1200.0f * std::log2(freq / expected)));
+        // Convert into aubio input vector, then run the float path in place
+        for (int i = 0; i < numSamples; ++i) {
+            fvec_set_sample(input_, samples[i] * (1.0f / 32768.0f), i);
+        }
+        return detect(input_->data, numSamples);
+#else
+        (void)samples;
+        (void)numSamples;
+        return {0.0f, 0.0f, -1, 0};
+#endif
     }
 
+private:
     int sampleRate_;
     int bufferSize_;
     float confidenceThreshold_ = 0.3f;
@@ -111,8 +119,15 @@ private:
 #endif
 };
 
-std::unique_ptr<PitchDetector> createPitchDetector(int sampleRate, int bufferSize) {
+std::unique_ptr<PitchDetector> createFloatPitchDetector(int sampleRate, int bufferSize) {
     return std::make_unique<PitchDetectorImpl>(sampleRate, bufferSize);
 }
 
+std::unique_ptr<PitchDetector> createPitchDetector(int sampleRate, int bufferSize) {
+    if (kUseFixedPointPitch) {
+        return createFixedPointPitchDetector(sampleRate, bufferSize);
+    }
+    return createFloatPitchDetector(sampleRate, bufferSize);
+}
+
 }  // namespace musicsheetflow
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
 #include <memory>
 
 namespace musicsheetflow {
@@ -19,6 +21,9 @@ public:
     // Returns PitchResult with frequency=0 if no pitch detected
     virtual PitchResult detect(const float* samples, int numSamples) = 0;
 
+    // Detect pitch from 16-bit PCM samples (full scale = 32768)
+    virtual PitchResult detect(const int16_t* samples, int numSamples) = 0;
+
     // Set minimum confidence threshold (0.0-1.0, default 0.3)
     virtual void setConfidenceThreshold(float threshold) = 0;
 
@@ -26,9 +31,36 @@ public:
     virtual void setSilenceThreshold(float thresholdDb) = 0;
 };
 
+// MIDI note = 69 + 12 * log2(freq / 440)
+inline int frequencyToMidi(float freq) {
+    return static_cast<int>(std::round(69.0f + 12.0f * std::log2(freq / 440.0f)));
+}
+
+// Cents = 1200 * log2(actual / expected) for the nearest MIDI note
+inline int calculateCentDeviation(float freq, int midiNote) {
+    float expected = 440.0f * std::pow(2.0f, (midiNote - 69) / 12.0f);
+    return static_cast<int>(std::round(1200.0f * std::log2(freq / expected)));
+}
+
+// True when this build analyzes 16-bit PCM with the fixed-point detector
+// (selected per ABI in CMakeLists.txt, none by default)
+constexpr bool kUseFixedPointPitch =
+#ifdef USE_FIXED_POINT_PITCH
+    true;
+#else
+    false;
+#endif
+
 // Factory function to create pitch detector
 // sampleRate: audio sample rate (typically 44100)
 // bufferSize: number of samples per detection (typically 2048)
+// Returns the fixed-point detector when kUseFixedPointPitch is set
 std::unique_ptr<PitchDetector> createPitchDetector(int sampleRate, int bufferSize);
 
+// aubio-backed float YIN detector, available on every ABI
+std::unique_ptr<PitchDetector> createFloatPitchDetector(int sampleRate, int bufferSize);
+
+// Q15 YIN detector (NEON multiply-accumulate on ARM, scalar elsewhere)
+std::unique_ptr<PitchDetector> createFixedPointPitchDetector(int sampleRate, int bufferSize);
+
 }  // namespace musicsheetflow
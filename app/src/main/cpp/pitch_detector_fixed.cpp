@@ -0,0 +1,194 @@
+#include "pitch_detector.h"
+#include <android/log.h>
+#include <cmath>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PITCH_USE_NEON 1
+#endif
+
+#define LOG_TAG "PitchDetectorQ15"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+namespace musicsheetflow {
+
+// Same YIN tolerance as the aubio detector (aubio_pitch_set_tolerance)
+static constexpr float YIN_TOLERANCE = 0.7f;
+
+// Full-scale energy of one Q15 sample, for dB conversion
+static constexpr double Q15_FULL_SCALE_SQ = 32768.0 * 32768.0;
+
+// Sum of a[i] * b[i] over n Q15 samples. Integer accumulation is exact, so
+// the NEON and scalar paths give bit-identical results.
+static int64_t correlate(const int16_t* a, const int16_t* b, int n) {
+    int64_t sum = 0;
+    int i = 0;
+#ifdef PITCH_USE_NEON
+    int64x2_t acc0 = vdupq_n_s64(0);
+    int64x2_t acc1 = vdupq_n_s64(0);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t va = vld1q_s16(a + i);
+        int16x8_t vb = vld1q_s16(b + i);
+        // Products are at most 2^30, widen pairwise into 64-bit lanes
+        acc0 = vpadalq_s32(acc0, vmull_s16(vget_low_s16(va), vget_low_s16(vb)));
+        acc1 = vpadalq_s32(acc1, vmull_s16(vget_high_s16(va), vget_high_s16(vb)));
+    }
+    acc0 = vaddq_s64(acc0, acc1);
+    sum = vgetq_lane_s64(acc0, 0) + vgetq_lane_s64(acc0, 1);
+#endif
+    for (; i < n; ++i) {
+        sum += static_cast<int32_t>(a[i]) * b[i];
+    }
+    return sum;
+}
+
+/**
+ * YIN pitch detector on 16-bit PCM, numerically equivalent to aubio's
+ * "yinfast" for the decisions we make (period, confidence, silence).
+ *
+ * The difference function d(tau) = e(0) + e(tau) - 2 r(tau) is computed in
+ * the time domain with exact integer arithmetic, one lag at a time, so the
+ * first-minimum search can stop as soon as it finds a dip below tolerance.
+ * For notes in the piano's middle range only a few hundred lags are
+ * evaluated instead of the full FFT pipeline.
+ */
+class FixedPointPitchDetector : public PitchDetector {
+public:
+    FixedPointPitchDetector(int sampleRate, int bufferSize)
+        : sampleRate_(sampleRate),
+          bufferSize_(bufferSize),
+          window_(bufferSize / 2),
+          yin_(bufferSize / 2),
+          pcm_(bufferSize) {
+        LOGI("Q15 pitch detector initialized: window=%d, neon=%d",
+             window_,
+#ifdef PITCH_USE_NEON
+             1
+#else
+             0
+#endif
+        );
+    }
+
+    void setConfidenceThreshold(float threshold) override {
+        confidenceThreshold_ = threshold;
+        LOGI("Confidence threshold set to %.2f", threshold);
+    }
+
+    void setSilenceThreshold(float thresholdDb) override {
+        silenceThresholdDb_ = thresholdDb;
+        LOGI("Silence threshold set to %.1f dB", thresholdDb);
+    }
+
+    PitchResult detect(const float* samples, int numSamples) override {
+        if (numSamples != bufferSize_) {
+            return {0.0f, 0.0f, -1, 0};
+        }
+
+        // Quantize to Q15 with saturation
+        for (int i = 0; i < numSamples; ++i) {
+            float scaled = samples[i] * 32768.0f;
+            scaled = scaled > 32767.0f ? 32767.0f : (scaled < -32768.0f ? -32768.0f : scaled);
+            pcm_[i] = static_cast<int16_t>(std::lrint(scaled));
+        }
+        return detect(pcm_.data(), numSamples);
+    }
+
+    PitchResult detect(const int16_t* samples, int numSamples) override {
+        PitchResult result = {0.0f, 0.0f, -1, 0};
+        if (numSamples != bufferSize_) {
+            return result;
+        }
+
+        // Silence gate on the whole buffer, as aubio_silence_detection does
+        int64_t totalEnergy = correlate(samples, samples, numSamples);
+        double levelDb = 10.0 * std::log10(
+            static_cast<double>(totalEnergy) / (Q15_FULL_SCALE_SQ * numSamples) + 1e-20);
+        if (levelDb < silenceThresholdDb_) {
+            return result;
+        }
+
+        float period = findPeriod(samples);
+        if (period <= 0.0f) {
+            return result;
+        }
+
+        float freq = sampleRate_ / period;
+        float confidence = 1.0f - yin_[peakPos_];
+
+        if (freq > 20.0f && confidence > confidenceThreshold_) {
+            result.frequency = freq;
+            result.confidence = confidence;
+            result.midiNote = frequencyToMidi(freq);
+            result.centDeviation = calculateCentDeviation(freq, result.midiNote);
+        }
+        return result;
+    }
+
+private:
+    // Cumulative mean normalized difference with early exit; returns the
+    // interpolated period in samples and leaves the chosen lag in peakPos_
+    float findPeriod(const int16_t* x) {
+        const int W = window_;
+
+        // e(0): energy of the first window; e(tau) slides along the buffer
+        int64_t energy0 = correlate(x, x, W);
+        int64_t energyTau = energy0;
+
+        double runningSum = 0.0;
+        yin_[0] = 1.0f;
+
+        for (int tau = 1; tau < W; ++tau) {
+            int32_t out = x[tau - 1];
+            int32_t in = x[W + tau - 1];
+            energyTau += in * in - out * out;
+
+            int64_t diff = energy0 + energyTau - 2 * correlate(x, x + tau, W);
+            runningSum += static_cast<double>(diff);
+            yin_[tau] = runningSum != 0.0
+                ? static_cast<float>(diff * static_cast<double>(tau) / runningSum)
+                : 1.0f;
+
+            int candidate = tau - 3;
+            if (tau > 4 && yin_[candidate] < YIN_TOLERANCE &&
+                yin_[candidate] < yin_[candidate + 1]) {
+                peakPos_ = candidate;
+                return quadraticPeakPos(candidate, tau + 1);
+            }
+        }
+
+        // No dip below tolerance: use the global minimum
+        int best = 0;
+        for (int tau = 1; tau < W; ++tau) {
+            if (yin_[tau] < yin_[best]) best = tau;
+        }
+        peakPos_ = best;
+        return quadraticPeakPos(best, W);
+    }
+
+    // Parabolic interpolation around pos over the first `valid` lags,
+    // matching fvec_quadratic_peak_pos
+    float quadraticPeakPos(int pos, int valid) const {
+        if (pos == 0 || pos >= valid - 1) return static_cast<float>(pos);
+        float s0 = yin_[pos - 1];
+        float s1 = yin_[pos];
+        float s2 = yin_[pos + 1];
+        return pos + 0.5f * (s0 - s2) / (s0 - 2.0f * s1 + s2);
+    }
+
+    int sampleRate_;
+    int bufferSize_;
+    int window_;
+    int peakPos_ = 0;
+    float confidenceThreshold_ = 0.3f;
+    float silenceThresholdDb_ = -50.0f;
+    std::vector<float> yin_;
+    std::vector<int16_t> pcm_;
+};
+
+std::unique_ptr<PitchDetector> createFixedPointPitchDetector(int sampleRate, int bufferSize) {
+    return std::make_unique<FixedPointPitchDetector>(sampleRate, bufferSize);
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,126 @@
+#include "render_ahead.h"
+#include "trace.h"
+#include <android/log.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#define LOG_TAG "RenderAhead"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+namespace musicsheetflow {
+
+// THREAD_PRIORITY_URGENT_AUDIO, used when SCHED_FIFO is not granted
+static constexpr int URGENT_AUDIO_NICE = -19;
+
+RenderAhead::~RenderAhead() {
+    stop();
+}
+
+bool RenderAhead::start(BlockSource* source, int buses, int64_t frame, int32_t blockFrames,
+                        int32_t lookaheadFrames) {
+    if (running_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    if (!source || buses <= 0 || blockFrames <= 0 || lookaheadFrames < blockFrames) {
+        return false;
+    }
+
+    int64_t capacity = 1;
+    while (capacity < lookaheadFrames + blockFrames) {
+        capacity <<= 1;
+    }
+    rings_.assign(buses, std::vector<float>(static_cast<size_t>(capacity) * 2, 0.0f));
+    blocks_.assign(buses, std::vector<float>(static_cast<size_t>(blockFrames) * 2, 0.0f));
+    blockBuses_.clear();
+    for (auto& block : blocks_) {
+        blockBuses_.push_back(block.data());
+    }
+    ringMask_ = capacity - 1;
+    source_ = source;
+    blockFrames_ = blockFrames;
+    lookaheadFrames_ = lookaheadFrames;
+    writeFrame_.store(frame, std::memory_order_relaxed);
+    readFrame_.store(frame, std::memory_order_relaxed);
+    sem_init(&wake_, 0, 1);  // Fill the lookahead straight away
+
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread([this] {
+        pthread_setname_np(pthread_self(), "SynthAhead");
+        // Just under the callback, which must always win the core
+        sched_param param{};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0 &&
+            setpriority(PRIO_PROCESS, gettid(), URGENT_AUDIO_NICE) != 0) {
+            LOGW("Could not raise synth thread priority");
+        }
+        threadLoop();
+    });
+
+    LOGI("Render-ahead started: %d frame blocks, %d frames ahead", blockFrames, lookaheadFrames);
+    return true;
+}
+
+void RenderAhead::stop() {
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    sem_post(&wake_);
+    thread_.join();
+    sem_destroy(&wake_);
+    source_ = nullptr;
+}
+
+void RenderAhead::threadLoop() {
+    for (;;) {
+        sem_wait(&wake_);
+        if (!running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        int64_t frame = writeFrame_.load(std::memory_order_relaxed);
+        while (running_.load(std::memory_order_relaxed) &&
+               frame + blockFrames_ <= readFrame_.load(std::memory_order_acquire) + lookaheadFrames_) {
+            source_->renderBlock(blockBuses_.data(), blockFrames_, frame);
+
+            // Copy into the rings, wrapping at their end
+            int64_t slot = frame & ringMask_;
+            int64_t first = std::min<int64_t>(blockFrames_, ringMask_ + 1 - slot);
+            for (size_t bus = 0; bus < rings_.size(); bus++) {
+                const float* block = blocks_[bus].data();
+                std::vector<float>& ring = rings_[bus];
+                memcpy(&ring[slot * 2], block, first * 2 * sizeof(float));
+                memcpy(&ring[0], block + first * 2, (blockFrames_ - first) * 2 * sizeof(float));
+            }
+            frame += blockFrames_;
+            writeFrame_.store(frame, std::memory_order_release);
+        }
+    }
+}
+
+void RenderAhead::read(float* const* buses, int32_t numFrames, int64_t frame) {
+    int64_t written = writeFrame_.load(std::memory_order_acquire);
+    auto ready = static_cast<int32_t>(std::clamp<int64_t>(written - frame, 0, numFrames));
+    for (size_t bus = 0; bus < rings_.size(); bus++) {
+        float* output = buses[bus];
+        for (int32_t done = 0; done < ready;) {
+            int64_t slot = (frame + done) & ringMask_;
+            auto count = static_cast<int32_t>(std::min<int64_t>(ready - done, ringMask_ + 1 - slot));
+            memcpy(output + done * 2, &rings_[bus][slot * 2], count * 2 * sizeof(float));
+            done += count;
+        }
+        memset(output + ready * 2, 0, (numFrames - ready) * 2 * sizeof(float));
+    }
+    if (ready < numFrames) {
+        TRACE_INSTANT("Render-ahead miss");
+        missedFrames_.fetch_add(numFrames - ready, std::memory_order_relaxed);
+    }
+
+    readFrame_.store(frame + numFrames, std::memory_order_release);
+    sem_post(&wake_);
+}
+
+}  // namespace musicsheetflow
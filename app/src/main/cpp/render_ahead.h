@@ -0,0 +1,68 @@
+#pragma once
+
+#include <semaphore.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace musicsheetflow {
+
+// Produces the output timeline one block at a time, on one or more buses
+class BlockSource {
+public:
+    virtual ~BlockSource() = default;
+    // Overwrite numFrames of each stereo bus starting at timeline frame `frame`
+    virtual void renderBlock(float* const* buses, int32_t numFrames, int64_t frame) = 0;
+};
+
+/**
+ * Renders the synth a few blocks ahead of the output on its own thread.
+ *
+ * The synth thread fills a ring of frames up to the lookahead and sleeps;
+ * each callback copies its frames out and wakes it again, so a slow block
+ * is absorbed by the frames already queued instead of underrunning the
+ * stream. Ring slots are addressed by timeline frame: if the synth thread
+ * falls behind anyway, the callback plays silence for the missing frames
+ * and their late renders are never read, so scheduled events keep their
+ * place on the timeline.
+ */
+class RenderAhead {
+public:
+    RenderAhead() = default;
+    ~RenderAhead();
+
+    RenderAhead(const RenderAhead&) = delete;
+    RenderAhead& operator=(const RenderAhead&) = delete;
+
+    // Control thread, stream stopped. Rendering starts at `frame` in
+    // blocks of blockFrames, keeping up to lookaheadFrames of each bus queued.
+    bool start(BlockSource* source, int buses, int64_t frame, int32_t blockFrames, int32_t lookaheadFrames);
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+    int32_t lookaheadFrames() const { return lookaheadFrames_; }
+    int64_t missedFrames() const { return missedFrames_.load(std::memory_order_relaxed); }
+
+    // Audio thread: frames [frame, frame + numFrames) of each bus, silence
+    // where the synth thread has not got to yet
+    void read(float* const* buses, int32_t numFrames, int64_t frame);
+
+private:
+    void threadLoop();
+
+    BlockSource* source_ = nullptr;
+    std::thread thread_;
+    sem_t wake_;
+    std::atomic<bool> running_{false};
+    std::vector<std::vector<float>> rings_;  // Stereo frames per bus; slot = frame & ringMask_
+    std::vector<std::vector<float>> blocks_;
+    std::vector<float*> blockBuses_;
+    int64_t ringMask_ = 0;
+    int32_t blockFrames_ = 0;
+    int32_t lookaheadFrames_ = 0;
+    alignas(64) std::atomic<int64_t> writeFrame_{0};  // Rendered up to here
+    alignas(64) std::atomic<int64_t> readFrame_{0};   // Output up to here
+    std::atomic<int64_t> missedFrames_{0};
+};
+
+}  // namespace musicsheetflow
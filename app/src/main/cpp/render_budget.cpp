@@ -0,0 +1,110 @@
+#include "render_budget.h"
+#include <time.h>
+#include <algorithm>
+
+#include "third_party/tsf.h"
+
+namespace musicsheetflow {
+
+// Weight of the latest callback in the smoothed load; a single slow
+// callback (a page fault, a preemption) should not cost quality
+static constexpr float LOAD_SMOOTHING = 0.2f;
+
+// Release tails below -60 dB are inaudible under anything still playing
+static constexpr float CULL_GAIN = 0.001f;
+
+// -30 dB: the filter's effect on these voices is masked by the louder ones
+static constexpr float QUIET_FILTER_GAIN = 0.03f;
+
+static constexpr int MIN_LIMITED_VOICES = 8;
+
+// After a step down, give the new level time to show in the smoothed load
+static constexpr int HOLD_MILLIS = 50;
+
+// Step back up after this long below RESTORE_FRACTION of the budget
+static constexpr int RESTORE_MILLIS = 2000;
+static constexpr float RESTORE_FRACTION = 0.6f;
+
+static int64_t monotonicNanos() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void RenderBudget::setBudget(float fraction) {
+    budget_.store(std::clamp(fraction, 0.25f, 1.0f), std::memory_order_relaxed);
+}
+
+RenderLoad RenderBudget::getLoad(bool resetPeak) {
+    RenderLoad result;
+    result.level = level_.load(std::memory_order_relaxed);
+    result.load = load_.load(std::memory_order_relaxed);
+    result.peakLoad = resetPeak ? peakLoad_.exchange(0.0f, std::memory_order_relaxed)
+                                : peakLoad_.load(std::memory_order_relaxed);
+    result.budget = budget_.load(std::memory_order_relaxed);
+    result.overBudget = overBudget_.load(std::memory_order_relaxed);
+    result.degraded = degraded_.load(std::memory_order_relaxed);
+    result.restored = restored_.load(std::memory_order_relaxed);
+    result.culledVoices = culledVoices_.load(std::memory_order_relaxed);
+    return result;
+}
+
+void RenderBudget::begin(tsf* synth, int maxVoices) {
+    beginNanos_ = monotonicNanos();
+
+    // Set every callback, so a newly loaded font or resized pool picks it up
+    int level = level_.load(std::memory_order_relaxed);
+    int voiceLimit = level >= FewerVoices ? std::max(maxVoices / 2, MIN_LIMITED_VOICES) : 0;
+    tsf_set_render_quality(synth, voiceLimit,
+                           level >= QuietFilter ? QUIET_FILTER_GAIN : 0.0f,
+                           level >= Nearest);
+    if (level >= CullReleased) {
+        int culled = tsf_cull_released_voices(synth, CULL_GAIN);
+        if (culled) {
+            culledVoices_.fetch_add(culled, std::memory_order_relaxed);
+        }
+    }
+}
+
+void RenderBudget::end(int32_t numFrames, int sampleRate) {
+    if (numFrames <= 0 || sampleRate <= 0) {
+        return;
+    }
+    double periodNanos = numFrames * 1e9 / sampleRate;
+    float sample = static_cast<float>((monotonicNanos() - beginNanos_) / periodNanos);
+    float budget = budget_.load(std::memory_order_relaxed);
+
+    if (sample > budget) {
+        overBudget_.fetch_add(1, std::memory_order_relaxed);
+    }
+    float peak = peakLoad_.load(std::memory_order_relaxed);
+    while (sample > peak &&
+           !peakLoad_.compare_exchange_weak(peak, sample, std::memory_order_relaxed)) {
+    }
+
+    float load = load_.load(std::memory_order_relaxed);
+    load += LOAD_SMOOTHING * (sample - load);
+    load_.store(load, std::memory_order_relaxed);
+
+    int level = level_.load(std::memory_order_relaxed);
+    holdFrames_ -= numFrames;
+    if (load > budget) {
+        calmFrames_ = 0;
+        if (holdFrames_ <= 0 && level < Nearest) {
+            level_.store(level + 1, std::memory_order_relaxed);
+            degraded_.fetch_add(1, std::memory_order_relaxed);
+            holdFrames_ = static_cast<int64_t>(sampleRate) * HOLD_MILLIS / 1000;
+        }
+    } else if (load < budget * RESTORE_FRACTION && level > Full) {
+        calmFrames_ += numFrames;
+        if (calmFrames_ >= static_cast<int64_t>(sampleRate) * RESTORE_MILLIS / 1000) {
+            level_.store(level - 1, std::memory_order_relaxed);
+            restored_.fetch_add(1, std::memory_order_relaxed);
+            calmFrames_ = 0;
+        }
+    } else {
+        calmFrames_ = 0;
+    }
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+struct tsf;
+
+namespace musicsheetflow {
+
+// Synth render load and the degradation decisions taken for it
+struct RenderLoad {
+    int level = 0;              // RenderBudget::Level in effect
+    float load = 0.0f;          // Smoothed render time as a fraction of the callback period
+    float peakLoad = 0.0f;      // Highest single callback since the last reset
+    float budget = 0.0f;
+    int64_t overBudget = 0;     // Callbacks whose render took longer than the budget
+    int64_t degraded = 0;       // Steps down a level
+    int64_t restored = 0;       // Steps back up
+    int64_t culledVoices = 0;   // Released voices ended early
+};
+
+/**
+ * Keeps synth rendering inside a share of the callback period.
+ *
+ * The callback brackets its synth work with begin() and end(). When the
+ * smoothed render time passes the budget the synth steps down one level,
+ * each one adding to the savings of the levels above it; a step back up
+ * needs a sustained stretch of low load, so quality does not flap around
+ * the threshold.
+ */
+class RenderBudget {
+public:
+    enum Level {
+        Full,          // No savings
+        CullReleased,  // End inaudible release tails
+        QuietFilter,   // No lowpass on quiet voices
+        FewerVoices,   // Half the voice pool
+        Nearest,       // Nearest-sample playback
+        LevelCount
+    };
+
+    // Control thread: fraction of the callback period (0.25 - 1.0)
+    void setBudget(float fraction);
+    RenderLoad getLoad(bool resetPeak);
+
+    // Audio thread: apply the current level to `synth` before its commands run
+    void begin(tsf* synth, int maxVoices);
+    // Audio thread: account the time since begin() against numFrames of audio
+    void end(int32_t numFrames, int sampleRate);
+
+private:
+    std::atomic<float> budget_{0.75f};
+    std::atomic<int> level_{Full};
+    std::atomic<float> load_{0.0f};
+    std::atomic<float> peakLoad_{0.0f};
+    std::atomic<int64_t> overBudget_{0};
+    std::atomic<int64_t> degraded_{0};
+    std::atomic<int64_t> restored_{0};
+    std::atomic<int64_t> culledVoices_{0};
+
+    // Audio thread only
+    int64_t beginNanos_ = 0;
+    int64_t holdFrames_ = 0;  // Frames left before the next step down is allowed
+    int64_t calmFrames_ = 0;  // Frames of low load so far
+};
+
+}  // namespace musicsheetflow
@@ -0,0 +1,268 @@
+#include "sequencer.h"
+#include <android/log.h>
+#include <algorithm>
+#include <cmath>
+
+#define LOG_TAG "Sequencer"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+namespace musicsheetflow {
+
+// Shortest note we will schedule, so grace notes still get a note-off
+// strictly after their note-on
+static constexpr float MIN_DURATION_BEATS = 1.0f / 32.0f;
+
+Sequencer::Sequencer(TempoMap& tempoMap) : tempoMap_(tempoMap) {
+    playhead_.sequence.store(0, std::memory_order_relaxed);
+    playhead_.playing = 0;
+    playhead_.beat = 0.0;
+    playhead_.frame = 0;
+    playhead_.noteIndex = -1;
+    playhead_.tempo = tempoMap_.bpmAt(0.0);
+}
+
+Sequencer::~Sequencer() {
+    Control control;
+    while (controls_.pop(control)) {
+        delete control.data;
+    }
+    reclaim();
+    delete data_;
+}
+
+void Sequencer::load(const SequenceNote* notes, int count) {
+    auto* data = new SequenceData();
+    data->events.reserve(static_cast<size_t>(count) * 2);
+    data->startBeat = count > 0 ? notes[0].onsetBeats : 0.0;
+
+    for (int i = 0; i < count; ++i) {
+        const SequenceNote& n = notes[i];
+        double offBeat = n.onsetBeats + std::max(n.durationBeats, MIN_DURATION_BEATS);
+        data->events.push_back({n.onsetBeats, i, n.velocity, n.channel, n.note});
+        data->events.push_back({offBeat, i, 0.0f, n.channel, n.note});
+        data->startBeat = std::min(data->startBeat, n.onsetBeats);
+        data->endBeat = std::max(data->endBeat, offBeat);
+    }
+
+    // Within one beat, release before attack so repeated notes retrigger
+    std::stable_sort(data->events.begin(), data->events.end(),
+                     [](const TimelineEvent& a, const TimelineEvent& b) {
+                         if (a.beat != b.beat) return a.beat < b.beat;
+                         return a.velocity == 0.0f && b.velocity != 0.0f;
+                     });
+
+    LOGI("Sequence loaded: %d notes, %.1f beats", count, data->endBeat);
+    send({Control::Type::Load, 0.0, 0.0, data});
+}
+
+void Sequencer::play() {
+    send({Control::Type::Play, 0.0, 0.0, nullptr});
+}
+
+void Sequencer::pause() {
+    send({Control::Type::Pause, 0.0, 0.0, nullptr});
+}
+
+void Sequencer::stop() {
+    send({Control::Type::Stop, 0.0, 0.0, nullptr});
+}
+
+void Sequencer::seek(double beat) {
+    send({Control::Type::Seek, std::max(0.0, beat), 0.0, nullptr});
+}
+
+void Sequencer::setLoop(double startBeat, double endBeat) {
+    if (endBeat <= startBeat || startBeat < 0.0) {
+        LOGW("Ignoring invalid loop range %.2f-%.2f", startBeat, endBeat);
+        return;
+    }
+    send({Control::Type::Loop, startBeat, endBeat, nullptr});
+}
+
+void Sequencer::clearLoop() {
+    send({Control::Type::ClearLoop, 0.0, 0.0, nullptr});
+}
+
+void Sequencer::send(const Control& control) {
+    reclaim();
+    if (!controls_.push(control)) {
+        // Output stream is not consuming (stopped); nothing will apply it
+        LOGW("Sequencer control queue full, dropping command %d", static_cast<int>(control.type));
+        delete control.data;
+    }
+}
+
+// Free sequences the audio thread has swapped out
+void Sequencer::reclaim() {
+    SequenceData* old = nullptr;
+    while (retired_.pop(old)) {
+        delete old;
+    }
+}
+
+void Sequencer::process(int64_t blockStart, int32_t numFrames, MidiEventSink& sink) {
+    Control control;
+    while (controls_.pop(control)) {
+        applyControl(control, blockStart, sink);
+    }
+
+    int32_t offset = 0;
+    while (playing_ && data_ && offset < numFrames) {
+        int64_t frameBase = blockStart + offset;
+        double blockEndBeat = tempoMap_.advance(beat_, numFrames - offset);
+
+        if (looping_ && blockEndBeat >= loopEnd_) {
+            // Play up to the loop end, release, and continue from the loop start
+            emitUntil(loopEnd_, frameBase, sink);
+            auto used = static_cast<int32_t>(std::ceil(tempoMap_.framesBetween(beat_, loopEnd_)));
+            offset += std::min(std::max(used, 0), numFrames - offset);
+            releaseSounding(blockStart + offset, sink);
+            locate(loopStart_);
+        } else {
+            emitUntil(blockEndBeat, frameBase, sink);
+            beat_ = blockEndBeat;
+            offset = numFrames;
+
+            if (!looping_ && cursor_ >= data_->events.size() && beat_ >= data_->endBeat) {
+                playing_ = false;  // Reached the end; every note-off has been sent
+            }
+        }
+    }
+
+    publish(blockStart + numFrames);
+}
+
+void Sequencer::applyControl(const Control& control, int64_t frame, MidiEventSink& sink) {
+    switch (control.type) {
+        case Control::Type::Load:
+            releaseSounding(frame, sink);
+            if (data_ && !retired_.push(data_)) {
+                delete data_;  // Not expected: control thread reclaims on every send
+            }
+            data_ = control.data;
+            playing_ = false;
+            looping_ = false;
+            rewind();
+            break;
+        case Control::Type::Play:
+            if (data_ && !looping_ && cursor_ >= data_->events.size()) {
+                rewind();  // Finished: play again from the top
+            }
+            playing_ = data_ != nullptr;
+            break;
+        case Control::Type::Pause:
+            playing_ = false;
+            releaseSounding(frame, sink);
+            break;
+        case Control::Type::Stop:
+            playing_ = false;
+            releaseSounding(frame, sink);
+            rewind();
+            break;
+        case Control::Type::Seek:
+            releaseSounding(frame, sink);
+            locate(control.a);
+            break;
+        case Control::Type::Loop:
+            looping_ = true;
+            loopStart_ = control.a;
+            loopEnd_ = control.b;
+            break;
+        case Control::Type::ClearLoop:
+            looping_ = false;
+            break;
+    }
+}
+
+// Emit every timeline event before `beat`, timestamped relative to beat_ at frameBase
+void Sequencer::emitUntil(double beat, int64_t frameBase, MidiEventSink& sink) {
+    const auto& events = data_->events;
+    while (cursor_ < events.size() && events[cursor_].beat < beat) {
+        const TimelineEvent& e = events[cursor_++];
+        double delta = std::max(0.0, tempoMap_.framesBetween(beat_, e.beat));
+        int64_t frame = frameBase + static_cast<int64_t>(delta);
+        uint8_t& count = sounding_[e.channel & 0x0F][e.note & 0x7F];
+
+        if (e.velocity > 0.0f) {
+            sink.post(MidiCommand::noteOn(e.channel, e.note, e.velocity, frame));
+            if (count < 255) count++;
+            noteIndex_ = e.noteIndex;
+        } else if (count > 0) {
+            sink.post(MidiCommand::noteOff(e.channel, e.note, frame));
+            count--;
+        }
+    }
+}
+
+void Sequencer::releaseSounding(int64_t frame, MidiEventSink& sink) {
+    for (int channel = 0; channel < 16; ++channel) {
+        for (int note = 0; note < 128; ++note) {
+            // TSF releases one voice per note-off, so send one per note-on
+            for (uint8_t& count = sounding_[channel][note]; count > 0; --count) {
+                sink.post(MidiCommand::noteOff(channel, note, frame));
+            }
+        }
+    }
+}
+
+void Sequencer::locate(double beat) {
+    beat_ = beat;
+    noteIndex_ = -1;
+    if (!data_) {
+        cursor_ = 0;
+        return;
+    }
+
+    const auto& events = data_->events;
+    auto it = std::lower_bound(events.begin(), events.end(), beat,
+                               [](const TimelineEvent& e, double b) { return e.beat < b; });
+    cursor_ = static_cast<size_t>(it - events.begin());
+
+    // Last note started before the new position
+    for (size_t i = cursor_; i-- > 0;) {
+        if (events[i].velocity > 0.0f) {
+            noteIndex_ = events[i].noteIndex;
+            break;
+        }
+    }
+}
+
+// Leading rests are skipped: the top of a sequence is its first note
+void Sequencer::rewind() {
+    locate(data_ ? data_->startBeat : 0.0);
+}
+
+void Sequencer::publish(int64_t frame) {
+    uint32_t seq = playhead_.sequence.load(std::memory_order_relaxed);
+    playhead_.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    playhead_.playing = playing_ ? 1 : 0;
+    playhead_.beat = beat_;
+    playhead_.frame = frame;
+    playhead_.noteIndex = noteIndex_;
+    playhead_.tempo = tempoMap_.bpmAt(beat_);
+
+    playhead_.sequence.store(seq + 2, std::memory_order_release);
+}
+
+void Sequencer::readPlayhead(SequencerPlayhead& out) const {
+    for (;;) {
+        uint32_t before = playhead_.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        out.playing = playhead_.playing;
+        out.beat = playhead_.beat;
+        out.frame = playhead_.frame;
+        out.noteIndex = playhead_.noteIndex;
+        out.tempo = playhead_.tempo;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (playhead_.sequence.load(std::memory_order_relaxed) == before) {
+            return;
+        }
+    }
+}
+
+}  // namespace musicsheetflow
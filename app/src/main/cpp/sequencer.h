@@ -0,0 +1,121 @@
+#pragma once
+
+#include "lock_free_queue.h"
+#include "midi_command.h"
+#include "tempo_map.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace musicsheetflow {
+
+// One compiled score note, as sent once from Kotlin
+struct SequenceNote {
+    double onsetBeats;
+    float durationBeats;
+    float velocity;     // 0.0-1.0
+    uint8_t channel;
+    uint8_t note;
+};
+
+// Playhead published by the audio thread for UI scrolling. `sequence` is a
+// seqlock counter (odd while a write is in progress); Kotlin reads a copy
+// taken with Sequencer::readPlayhead() through a direct ByteBuffer. Offsets
+// are part of the Kotlin contract.
+struct SequencerPlayhead {
+    std::atomic<uint32_t> sequence;  // offset 0
+    int32_t playing;                 // offset 4: 1 while playing
+    double beat;                     // offset 8: position in beats
+    int64_t frame;                   // offset 16: output frame where `beat` applies
+    int32_t noteIndex;               // offset 24: last started note, -1 before the first
+    float tempo;                     // offset 28: BPM at `beat`, scaled
+};
+static_assert(sizeof(SequencerPlayhead) == 32, "Playhead layout is shared with Kotlin");
+
+// Receives note events produced inside the render callback
+class MidiEventSink {
+public:
+    virtual ~MidiEventSink() = default;
+    virtual void post(const MidiCommand& command) = 0;
+};
+
+/**
+ * Score sequencer driven by the output frame clock.
+ *
+ * The whole compiled note list is loaded once; playback then runs inside
+ * the synth callback, emitting frame-accurate note-on/off events for each
+ * render block. Beats are converted to frames through the shared TempoMap,
+ * which the render thread updates before each block. Control methods
+ * (play, pause, seek, loop) may be called from any thread and take effect
+ * at the next callback. Stop and replay rewind to the first note.
+ */
+class Sequencer {
+public:
+    explicit Sequencer(TempoMap& tempoMap);
+    ~Sequencer();
+
+    // Control thread API
+    void load(const SequenceNote* notes, int count);
+    void play();
+    void pause();
+    void stop();  // Pause and rewind to the first note
+    void seek(double beat);
+    void setLoop(double startBeat, double endBeat);
+    void clearLoop();
+    // Consistent copy of the playhead into `out`, whose counter is left alone
+    void readPlayhead(SequencerPlayhead& out) const;
+
+    // Audio thread API
+    void process(int64_t blockStart, int32_t numFrames, MidiEventSink& sink);
+
+private:
+    struct TimelineEvent {
+        double beat;
+        int32_t noteIndex;
+        float velocity;     // 0 for note-off
+        uint8_t channel;
+        uint8_t note;
+    };
+
+    struct SequenceData {
+        std::vector<TimelineEvent> events;  // Sorted; note-offs before note-ons per beat
+        double startBeat = 0.0;  // First note-on
+        double endBeat = 0.0;
+    };
+
+    struct Control {
+        enum class Type : uint8_t { Load, Play, Pause, Stop, Seek, Loop, ClearLoop };
+        Type type;
+        double a;
+        double b;
+        SequenceData* data;
+    };
+
+    void send(const Control& control);
+    void reclaim();
+    void applyControl(const Control& control, int64_t frame, MidiEventSink& sink);
+    void emitUntil(double beat, int64_t frameBase, MidiEventSink& sink);
+    void releaseSounding(int64_t frame, MidiEventSink& sink);
+    void locate(double beat);
+    void rewind();
+    void publish(int64_t frame);
+
+    TempoMap& tempoMap_;
+
+    // Audio thread state
+    SequenceData* data_ = nullptr;
+    size_t cursor_ = 0;
+    double beat_ = 0.0;
+    bool playing_ = false;
+    bool looping_ = false;
+    double loopStart_ = 0.0;
+    double loopEnd_ = 0.0;
+    int32_t noteIndex_ = -1;
+    uint8_t sounding_[16][128] = {};  // Note-ons without a matching note-off yet
+
+    LockFreeQueue<Control, 64> controls_;
+    LockFreeQueue<SequenceData*, 16> retired_;  // Swapped-out data, freed off the audio thread
+    SequencerPlayhead playhead_;
+};
+
+}  // namespace musicsheetflow
@@ -0,0 +1,110 @@
+#include "soundfont_memory.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+
+#include "third_party/tsf.h"
+
+namespace musicsheetflow {
+
+static size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+int SoundFontMemory::findPreset(tsf* font, int preset, bool drums) {
+    int index = -1;
+    if (drums) {
+        index = tsf_get_presetindex(font, 128, preset);
+        if (index == -1) index = tsf_get_presetindex(font, 128, 0);
+    }
+    if (index == -1) index = tsf_get_presetindex(font, 0, preset);
+    return index;
+}
+
+std::vector<SampleRange> SoundFontMemory::presetRanges(tsf* font, int presetIndex) {
+    std::vector<SampleRange> ranges;
+    const short* samples = tsf_get_sampledata(font, nullptr);
+    int regions = tsf_get_preset_samplespans(font, presetIndex, nullptr, 0);
+    if (!samples || regions <= 0) {
+        return ranges;
+    }
+
+    std::vector<unsigned int> spans(static_cast<size_t>(regions) * 2);
+    tsf_get_preset_samplespans(font, presetIndex, spans.data(), regions);
+
+    // Whole pages: a page holding any sample of the font is part of its mapping
+    uintptr_t mask = ~static_cast<uintptr_t>(pageSize() - 1);
+    std::vector<std::pair<uintptr_t, uintptr_t>> pages;
+    for (int i = 0; i < regions; ++i) {
+        if (spans[i * 2 + 1] <= spans[i * 2]) continue;
+        auto first = reinterpret_cast<uintptr_t>(samples + spans[i * 2]);
+        auto end = reinterpret_cast<uintptr_t>(samples + spans[i * 2 + 1]);
+        pages.emplace_back(first & mask, (end + pageSize() - 1) & mask);
+    }
+    std::sort(pages.begin(), pages.end());
+
+    // Velocity layers and stereo pairs share samples; merge the overlaps
+    std::vector<std::pair<uintptr_t, uintptr_t>> merged;
+    for (const auto& page : pages) {
+        if (!merged.empty() && page.first <= merged.back().second) {
+            merged.back().second = std::max(merged.back().second, page.second);
+        } else {
+            merged.push_back(page);
+        }
+    }
+    for (const auto& range : merged) {
+        ranges.push_back({reinterpret_cast<const char*>(range.first), range.second - range.first});
+    }
+    return ranges;
+}
+
+void SoundFontMemory::prefetch(const std::vector<SampleRange>& ranges) {
+    size_t page = pageSize();
+    for (const auto& range : ranges) {
+        // Start readahead for the whole range, then wait for each page here
+        madvise(const_cast<char*>(range.begin), range.length, MADV_WILLNEED);
+        for (size_t offset = 0; offset < range.length; offset += page) {
+            *static_cast<const volatile char*>(range.begin + offset);
+        }
+    }
+}
+
+int64_t SoundFontMemory::totalBytes(const std::vector<SampleRange>& ranges) {
+    int64_t total = 0;
+    for (const auto& range : ranges) {
+        total += static_cast<int64_t>(range.length);
+    }
+    return total;
+}
+
+int64_t SoundFontMemory::residentBytes(const std::vector<SampleRange>& ranges) {
+    size_t page = pageSize();
+    int64_t resident = 0;
+    std::vector<unsigned char> status;
+    for (const auto& range : ranges) {
+        status.assign(range.length / page, 0);
+        if (mincore(const_cast<char*>(range.begin), range.length, status.data()) != 0) {
+            continue;
+        }
+        for (unsigned char pageStatus : status) {
+            if (pageStatus & 1) resident += static_cast<int64_t>(page);
+        }
+    }
+    return resident;
+}
+
+std::vector<PresetMemory> SoundFontMemory::report(tsf* font) {
+    std::vector<PresetMemory> presets;
+    int count = tsf_get_presetcount(font);
+    presets.reserve(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        auto ranges = presetRanges(font, i);
+        presets.push_back({tsf_get_presetbank(font, i), tsf_get_presetnumber(font, i),
+                           totalBytes(ranges), residentBytes(ranges)});
+    }
+    return presets;
+}
+
+}  // namespace musicsheetflow
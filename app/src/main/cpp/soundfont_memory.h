@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct tsf;
+
+namespace musicsheetflow {
+
+// Sample memory of one SoundFont preset
+struct PresetMemory {
+    int bank;
+    int preset;
+    int64_t sampleBytes;    // Sample data the preset can play
+    int64_t residentBytes;  // Part of it currently in RAM
+};
+
+// Page-aligned byte range of sample data
+struct SampleRange {
+    const char* begin;
+    size_t length;
+};
+
+/**
+ * Per-preset view of SoundFont sample data.
+ *
+ * A font mapped from the APK only pages its samples in when they are first
+ * read, and that read must not happen on the render callback. Prefetching
+ * the presets a channel selects keeps the rest of the GM bank out of RAM
+ * while the presets in use are resident before their first note.
+ */
+class SoundFontMemory {
+public:
+    // Preset index a channel would select (bank 128 kits for drums, GM
+    // fallbacks as in tsf_channel_set_presetnumber); -1 if none
+    static int findPreset(tsf* font, int preset, bool drums);
+
+    // Merged, page-aligned sample ranges of a preset
+    static std::vector<SampleRange> presetRanges(tsf* font, int presetIndex);
+
+    // Fault ranges into memory on the calling thread
+    static void prefetch(const std::vector<SampleRange>& ranges);
+
+    static int64_t totalBytes(const std::vector<SampleRange>& ranges);
+    static int64_t residentBytes(const std::vector<SampleRange>& ranges);
+
+    // Every preset in the font, with how much of it is resident
+    static std::vector<PresetMemory> report(tsf* font);
+};
+
+}  // namespace musicsheetflow
@@ -0,0 +1,110 @@
+#include "spectrum_analyzer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace musicsheetflow {
+
+static constexpr float PI = 3.14159265358979f;
+
+// Shown for silent bands instead of -inf
+static constexpr float FLOOR_DB = -120.0f;
+
+SpectrumAnalyzer::SpectrumAnalyzer(int sampleRate, int size, int bands, float minHz, float maxHz)
+        : size_(size),
+          window_(size),
+          cos_(size / 2),
+          sin_(size / 2),
+          bitReverse_(size),
+          re_(size),
+          im_(size),
+          bandFirst_(bands),
+          bandLast_(bands) {
+    for (int i = 0; i < size; i++) {
+        window_[i] = 0.5f - 0.5f * std::cos(2.0f * PI * i / size);
+    }
+    for (int i = 0; i < size / 2; i++) {
+        cos_[i] = std::cos(2.0f * PI * i / size);
+        sin_[i] = -std::sin(2.0f * PI * i / size);
+    }
+    int bits = 0;
+    while ((1 << bits) < size) {
+        bits++;
+    }
+    for (int i = 0; i < size; i++) {
+        int reversed = 0;
+        for (int bit = 0; bit < bits; bit++) {
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        }
+        bitReverse_[i] = reversed;
+    }
+
+    // Band b covers the geometric midpoints around its center frequency
+    float binHz = static_cast<float>(sampleRate) / size;
+    maxHz = std::min(maxHz, sampleRate / 2.0f - binHz);
+    float ratio = std::pow(maxHz / minHz, 1.0f / bands);
+    for (int b = 0; b < bands; b++) {
+        float low = minHz * std::pow(ratio, static_cast<float>(b));
+        float center = low * std::sqrt(ratio);
+        int first = static_cast<int>(std::ceil(low / binHz));
+        int last = static_cast<int>(std::ceil(low * ratio / binHz)) - 1;
+        if (last < first) {
+            first = last = static_cast<int>(std::lround(center / binHz));
+        }
+        bandFirst_[b] = std::clamp(first, 1, size / 2 - 1);
+        bandLast_[b] = std::clamp(last, bandFirst_[b], size / 2 - 1);
+    }
+}
+
+void SpectrumAnalyzer::analyze(const float* samples, float* bands) {
+    for (int i = 0; i < size_; i++) {
+        re_[bitReverse_[i]] = samples[i] * window_[i];
+        im_[i] = 0.0f;
+    }
+    transform();
+    collect(bands);
+}
+
+void SpectrumAnalyzer::analyze(const int16_t* samples, float* bands) {
+    for (int i = 0; i < size_; i++) {
+        re_[bitReverse_[i]] = samples[i] * (1.0f / 32768.0f) * window_[i];
+        im_[i] = 0.0f;
+    }
+    transform();
+    collect(bands);
+}
+
+// In-place iterative FFT over the bit-reversed input
+void SpectrumAnalyzer::transform() {
+    for (int half = 1; half < size_; half *= 2) {
+        int stride = size_ / (half * 2);
+        for (int start = 0; start < size_; start += half * 2) {
+            for (int k = 0; k < half; k++) {
+                float wr = cos_[k * stride];
+                float wi = sin_[k * stride];
+                int a = start + k;
+                int b = a + half;
+                float tr = re_[b] * wr - im_[b] * wi;
+                float ti = re_[b] * wi + im_[b] * wr;
+                re_[b] = re_[a] - tr;
+                im_[b] = im_[a] - ti;
+                re_[a] += tr;
+                im_[a] += ti;
+            }
+        }
+    }
+}
+
+void SpectrumAnalyzer::collect(float* bands) const {
+    // A full-scale sine under a Hann window peaks at size / 4
+    float scale = 4.0f / size_;
+    for (size_t b = 0; b < bandFirst_.size(); b++) {
+        float power = 0.0f;
+        for (int bin = bandFirst_[b]; bin <= bandLast_[b]; bin++) {
+            power = std::max(power, re_[bin] * re_[bin] + im_[bin] * im_[bin]);
+        }
+        float magnitude = std::sqrt(power) * scale;
+        bands[b] = magnitude > 0.0f ? std::max(20.0f * std::log10(magnitude), FLOOR_DB) : FLOOR_DB;
+    }
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace musicsheetflow {
+
+/**
+ * Magnitude spectrum of the input in log-spaced bands, for display.
+ *
+ * A Hann-windowed radix-2 FFT over one analysis window. Each band takes the
+ * strongest bin it covers, or the bin under its center where it is narrower
+ * than a bin, so the bass end does not show gaps. Tables and buffers are
+ * built in the constructor and analyze() runs on the audio thread.
+ */
+class SpectrumAnalyzer {
+public:
+    // `size` is a power of two; bands span minHz..maxHz (clamped to Nyquist)
+    SpectrumAnalyzer(int sampleRate, int size, int bands, float minHz, float maxHz);
+
+    // Band levels in dBFS (a full-scale sine reads 0) for `size` samples
+    void analyze(const float* samples, float* bands);
+    void analyze(const int16_t* samples, float* bands);
+
+    int size() const { return size_; }
+    int bands() const { return static_cast<int>(bandFirst_.size()); }
+
+private:
+    void transform();
+    void collect(float* bands) const;
+
+    int size_;
+    std::vector<float> window_;
+    std::vector<float> cos_;  // Twiddles, size/2
+    std::vector<float> sin_;
+    std::vector<int> bitReverse_;
+    std::vector<float> re_;
+    std::vector<float> im_;
+    std::vector<int> bandFirst_;  // First and last bin of each band
+    std::vector<int> bandLast_;
+};
+
+}  // namespace musicsheetflow
@@ -0,0 +1,123 @@
+#include "synth_slot.h"
+
+#include "third_party/tsf.h"
+
+namespace musicsheetflow {
+
+static constexpr int MIDI_CHANNELS = 16;
+static constexpr int DRUM_CHANNEL = 9;
+
+// A replaced synth keeps playing the notes it had until they are released;
+// past this it releases them itself, and past twice this it is dropped
+static constexpr double REPLACED_SYNTH_HOLD_SECONDS = 4.0;
+
+static void closeSynth(SynthFont* font) {
+    if (font) {
+        tsf_close(font->synth);
+        delete font;
+    }
+}
+
+SynthSlot::SynthSlot(RetiredSynths& retired) : retired_(retired) {
+    channelPresets_[0] = {0, 0, true};             // Piano (General MIDI preset 0)
+    channelPresets_[DRUM_CHANNEL] = {0, 1, true};  // GM drum kit, bank 128
+}
+
+SynthSlot::~SynthSlot() {
+    closeSynth(pending_.exchange(nullptr, std::memory_order_acquire));
+    closeSynth(current_);
+    closeSynth(replaced_);
+}
+
+void SynthSlot::offer(SynthFont* font) {
+    // Superseded before the render thread took it; it never played
+    closeSynth(pending_.exchange(font, std::memory_order_acq_rel));
+}
+
+// One replacement at a time: a newer offer waits until the replaced synth
+// is done
+void SynthSlot::install(int sampleRate) {
+    if (replaced_ || !pending_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    SynthFont* next = pending_.exchange(nullptr, std::memory_order_acquire);
+    if (!next) {
+        return;
+    }
+    replaced_ = current_;
+    replacedFrames_ = 0;
+    replacedReleased_ = false;
+    current_ = next;
+    synth_ = next->synth;
+
+    // The stream may have started at another rate since it was built
+    setOutput(sampleRate);
+    for (int channel = 0; channel < MIDI_CHANNELS; channel++) {
+        const ChannelPreset& preset = channelPresets_[channel];
+        if (preset.set) {
+            tsf_channel_set_presetnumber(synth_, channel, preset.preset, preset.bank);
+        }
+    }
+}
+
+void SynthSlot::setOutput(int sampleRate) {
+    if (synth_) {
+        tsf_set_output(synth_, TSF_STEREO_INTERLEAVED, sampleRate, 0.0f);
+        tsf_set_volume(synth_, volume_);
+    }
+}
+
+void SynthSlot::apply(const MidiCommand& command) {
+    switch (command.type) {
+        case MidiCommand::Type::NoteOn:
+            tsf_channel_note_on(synth_, command.channel, command.data1, command.value);
+            break;
+        case MidiCommand::Type::NoteOff:
+            tsf_channel_note_off(synth_, command.channel, command.data1);
+            if (replaced_) {
+                // The note may have started before the synth was replaced
+                tsf_channel_note_off(replaced_->synth, command.channel, command.data1);
+            }
+            break;
+        case MidiCommand::Type::AllNotesOff:
+            tsf_note_off_all(synth_);
+            if (replaced_) {
+                tsf_note_off_all(replaced_->synth);
+            }
+            break;
+        case MidiCommand::Type::SetPreset:
+            tsf_channel_set_presetnumber(synth_, command.channel, command.data1, command.data2);
+            channelPresets_[command.channel] = {command.data1, command.data2, true};
+            break;
+        case MidiCommand::Type::SetVolume:
+            tsf_set_volume(synth_, command.value);
+            volume_ = command.value;
+            break;
+    }
+}
+
+void SynthSlot::renderReplaced(float* output, int32_t numFrames, int sampleRate) {
+    if (!replaced_) {
+        return;
+    }
+    tsf_render_float(replaced_->synth, output, numFrames, 1);
+    replacedFrames_ += numFrames;
+    auto hold = static_cast<int64_t>(REPLACED_SYNTH_HOLD_SECONDS * sampleRate);
+    if (!replacedReleased_ && replacedFrames_ >= hold) {
+        tsf_note_off_all(replaced_->synth);
+        replacedReleased_ = true;
+    }
+    if (tsf_active_voice_count(replaced_->synth) == 0 || replacedFrames_ >= 2 * hold) {
+        dropReplaced();
+    }
+}
+
+void SynthSlot::dropReplaced() {
+    // A full queue means the control thread has fallen far behind; keep the
+    // synth until there is room rather than free it here
+    if (replaced_ && retired_.push(replaced_)) {
+        replaced_ = nullptr;
+    }
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "lock_free_queue.h"
+#include "midi_command.h"
+#include <android/asset_manager.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+struct tsf;
+
+namespace musicsheetflow {
+
+// A playing instance of the loaded font, handed to a render thread whole
+struct SynthFont {
+    tsf* synth = nullptr;
+    std::shared_ptr<AAsset> samples;  // Backs the samples when mapped from the APK
+};
+
+// Replaced synths waiting for the control thread to free them
+using RetiredSynths = LockFreeQueue<SynthFont*, 8>;
+
+/**
+ * The synth one render thread plays, and its replacement.
+ *
+ * The control thread offers a configured synth; the render thread swaps it
+ * in between blocks with the presets and volume the old one had. The old
+ * synth keeps rendering under the new one until its notes are released, so
+ * a font load or pool resize never cuts a note off, and is then handed back
+ * through `retired` for the control thread to free.
+ */
+class SynthSlot {
+public:
+    explicit SynthSlot(RetiredSynths& retired);
+    ~SynthSlot();  // Frees whatever it still holds; no render thread may be running
+
+    SynthSlot(const SynthSlot&) = delete;
+    SynthSlot& operator=(const SynthSlot&) = delete;
+
+    // Control thread: a synth to swap in; an earlier one not yet taken is freed
+    void offer(SynthFont* font);
+
+    // Render thread (control thread while stopped)
+    tsf* synth() const { return synth_; }
+    void install(int sampleRate);  // Swap in the last offer, if any
+    void setOutput(int sampleRate);
+    void apply(const MidiCommand& command);  // Caller checks the channel
+    void renderReplaced(float* output, int32_t numFrames, int sampleRate);  // Mixes
+    void dropReplaced();  // Stream stopped: no one is left to hear its notes
+
+private:
+    struct ChannelPreset {
+        int preset;
+        int bank;
+        bool set;
+    };
+
+    RetiredSynths& retired_;
+    std::atomic<SynthFont*> pending_{nullptr};  // Offered, not yet swapped in
+
+    // Render thread state
+    SynthFont* current_ = nullptr;
+    tsf* synth_ = nullptr;  // current_->synth
+    SynthFont* replaced_ = nullptr;  // Finishing the notes it was playing
+    int64_t replacedFrames_ = 0;
+    bool replacedReleased_ = false;
+    ChannelPreset channelPresets_[16] = {};
+    float volume_ = 1.0f;
+};
+
+}  // namespace musicsheetflow
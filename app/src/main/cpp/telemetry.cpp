@@ -0,0 +1,16 @@
+#include "telemetry.h"
+
+namespace musicsheetflow {
+
+static EngineTelemetry g_engineTelemetry{};
+static EngineTelemetry g_telemetrySnapshot{};
+
+EngineTelemetry* getEngineTelemetry() {
+    return &g_engineTelemetry;
+}
+
+EngineTelemetry* getTelemetrySnapshot() {
+    return &g_telemetrySnapshot;
+}
+
+}  // namespace musicsheetflow
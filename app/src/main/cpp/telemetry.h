@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+namespace musicsheetflow {
+
+// Log-spaced input spectrum bands, 50 Hz - 8 kHz
+static constexpr int TELEMETRY_SPECTRUM_BANDS = 64;
+
+// Input analysis, written by the input callback once per analysis window.
+// `sequence` is a seqlock counter (odd while a write is in progress).
+struct InputTelemetry {
+    std::atomic<uint32_t> sequence;  // offset 0
+    int32_t gateOpen;                // offset 4: 1 while the level is above the noise gate
+    float rms;                       // offset 8: last window, linear
+    float peak;                      // offset 12: highest |sample| since the previous window
+    float frequency;                 // offset 16: Hz, 0 without a pitch
+    float confidence;                // offset 20: 0 without a pitch
+    float analysisLoad;              // offset 24: callback time as a share of the audio it took in
+    uint32_t xruns;                  // offset 28: input overruns since the stream opened
+    float latencyMillis;             // offset 32: input stream latency, 0 if unknown
+    int32_t spectrumValid;           // offset 36: 1 when `spectrum` is from this window
+    int64_t timestampNs;             // offset 40: CLOCK_MONOTONIC time of the window
+    float spectrum[TELEMETRY_SPECTRUM_BANDS];  // offset 48: dBFS per band
+};
+static_assert(sizeof(InputTelemetry) == 304, "Telemetry layout is shared with Kotlin");
+
+// Synth output, written by the output callback about ten times a second
+struct OutputTelemetry {
+    std::atomic<uint32_t> sequence;  // offset 0
+    int32_t activeVoices;            // offset 4
+    float renderLoad;                // offset 8: callback time as a share of its period, smoothed
+    uint32_t xruns;                  // offset 12: output underruns since the stream opened
+    float latencyMillis;             // offset 16: as getOutputLatencyMillis()
+    float peak;                      // offset 20: highest output sample since the previous write
+    int64_t frame;                   // offset 24: output frames played
+};
+static_assert(sizeof(OutputTelemetry) == 32, "Telemetry layout is shared with Kotlin");
+
+/**
+ * Engine state for the UI (level meter, spectrum, debug overlay), read by
+ * Kotlin through a direct ByteBuffer over a snapshot copied with read().
+ *
+ * Each half has a single writer, the callback it describes, and its own
+ * seqlock, so the two streams never wait on each other. Writers bracket
+ * their stores with beginWrite() and endWrite(); readers take a copy with
+ * read(), which retries while the counter is odd or has moved.
+ */
+struct EngineTelemetry {
+    InputTelemetry input;    // offset 0
+    OutputTelemetry output;  // offset 304
+
+    template <typename Half>
+    static void beginWrite(Half& half) {
+        half.sequence.store(half.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    template <typename Half>
+    static void endWrite(Half& half) {
+        half.sequence.store(half.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consistent copy of one half into `out`, whose counter is left alone
+    template <typename Half>
+    static void read(const Half& half, Half& out) {
+        constexpr size_t fields = sizeof(half.sequence);
+        for (;;) {
+            uint32_t before = half.sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            memcpy(reinterpret_cast<char*>(&out) + fields, reinterpret_cast<const char*>(&half) + fields,
+                   sizeof(Half) - fields);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (half.sequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+    }
+};
+static_assert(sizeof(EngineTelemetry) == 336, "Telemetry layout is shared with Kotlin");
+
+// The process-wide block, shared by the input and output engines
+EngineTelemetry* getEngineTelemetry();
+
+// Copies taken with EngineTelemetry::read() for Kotlin, which has no
+// fences to read the live block with (VarHandle needs API 33)
+EngineTelemetry* getTelemetrySnapshot();
+
+}  // namespace musicsheetflow
@@ -0,0 +1,180 @@
+#include "tempo_map.h"
+#include <algorithm>
+#include <cmath>
+
+namespace musicsheetflow {
+
+static constexpr float MIN_TEMPO = 20.0f;
+static constexpr float MAX_TEMPO = 300.0f;
+
+// Map entries may go past the practice range (MIDI files do); the scale
+// brings the opening tempo into it
+static constexpr double MIN_MAP_BPM = 5.0;
+static constexpr double MAX_MAP_BPM = 1000.0;
+
+static constexpr float MIN_SCALE = 0.1f;
+static constexpr float MAX_SCALE = 4.0f;
+
+static constexpr double DEFAULT_BPM = 120.0;
+
+// Below this a ramp is treated as constant, where ln() loses precision
+static constexpr double MIN_SLOPE = 1e-9;
+
+// Seconds to cross `beats` from the start of a segment
+static double segmentSeconds(double bpm, double slope, double beats) {
+    if (std::fabs(slope) < MIN_SLOPE) {
+        return beats * 60.0 / bpm;
+    }
+    return 60.0 / slope * std::log((bpm + slope * beats) / bpm);
+}
+
+// Inverse of segmentSeconds
+static double segmentBeats(double bpm, double slope, double seconds) {
+    if (std::fabs(slope) < MIN_SLOPE) {
+        return seconds * bpm / 60.0;
+    }
+    return bpm * std::expm1(slope * seconds / 60.0) / slope;
+}
+
+TempoMap::TempoMap() {
+    TempoSegment opening{0.0, static_cast<float>(DEFAULT_BPM), false};
+    latest_ = build(&opening, 1);
+    map_ = new Segments(latest_);
+}
+
+TempoMap::~TempoMap() {
+    delete pending_.exchange(nullptr, std::memory_order_acquire);
+    reclaim();
+    delete map_;
+}
+
+TempoMap::Segments TempoMap::build(const TempoSegment* segments, int count) {
+    std::vector<TempoSegment> sorted(segments, segments + std::max(count, 0));
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const TempoSegment& a, const TempoSegment& b) { return a.beat < b.beat; });
+
+    Segments map;
+    std::vector<bool> ramps;
+    for (const TempoSegment& entry : sorted) {
+        double bpm = std::clamp(static_cast<double>(entry.bpm), MIN_MAP_BPM, MAX_MAP_BPM);
+        double beat = std::max(entry.beat, 0.0);
+        if (!map.empty() && map.back().beat == beat) {
+            map.pop_back();  // A later entry at the same beat wins
+            ramps.pop_back();
+        }
+        map.push_back({beat, bpm, 0.0, 0.0});
+        ramps.push_back(entry.ramp);
+    }
+    if (map.empty()) {
+        map.push_back({0.0, DEFAULT_BPM, 0.0, 0.0});
+        ramps.push_back(false);
+    }
+    map.front().beat = 0.0;
+
+    // The last segment holds its tempo
+    for (size_t i = 0; i + 1 < map.size(); i++) {
+        Segment& segment = map[i];
+        Segment& next = map[i + 1];
+        double beats = next.beat - segment.beat;
+        if (ramps[i]) {
+            segment.slope = (next.bpm - segment.bpm) / beats;
+        }
+        next.seconds = segment.seconds + segmentSeconds(segment.bpm, segment.slope, beats);
+    }
+    return map;
+}
+
+void TempoMap::set(const TempoSegment* segments, int count) {
+    std::lock_guard<std::mutex> lock(latestMutex_);
+    reclaim();
+    latest_ = build(segments, count);
+    // Replaces an offer the render thread has not taken yet
+    delete pending_.exchange(new Segments(latest_), std::memory_order_acq_rel);
+    scale_.store(1.0f, std::memory_order_relaxed);
+}
+
+void TempoMap::setTempo(float bpm) {
+    bpm = std::clamp(bpm, MIN_TEMPO, MAX_TEMPO);
+    setScale(static_cast<float>(bpm / openingBpm()));
+}
+
+void TempoMap::setScale(float scale) {
+    scale_.store(std::clamp(scale, MIN_SCALE, MAX_SCALE), std::memory_order_relaxed);
+}
+
+float TempoMap::openingBpm() {
+    std::lock_guard<std::mutex> lock(latestMutex_);
+    return static_cast<float>(latest_.front().bpm);
+}
+
+double TempoMap::framesBetweenLatest(double fromBeat, double toBeat) {
+    std::lock_guard<std::mutex> lock(latestMutex_);
+    double seconds = secondsAt(latest_, toBeat) - secondsAt(latest_, fromBeat);
+    return seconds / scale_.load(std::memory_order_relaxed) * sampleRate_.load(std::memory_order_relaxed);
+}
+
+// Control thread, under latestMutex_ (the retired queue has one consumer)
+void TempoMap::reclaim() {
+    Segments* old = nullptr;
+    while (retired_.pop(old)) {
+        delete old;
+    }
+}
+
+void TempoMap::update() {
+    blockScale_ = scale_.load(std::memory_order_relaxed);
+    if (!pending_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Segments* next = pending_.exchange(nullptr, std::memory_order_acquire);
+    if (!next) {
+        return;
+    }
+    if (!retired_.push(map_)) {
+        delete map_;  // Not expected: the control thread reclaims on every set
+    }
+    map_ = next;
+}
+
+double TempoMap::framesBetween(double fromBeat, double toBeat) const {
+    double seconds = secondsAt(*map_, toBeat) - secondsAt(*map_, fromBeat);
+    return seconds / blockScale_ * sampleRate_.load(std::memory_order_relaxed);
+}
+
+double TempoMap::advance(double beat, double frames) const {
+    double seconds = frames / sampleRate_.load(std::memory_order_relaxed) * blockScale_;
+    return beatAt(*map_, secondsAt(*map_, beat) + seconds);
+}
+
+float TempoMap::bpmAt(double beat) const {
+    const Segment& segment = find(*map_, beat);
+    double bpm = segment.bpm + segment.slope * std::max(0.0, beat - segment.beat);
+    return static_cast<float>(bpm * blockScale_);
+}
+
+// Segment holding `beat`; the first one for beats before 0
+const TempoMap::Segment& TempoMap::find(const Segments& map, double beat) {
+    auto it = std::upper_bound(map.begin(), map.end(), beat,
+                               [](double b, const Segment& s) { return b < s.beat; });
+    return it == map.begin() ? map.front() : *(it - 1);
+}
+
+double TempoMap::secondsAt(const Segments& map, double beat) {
+    if (beat < 0.0) {
+        return beat * 60.0 / map.front().bpm;
+    }
+    const Segment& segment = find(map, beat);
+    return segment.seconds + segmentSeconds(segment.bpm, segment.slope, beat - segment.beat);
+}
+
+double TempoMap::beatAt(const Segments& map, double seconds) {
+    if (seconds < 0.0) {
+        return seconds * map.front().bpm / 60.0;
+    }
+    auto it = std::upper_bound(map.begin(), map.end(), seconds,
+                               [](double s, const Segment& segment) { return s < segment.seconds; });
+    const Segment& segment = it == map.begin() ? map.front() : *(it - 1);
+    return segment.beat + segmentBeats(segment.bpm, segment.slope, seconds - segment.seconds);
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "lock_free_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace musicsheetflow {
+
+// One tempo map entry: `bpm` from `beat` on, held until the next entry or,
+// with `ramp`, gliding linearly (in beats) to the next entry's tempo
+struct TempoSegment {
+    double beat;
+    float bpm;
+    bool ramp;
+};
+
+/**
+ * Beat <-> time mapping shared by the sequencer, the metronome and timing
+ * judgements.
+ *
+ * The map is a list of constant and ramped segments plus a practice scale
+ * that speeds the whole piece up or slows it down. Every segment start
+ * carries its time from beat 0, so a conversion is one binary search.
+ * Consumers keep their position in beats and convert each block, so a new
+ * map or scale takes effect at the next block without rescheduling
+ * anything. Beats before 0 (count-in) run at the opening tempo.
+ *
+ * The map and scale may be set from any control thread. The render thread
+ * latches them with update() once per block, so the sequencer and the
+ * metronome always agree within a block.
+ */
+class TempoMap {
+public:
+    TempoMap();
+    ~TempoMap();
+
+    TempoMap(const TempoMap&) = delete;
+    TempoMap& operator=(const TempoMap&) = delete;
+
+    // Control thread API. A new map starts at beat 0 and plays as written
+    // (scale 1); setTempo() scales it so it opens at `bpm`.
+    void set(const TempoSegment* segments, int count);
+    void setTempo(float bpm);
+    void setScale(float scale);
+    float scale() const { return scale_.load(std::memory_order_relaxed); }
+    float openingBpm();
+    // Output frames from one beat to another with the latest map and scale
+    double framesBetweenLatest(double fromBeat, double toBeat);
+
+    // Called while the output stream is stopped
+    void setSampleRate(int sampleRate) { sampleRate_.store(sampleRate, std::memory_order_relaxed); }
+
+    // Render thread API: update() before the consumers in each block
+    void update();
+    double framesBetween(double fromBeat, double toBeat) const;
+    double advance(double beat, double frames) const;  // Beat `frames` after `beat`
+    float bpmAt(double beat) const;                    // Scaled
+
+private:
+    struct Segment {
+        double beat;
+        double bpm;
+        double slope;    // BPM per beat; 0 for a constant segment
+        double seconds;  // From beat 0 to the segment start, unscaled
+    };
+
+    using Segments = std::vector<Segment>;
+
+    static Segments build(const TempoSegment* segments, int count);
+    static const Segment& find(const Segments& map, double beat);
+    static double secondsAt(const Segments& map, double beat);
+    static double beatAt(const Segments& map, double seconds);
+    void reclaim();
+
+    // Render thread state
+    Segments* map_;
+    float blockScale_ = 1.0f;
+
+    std::atomic<Segments*> pending_{nullptr};
+    LockFreeQueue<Segments*, 16> retired_;  // Swapped out, freed on the control thread
+    std::atomic<float> scale_{1.0f};
+    std::atomic<int> sampleRate_{44100};
+
+    std::mutex latestMutex_;
+    Segments latest_;  // Control thread copy of the newest map
+};
+
+}  // namespace musicsheetflow
@@ -13,6 +13,7 @@
    [OPTIONAL] #define TSF_MALLOC, TSF_REALLOC, and TSF_FREE to avoid stdlib.h
    [OPTIONAL] #define TSF_MEMCPY, TSF_MEMSET to avoid string.h
    [OPTIONAL] #define TSF_POW, TSF_POWF, TSF_EXPF, TSF_LOG, TSF_TAN, TSF_LOG10, TSF_SQRT to avoid math.h
+   [OPTIONAL] #define TSF_NO_SIMD to render voices with the scalar loop only (no NEON/SSE2)
 
    NOT YET IMPLEMENTED
      - Support for ChorusEffectsSend and ReverbEffectsSend generators
@@ -73,6 +74,16 @@ TSFDEF tsf* tsf_load_filename(const char* filename);
 // Load a SoundFont from a block of memory
 TSFDEF tsf* tsf_load_memory(const void* buffer, int size);
 
+// Load a SoundFont from memory that stays valid and unchanged until the last
+// tsf_close of this instance and its copies (e.g. a mapped file or asset).
+// The 16-bit sample data is used in place instead of being copied.
+TSFDEF tsf* tsf_load_mapped(const void* buffer, int size);
+
+// Every tsf_load* function also accepts baked fonts (see tools/soundfont_bake.cpp):
+// selected presets stored as tsf's own regions plus the 16-bit samples they play,
+// so loading them parses nothing and tsf_load_mapped uses the samples in place.
+#define TSF_BAKED_VERSION 1
+
 // Stream structure for the generic loading
 struct tsf_stream
 {
@@ -84,6 +95,10 @@ struct tsf_stream
 
 	// Function pointer will be called to skip ahead over 'count' bytes (returns 1 on success, 0 on error)
 	int (*skip)(void* data, unsigned int count);
+
+	// Optional: return a pointer to the next 'size' bytes and skip over them (TSF_NULL on error).
+	// If set, sample data is used in place and must outlive every tsf loaded from this stream.
+	const void* (*map)(void* data, unsigned int size);
 };
 
 // Generic SoundFont loading method using the stream structure above
@@ -92,9 +107,15 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream);
 // Copy a tsf instance from an existing one, use tsf_close to close it as well.
 // All copied tsf instances and their original instance are linked, and share the underlying soundfont.
 // This allows loading a soundfont only once, but using it for multiple independent playbacks.
-// (This function isn't thread-safe without locking.)
+// (This function isn't thread-safe without locking when f has never been copied before.
+// Once it has, the shared count is atomic and copies of copies can be made on any thread.)
 TSFDEF tsf* tsf_copy(tsf* f);
 
+// Copy a tsf instance like tsf_copy, but the copy also takes over the playing voices,
+// channel settings and voice pool of the original, so it continues from the same state.
+// (This function isn't thread-safe without locking either.)
+TSFDEF tsf* tsf_copy_playing(tsf* f);
+
 // Free the memory related to this tsf instance
 TSFDEF void tsf_close(tsf* f);
 
@@ -113,6 +134,18 @@ TSFDEF const char* tsf_get_presetname(const tsf* f, int preset_index);
 // Returns the name of a preset by bank and preset number
 TSFDEF const char* tsf_bank_get_presetname(const tsf* f, int bank, int preset_number);
 
+// Returns the bank and preset number of a preset index (-1 if the index is invalid)
+TSFDEF int tsf_get_presetbank(const tsf* f, int preset_index);
+TSFDEF int tsf_get_presetnumber(const tsf* f, int preset_index);
+
+// Returns the 16-bit sample data shared by all presets, and its length in samples
+TSFDEF const short* tsf_get_sampledata(const tsf* f, unsigned int* sample_count);
+
+// Sample data a preset can play, e.g. to page it in before use or to measure it
+// Writes one [first, end) sample index pair per region into spans (regions may overlap)
+// and returns the region count, which can be more than max_spans
+TSFDEF int tsf_get_preset_samplespans(const tsf* f, int preset_index, unsigned int* spans, int max_spans);
+
 // Supported output modes by the render methods
 enum TSFOutputMode
 {
@@ -160,10 +193,30 @@ TSFDEF void tsf_set_volume(tsf* f, float global_gain);
 // Set the maximum number of voices to play simultaneously
 // Depending on the soundfond, one note can cause many new voices to be started,
 // so don't keep this number too low or otherwise sounds may not play.
+// With a maximum set, note on never allocates: when every voice is busy it steals
+// the quietest voice in its release, else the oldest voice on the same key,
+// else the oldest voice. Lowering the maximum ends the voices above it.
 //   max_voices: maximum number to pre-allocate and set the limit to
 //   (tsf_set_max_voices returns 0 if allocation failed, otherwise 1)
 TSFDEF int tsf_set_max_voices(tsf* f, int max_voices);
 
+// Voice pool statistics
+//   tsf_get_stolen_voice_count: voices cut off for a new note since the last reset
+//   tsf_get_peak_voice_count: most voices playing at once since the last reset
+//   flag_reset: restart counting from now on
+TSFDEF int tsf_get_stolen_voice_count(tsf* f, int flag_reset);
+TSFDEF int tsf_get_peak_voice_count(tsf* f, int flag_reset);
+
+// Trade sound quality for render time, e.g. while the output callback runs close to its deadline
+//   voice_limit: note on takes over a playing voice once this many play (0 for the whole pool)
+//   quiet_filter_gain: voices quieter than this linear gain skip their lowpass filter (0 filters all)
+//   flag_nearest: play the nearest sample instead of interpolating between two
+TSFDEF void tsf_set_render_quality(tsf* f, int voice_limit, float quiet_filter_gain, int flag_nearest);
+
+// End the voices in their release that are quieter than min_gain (linear) right away
+//   (returns the number of voices ended)
+TSFDEF int tsf_cull_released_voices(tsf* f, float min_gain);
+
 // Start playing a note
 //   preset_index: preset index >= 0 and < tsf_get_presetcount()
 //   key: note value between 0 and 127 (60 being middle C)
@@ -195,6 +248,20 @@ TSFDEF int tsf_active_voice_count(tsf* f);
 TSFDEF void tsf_render_short(tsf* f, short* buffer, int samples, int flag_mixing CPP_DEFAULT0);
 TSFDEF void tsf_render_float(tsf* f, float* buffer, int samples, int flag_mixing CPP_DEFAULT0);
 
+// Advance the playing voices by samples without rendering them, for seeking through a song
+// Envelopes, LFOs and sample positions move on as in tsf_render_float, but the lowpass
+// filters keep their state; render a few milliseconds before the output that is kept.
+TSFDEF void tsf_render_skip(tsf* f, int samples);
+
+// Render part of the playing voices, to split one render call across threads
+// Voices are independent, so disjoint slot ranges may render concurrently
+//   tsf_render_voice_slots: number of slots to partition, taken before rendering
+//   tsf_render_float_voices: mix slots [begin, end) into buffer (never clears it)
+//   tsf_render_compact: call once after every slot has rendered, drops finished voices
+TSFDEF int tsf_render_voice_slots(tsf* f);
+TSFDEF void tsf_render_float_voices(tsf* f, float* buffer, int samples, int begin, int end);
+TSFDEF void tsf_render_compact(tsf* f);
+
 // Higher level channel based functions, set up channel parameters
 //   channel: channel number
 //   preset_index: preset index >= 0 and < tsf_get_presetcount()
@@ -256,6 +323,13 @@ TSFDEF float tsf_channel_get_tuning(tsf* f, int channel);
 #ifdef TSF_IMPLEMENTATION
 #undef TSF_IMPLEMENTATION
 
+// Count of instances sharing one soundfont, see tsf_copy
+#if defined(__GNUC__) || defined(__clang__)
+#define TSF_REFCOUNT_ADD(count, n) __atomic_add_fetch((count), (n), __ATOMIC_ACQ_REL)
+#else
+#define TSF_REFCOUNT_ADD(count, n) (*(count) += (n))
+#endif
+
 // The lower this block size is the more accurate the effects are.
 // Increasing the value significantly lowers the CPU usage of the voice rendering.
 // If LFO affects the low-pass filter it can be hearable even as low as 8.
@@ -307,6 +381,16 @@ TSFDEF float tsf_channel_get_tuning(tsf* f, int channel);
 #  include <stdio.h>
 #endif
 
+#if !defined(TSF_NO_SIMD)
+#  if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define TSF_SIMD_NEON
+#  elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define TSF_SIMD_SSE2
+#  endif
+#endif
+
 #define TSF_TRUE 1
 #define TSF_FALSE 0
 #define TSF_BOOL unsigned char
@@ -327,16 +411,31 @@ typedef char tsf_char20[20];
 
 #define TSF_FourCCEquals(value1, value2) (value1[0] == value2[0] && value1[1] == value2[1] && value1[2] == value2[2] && value1[3] == value2[3])
 
+// Baked font layout: header, presetNum preset records, regionNum struct tsf_region
+// (preset order, native little-endian layout), sampleNum 16-bit samples.
+// The first 8 bytes read like a chunk header ("TSFB" and the version).
+struct tsf_baked_header { tsf_fourcc magic; tsf_u32 version, regionSize, presetNum, regionNum, sampleNum; };
+struct tsf_baked_preset { tsf_char20 presetName; tsf_u16 preset, bank; tsf_u32 regionNum; };
+
 struct tsf
 {
 	struct tsf_preset* presets;
-	float* fontSamples;
+	const short* fontSamples; // 16-bit PCM, scaled to float while rendering
+	void* fontSamplesAlloc; // fontSamples if owned, TSF_NULL if mapped
+	unsigned int fontSampleNum;
 	struct tsf_voice* voices;
 	struct tsf_channels* channels;
+	int* activeVoices; // compact list of indices of playing voices (render order)
 
 	int presetNum;
 	int voiceNum;
+	int activeVoiceNum;
 	int maxVoiceNum;
+	int stolenVoiceNum;
+	int peakVoiceNum;
+	int voiceLimit;
+	float quietFilterGain;
+	TSF_BOOL nearestSample;
 	unsigned int voicePlayIndex;
 
 	enum TSFOutputMode outputmode;
@@ -351,7 +450,7 @@ static int tsf_stream_stdio_skip(FILE* f, unsigned int count) { return !fseek(f,
 TSFDEF tsf* tsf_load_filename(const char* filename)
 {
 	tsf* res;
-	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_stdio_read, (int(*)(void*,unsigned int))&tsf_stream_stdio_skip };
+	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_stdio_read, (int(*)(void*,unsigned int))&tsf_stream_stdio_skip, TSF_NULL };
 	#if __STDC_WANT_SECURE_LIB__
 	FILE* f = TSF_NULL; fopen_s(&f, filename, "rb");
 	#else
@@ -374,7 +473,18 @@ static int tsf_stream_memory_read(struct tsf_stream_memory* m, void* ptr, unsign
 static int tsf_stream_memory_skip(struct tsf_stream_memory* m, unsigned int count) { if (m->pos + count > m->total) return 0; m->pos += count; return 1; }
 TSFDEF tsf* tsf_load_memory(const void* buffer, int size)
 {
-	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip };
+	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip, TSF_NULL };
+	struct tsf_stream_memory f = { 0, 0, 0 };
+	f.buffer = (const char*)buffer;
+	f.total = size;
+	stream.data = &f;
+	return tsf_load(&stream);
+}
+
+static const void* tsf_stream_memory_map(struct tsf_stream_memory* m, unsigned int size) { const char* p = m->buffer + m->pos; if (size > m->total - m->pos) return TSF_NULL; m->pos += size; return p; }
+TSFDEF tsf* tsf_load_mapped(const void* buffer, int size)
+{
+	struct tsf_stream stream = { TSF_NULL, (int(*)(void*,void*,unsigned int))&tsf_stream_memory_read, (int(*)(void*,unsigned int))&tsf_stream_memory_skip, (const void*(*)(void*,unsigned int))&tsf_stream_memory_map };
 	struct tsf_stream_memory f = { 0, 0, 0 };
 	f.buffer = (const char*)buffer;
 	f.total = size;
@@ -419,8 +529,8 @@ static void tsf_hydra_read_shdr(struct tsf_hydra_shdr* i, struct tsf_stream* str
 
 struct tsf_riffchunk { tsf_fourcc id; tsf_u32 size; };
 struct tsf_envelope { float delay, attack, hold, decay, sustain, release, keynumToHold, keynumToDecay; };
-struct tsf_voice_envelope { unsigned char segment, segmentIsExponential : 1, isAmpEnv : 1; short midiVelocity; float level, slope; int samplesUntilNextSegment; struct tsf_envelope parameters; };
-struct tsf_voice_lowpass { double QInv, a0, a1, b1, b2, z1, z2; TSF_BOOL active; };
+struct tsf_voice_envelope { unsigned char segment, segmentIsExponential : 1, isAmpEnv : 1; short midiVelocity; float level, slope, blockMul, blockAdd; int samplesUntilNextSegment; struct tsf_envelope parameters; };
+struct tsf_voice_lowpass { double QInv, a0, a1, b1, b2, z1, z2; TSF_BOOL active, skipped; };
 struct tsf_voice_lfo { int samplesUntil; float level, delta; };
 
 struct tsf_region
@@ -446,11 +556,15 @@ struct tsf_preset
 	tsf_u16 preset, bank;
 	struct tsf_region* regions;
 	int regionNum;
+	// Regions by key: 129 offsets, then region indices in region order; those of key k
+	// are keyRegions[129 + keyRegions[k]] up to keyRegions[129 + keyRegions[k + 1]]
+	int* keyRegions;
 };
 
 struct tsf_voice
 {
 	int playingPreset, playingKey, playingChannel, heldSustain;
+	TSF_BOOL isListed; // in tsf::activeVoices
 	struct tsf_region* region;
 	double pitchInputTimecents, pitchOutputFactor;
 	double sourceSamplePosition;
@@ -713,7 +827,7 @@ static int tsf_load_presets(tsf* res, struct tsf_hydra *hydra, unsigned int font
 	res->presetNum = hydra->phdrNum - 1;
 	res->presets = (struct tsf_preset*)TSF_MALLOC(res->presetNum * sizeof(struct tsf_preset));
 	if (!res->presets) return 0;
-	else { int i; for (i = 0; i != res->presetNum; i++) res->presets[i].regions = TSF_NULL; }
+	else { int i; for (i = 0; i != res->presetNum; i++) res->presets[i].regions = TSF_NULL, res->presets[i].keyRegions = TSF_NULL; }
 	for (pphdr = hydra->phdrs, pphdrMax = pphdr + hydra->phdrNum - 1; pphdr != pphdrMax; pphdr++)
 	{
 		int sortedIndex = 0, region_index = 0;
@@ -990,24 +1104,35 @@ static int tsf_load_samples(void** pRawBuffer, float** pFloatBuffer, unsigned in
 	*pSmplCount = resNum;
 	return (*pFloatBuffer ? 1 : 0);
 	#else
-	// Inline convert the samples from short to float
-	float *res, *out; const short *in;
-	(void)pRawBuffer;
+	// Samples stay 16-bit, the render loop scales them
+	(void)pFloatBuffer;
 	*pSmplCount = chunkSmpl->size / (unsigned int)sizeof(short);
-	*pFloatBuffer = (float*)TSF_MALLOC(*pSmplCount * sizeof(float));
-	if (!*pFloatBuffer || !stream->read(stream->data, *pFloatBuffer, chunkSmpl->size)) return 0;
-	for (res = *pFloatBuffer, out = res + *pSmplCount, in = (short*)res + *pSmplCount; out != res;)
-		*(--out) = (float)(*(--in) / 32767.0);
-	return 1;
+	*pRawBuffer = TSF_MALLOC(chunkSmpl->size);
+	return (*pRawBuffer && stream->read(stream->data, *pRawBuffer, chunkSmpl->size) ? 1 : 0);
 	#endif
 }
 
+#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
+// Convert decoded float samples to 16-bit in place and shrink the buffer
+static short* tsf_samples_to_short(float* samples, unsigned int count)
+{
+	short *res = (short*)samples, *shrunk; unsigned int i;
+	for (i = 0; i != count; i++)
+	{
+		float v = samples[i] * 32767.0f;
+		res[i] = (short)(v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v));
+	}
+	shrunk = (short*)TSF_REALLOC(res, count * sizeof(short));
+	return (shrunk ? shrunk : res);
+}
+#endif
+
 static int tsf_voice_envelope_release_samples(struct tsf_voice_envelope* e, float outSampleRate)
 {
 	return (int)((e->parameters.release <= 0 ? TSF_FASTRELEASETIME : e->parameters.release) * outSampleRate);
 }
 
-static void tsf_voice_envelope_nextsegment(struct tsf_voice_envelope* e, short active_segment, float outSampleRate)
+static void tsf_voice_envelope_entersegment(struct tsf_voice_envelope* e, short active_segment, float outSampleRate)
 {
 	switch (active_segment)
 	{
@@ -1112,6 +1237,17 @@ static void tsf_voice_envelope_nextsegment(struct tsf_voice_envelope* e, short a
 	}
 }
 
+static void tsf_voice_envelope_nextsegment(struct tsf_voice_envelope* e, short active_segment, float outSampleRate)
+{
+	tsf_voice_envelope_entersegment(e, active_segment, outSampleRate);
+
+	// Level change over one full effect block as level = level * blockMul + blockAdd,
+	// so the per-block update needs no pow and no branch on the segment shape.
+	if (!e->slope) e->blockMul = 1.0f, e->blockAdd = 0.0f;
+	else if (e->segmentIsExponential) e->blockMul = TSF_POWF(e->slope, (float)TSF_RENDER_EFFECTSAMPLEBLOCK), e->blockAdd = 0.0f;
+	else e->blockMul = 1.0f, e->blockAdd = e->slope * TSF_RENDER_EFFECTSAMPLEBLOCK;
+}
+
 static void tsf_voice_envelope_setup(struct tsf_voice_envelope* e, struct tsf_envelope* new_parameters, int midiNoteNumber, short midiVelocity, TSF_BOOL isAmpEnv, float outSampleRate)
 {
 	e->parameters = *new_parameters;
@@ -1132,7 +1268,11 @@ static void tsf_voice_envelope_setup(struct tsf_voice_envelope* e, struct tsf_en
 
 static void tsf_voice_envelope_process(struct tsf_voice_envelope* e, int numSamples, float outSampleRate)
 {
-	if (e->slope)
+	if (numSamples == TSF_RENDER_EFFECTSAMPLEBLOCK)
+	{
+		e->level = e->level * e->blockMul + e->blockAdd;
+	}
+	else if (e->slope)
 	{
 		if (e->segmentIsExponential) e->level *= TSF_POWF(e->slope, (float)numSamples);
 		else e->level += (e->slope * numSamples);
@@ -1157,6 +1297,12 @@ static float tsf_voice_lowpass_process(struct tsf_voice_lowpass* e, double In)
 	double Out = In * e->a0 + e->z1; e->z1 = In * e->a1 + e->z2 - e->b1 * Out; e->z2 = In * e->a0 - e->b2 * Out; return (float)Out;
 }
 
+// State the filter settles to on a constant input In (unity gain at DC), so filtering can resume without a step
+static void tsf_voice_lowpass_prime(struct tsf_voice_lowpass* e, double In)
+{
+	e->z1 = In * (1.0 - e->a0); e->z2 = In * (e->a0 - e->b2);
+}
+
 static void tsf_voice_lfo_setup(struct tsf_voice_lfo* e, float delay, int freqCents, float outSampleRate)
 {
 	e->samplesUntil = (int)(delay * outSampleRate);
@@ -1217,10 +1363,162 @@ static void tsf_voice_calcpitchratio(struct tsf_voice* v, float pitchShift, floa
 	v->pitchOutputFactor = v->region->sample_rate / (tsf_timecents2Secsd(v->region->pitch_keycenter * 100.0) * outSampleRate);
 }
 
+#if defined(TSF_SIMD_NEON) || defined(TSF_SIMD_SSE2)
+// Number of samples (up to maxSamples) that can be rendered from position before reaching limit.
+// Inside that span no loop wrap happens and pos + 1 is always a valid read. The block renderers
+// recompute positions in float, which can round one up to the next sample, so the span stops a
+// sample short of limit.
+static int tsf_voice_fastcount(double position, double pitchRatio, double limit, int maxSamples)
+{
+	int count;
+	limit -= 1.0;
+	if (position >= limit || pitchRatio <= 0) return 0;
+	count = (int)((limit - position) / pitchRatio) + 1;
+	if (count > maxSamples) count = maxSamples;
+	while (count > 0 && position + (count - 1) * pitchRatio >= limit) count--;
+	return count;
+}
+
+// Samples p[0] and p[1] in one 32-bit load (p[0] in the low half on little-endian targets).
+static int tsf_sample_pair(const short* p)
+{
+	int pair;
+	TSF_MEMCPY(&pair, p, sizeof(pair));
+	return pair;
+}
+
+// Linear interpolation of count samples without boundary checks (see tsf_voice_fastcount).
+// Offsets within the block are computed in float relative to the integer start position,
+// which stays exact enough for the interpolation weight (error below 1e-4 for a 64-sample block).
+// Each lane gathers its two 16-bit neighbours as one pair and widens them with shifts;
+// the caller's gain applies the 1/32767 scale.
+static void tsf_voice_interpolate_block(const short* input, double position, double pitchRatio, int count, float* out)
+{
+	const short* base = input + (unsigned int)position;
+	float frac = (float)(position - (unsigned int)position), ratio = (float)pitchRatio;
+	int i = 0;
+	if (ratio == 1.0f && frac == 0.0f)
+	{
+		// Sample played at its recorded rate (e.g. a font baked for the output rate): plain widening copy
+#if defined(TSF_SIMD_NEON)
+		for (; i + 4 <= count; i += 4) vst1q_f32(out + i, vcvtq_f32_s32(vmovl_s16(vld1_s16(base + i))));
+#else
+		for (; i + 4 <= count; i += 4) _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i*)(base + i))), 16)));
+#endif
+		for (; i < count; i++) out[i] = base[i];
+		return;
+	}
+#if defined(TSF_SIMD_NEON)
+	static const float laneInit[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	float32x4_t lane = vld1q_f32(laneInit), fracv = vdupq_n_f32(frac), four = vdupq_n_f32(4.0f);
+	int idx[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t rel = vmlaq_n_f32(fracv, lane, ratio);
+		int32x4_t ri = vcvtq_s32_f32(rel), pairs = vdupq_n_s32(0);
+		float32x4_t alpha = vsubq_f32(rel, vcvtq_f32_s32(ri)), a, b;
+		vst1q_s32(idx, ri);
+		pairs = vsetq_lane_s32(tsf_sample_pair(base + idx[0]), pairs, 0);
+		pairs = vsetq_lane_s32(tsf_sample_pair(base + idx[1]), pairs, 1);
+		pairs = vsetq_lane_s32(tsf_sample_pair(base + idx[2]), pairs, 2);
+		pairs = vsetq_lane_s32(tsf_sample_pair(base + idx[3]), pairs, 3);
+		a = vcvtq_f32_s32(vshrq_n_s32(vshlq_n_s32(pairs, 16), 16));
+		b = vcvtq_f32_s32(vshrq_n_s32(pairs, 16));
+		vst1q_f32(out + i, vmlaq_f32(a, vsubq_f32(b, a), alpha));
+		lane = vaddq_f32(lane, four);
+	}
+#else
+	__m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), fracv = _mm_set1_ps(frac), ratiov = _mm_set1_ps(ratio), four = _mm_set1_ps(4.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 rel = _mm_add_ps(fracv, _mm_mul_ps(lane, ratiov));
+		__m128i ri = _mm_cvttps_epi32(rel);
+		__m128 alpha = _mm_sub_ps(rel, _mm_cvtepi32_ps(ri));
+		int i0 = _mm_cvtsi128_si32(ri), i1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(ri, 0x55));
+		int i2 = _mm_cvtsi128_si32(_mm_shuffle_epi32(ri, 0xAA)), i3 = _mm_cvtsi128_si32(_mm_shuffle_epi32(ri, 0xFF));
+		__m128i pairs = _mm_setr_epi32(tsf_sample_pair(base + i0), tsf_sample_pair(base + i1), tsf_sample_pair(base + i2), tsf_sample_pair(base + i3));
+		__m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16));
+		__m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(pairs, 16));
+		_mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), alpha)));
+		lane = _mm_add_ps(lane, four);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float rel = frac + (float)i * ratio;
+		int ri = (int)rel;
+		float a = base[ri], b = base[ri + 1];
+		out[i] = a + (b - a) * (rel - (float)ri);
+	}
+}
+
+// Nearest sample for each of count positions, same bounds as tsf_voice_interpolate_block.
+static void tsf_voice_nearest_block(const short* input, double position, double pitchRatio, int count, float* out)
+{
+	const short* base = input + (unsigned int)position;
+	float rel = (float)(position - (unsigned int)position) + 0.5f, ratio = (float)pitchRatio;
+	int i = 0;
+#if defined(TSF_SIMD_NEON)
+	static const float laneInit[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	float32x4_t lane = vld1q_f32(laneInit), relv = vdupq_n_f32(rel), four = vdupq_n_f32(4.0f);
+	int idx[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		float v[4];
+		vst1q_s32(idx, vcvtq_s32_f32(vmlaq_n_f32(relv, lane, ratio)));
+		v[0] = base[idx[0]], v[1] = base[idx[1]], v[2] = base[idx[2]], v[3] = base[idx[3]];
+		vst1q_f32(out + i, vld1q_f32(v));
+		lane = vaddq_f32(lane, four);
+	}
+#else
+	__m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), relv = _mm_set1_ps(rel), ratiov = _mm_set1_ps(ratio), four = _mm_set1_ps(4.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i ri = _mm_cvttps_epi32(_mm_add_ps(relv, _mm_mul_ps(lane, ratiov)));
+		int i0 = _mm_cvtsi128_si32(ri), i1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(ri, 0x55));
+		int i2 = _mm_cvtsi128_si32(_mm_shuffle_epi32(ri, 0xAA)), i3 = _mm_cvtsi128_si32(_mm_shuffle_epi32(ri, 0xFF));
+		_mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_setr_epi32(base[i0], base[i1], base[i2], base[i3])));
+		lane = _mm_add_ps(lane, four);
+	}
+#endif
+	for (; i < count; i++) out[i] = base[(int)(rel + (float)i * ratio)];
+}
+
+// Accumulate a mono block into stereo interleaved output with per-side gains.
+static void tsf_voice_mix_interleaved(float* output, const float* in, int count, float gainLeft, float gainRight)
+{
+	int i = 0;
+#if defined(TSF_SIMD_NEON)
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4x2_t o = vld2q_f32(output + i * 2);
+		float32x4_t val = vld1q_f32(in + i);
+		o.val[0] = vmlaq_n_f32(o.val[0], val, gainLeft);
+		o.val[1] = vmlaq_n_f32(o.val[1], val, gainRight);
+		vst2q_f32(output + i * 2, o);
+	}
+#else
+	__m128 gains = _mm_setr_ps(gainLeft, gainRight, gainLeft, gainRight);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 val = _mm_loadu_ps(in + i);
+		__m128 lo = _mm_unpacklo_ps(val, val), hi = _mm_unpackhi_ps(val, val);
+		_mm_storeu_ps(output + i * 2,     _mm_add_ps(_mm_loadu_ps(output + i * 2),     _mm_mul_ps(lo, gains)));
+		_mm_storeu_ps(output + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(output + i * 2 + 4), _mm_mul_ps(hi, gains)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		output[i * 2]     += in[i] * gainLeft;
+		output[i * 2 + 1] += in[i] * gainRight;
+	}
+}
+#endif
+
 static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, int numSamples)
 {
 	struct tsf_region* region = v->region;
-	float* input = f->fontSamples;
+	const short* input = f->fontSamples;
 	float* outL = outputBuffer;
 	float* outR = (f->outputmode == TSF_STEREO_UNWEAVED ? outL + numSamples : TSF_NULL);
 
@@ -1233,6 +1531,12 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 	double tmpSampleEndDbl = (double)region->end, tmpLoopEndDbl = (double)tmpLoopEnd + 1.0;
 	double tmpSourceSamplePosition = v->sourceSamplePosition;
 	struct tsf_voice_lowpass tmpLowpass = v->lowpass;
+	TSF_BOOL tmpNearest = f->nearestSample;
+	float tmpQuietFilterGain = f->quietFilterGain;
+#if defined(TSF_SIMD_NEON) || defined(TSF_SIMD_SSE2)
+	// Positions below this need neither a loop wrap nor an end check
+	double tmpFastLimitDbl = (isLooping && (double)tmpLoopEnd < tmpSampleEndDbl ? (double)tmpLoopEnd : tmpSampleEndDbl);
+#endif
 
 	TSF_BOOL dynamicLowpass = (region->modLfoToFilterFc || region->modEnvToFilterFc);
 	float tmpSampleRate = f->outSampleRate, tmpInitialFilterFc, tmpModLfoToFilterFc, tmpModEnvToFilterFc;
@@ -1256,6 +1560,7 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 	while (numSamples)
 	{
 		float gainMono, gainLeft, gainRight;
+		TSF_BOOL doLowpass;
 		int blockSamples = (numSamples > TSF_RENDER_EFFECTSAMPLEBLOCK ? TSF_RENDER_EFFECTSAMPLEBLOCK : numSamples);
 		numSamples -= blockSamples;
 
@@ -1273,7 +1578,18 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 		if (dynamicGain)
 			noteGain = tsf_decibelsToGain(v->noteGainDB + (v->modlfo.level * tmpModLfoToVolume));
 
-		gainMono = noteGain * v->ampenv.level;
+		// Interpolation and lowpass run on raw 16-bit values, the gain scales them to +-1
+		gainMono = noteGain * v->ampenv.level * (1.0f / 32767.0f);
+
+		// A voice this quiet is not worth filtering when render time is short
+		doLowpass = (tmpLowpass.active && noteGain * v->ampenv.level >= tmpQuietFilterGain);
+		if (doLowpass && tmpLowpass.skipped)
+		{
+			// The state is from before the skipped blocks: restart from the next sample instead
+			tsf_voice_lowpass_prime(&tmpLowpass, (tmpSourceSamplePosition < tmpSampleEndDbl ? input[(unsigned int)tmpSourceSamplePosition] : 0));
+			tmpLowpass.skipped = TSF_FALSE;
+		}
+		else if (!doLowpass && tmpLowpass.active) tmpLowpass.skipped = TSF_TRUE;
 
 		// Update EG.
 		tsf_voice_envelope_process(&v->ampenv, blockSamples, tmpSampleRate);
@@ -1287,15 +1603,38 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 		{
 			case TSF_STEREO_INTERLEAVED:
 				gainLeft = gainMono * v->panFactorLeft, gainRight = gainMono * v->panFactorRight;
+#if defined(TSF_SIMD_NEON) || defined(TSF_SIMD_SSE2)
+				{
+					// Vector path up to the next loop/sample end, the scalar loop below finishes the block
+					float blockBuf[TSF_RENDER_EFFECTSAMPLEBLOCK];
+					int fastSamples = tsf_voice_fastcount(tmpSourceSamplePosition, pitchRatio, tmpFastLimitDbl, blockSamples);
+					if (fastSamples)
+					{
+						int i;
+						if (tmpNearest) tsf_voice_nearest_block(input, tmpSourceSamplePosition, pitchRatio, fastSamples, blockBuf);
+						else tsf_voice_interpolate_block(input, tmpSourceSamplePosition, pitchRatio, fastSamples, blockBuf);
+						if (doLowpass)
+							for (i = 0; i < fastSamples; i++) blockBuf[i] = tsf_voice_lowpass_process(&tmpLowpass, blockBuf[i]);
+						tsf_voice_mix_interleaved(outL, blockBuf, fastSamples, gainLeft, gainRight);
+						outL += fastSamples * 2;
+						blockSamples -= fastSamples;
+						tmpSourceSamplePosition += fastSamples * pitchRatio;
+						// The last step can cross the loop end like one in the scalar loop does
+						if (tmpSourceSamplePosition >= tmpLoopEndDbl && isLooping) tmpSourceSamplePosition -= (tmpLoopEnd - tmpLoopStart + 1.0);
+					}
+				}
+#endif
 				while (blockSamples-- && tmpSourceSamplePosition < tmpSampleEndDbl)
 				{
 					unsigned int pos = (unsigned int)tmpSourceSamplePosition, nextPos = (pos >= tmpLoopEnd && isLooping ? tmpLoopStart : pos + 1);
 
-					// Simple linear interpolation.
-					float alpha = (float)(tmpSourceSamplePosition - pos), val = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
+					// Simple linear interpolation, or the nearest sample.
+					float alpha = (float)(tmpSourceSamplePosition - pos), val;
+					if (tmpNearest) val = input[alpha < 0.5f ? pos : nextPos];
+					else val = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
 
 					// Low-pass filter.
-					if (tmpLowpass.active) val = tsf_voice_lowpass_process(&tmpLowpass, val);
+					if (doLowpass) val = tsf_voice_lowpass_process(&tmpLowpass, val);
 
 					*outL++ += val * gainLeft;
 					*outL++ += val * gainRight;
@@ -1312,11 +1651,13 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 				{
 					unsigned int pos = (unsigned int)tmpSourceSamplePosition, nextPos = (pos >= tmpLoopEnd && isLooping ? tmpLoopStart : pos + 1);
 
-					// Simple linear interpolation.
-					float alpha = (float)(tmpSourceSamplePosition - pos), val = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
+					// Simple linear interpolation, or the nearest sample.
+					float alpha = (float)(tmpSourceSamplePosition - pos), val;
+					if (tmpNearest) val = input[alpha < 0.5f ? pos : nextPos];
+					else val = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
 
 					// Low-pass filter.
-					if (tmpLowpass.active) val = tsf_voice_lowpass_process(&tmpLowpass, val);
+					if (doLowpass) val = tsf_voice_lowpass_process(&tmpLowpass, val);
 
 					*outL++ += val * gainLeft;
 					*outR++ += val * gainRight;
@@ -1332,11 +1673,13 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 				{
 					unsigned int pos = (unsigned int)tmpSourceSamplePosition, nextPos = (pos >= tmpLoopEnd && isLooping ? tmpLoopStart : pos + 1);
 
-					// Simple linear interpolation.
-					float alpha = (float)(tmpSourceSamplePosition - pos), val = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
+					// Simple linear interpolation, or the nearest sample.
+					float alpha = (float)(tmpSourceSamplePosition - pos), val;
+					if (tmpNearest) val = input[alpha < 0.5f ? pos : nextPos];
+					else val = (input[pos] * (1.0f - alpha) + input[nextPos] * alpha);
 
 					// Low-pass filter.
-					if (tmpLowpass.active) val = tsf_voice_lowpass_process(&tmpLowpass, val);
+					if (doLowpass) val = tsf_voice_lowpass_process(&tmpLowpass, val);
 
 					*outL++ += val * gainMono;
 
@@ -1358,6 +1701,139 @@ static void tsf_voice_render(tsf* f, struct tsf_voice* v, float* outputBuffer, i
 	if (tmpLowpass.active || dynamicLowpass) v->lowpass = tmpLowpass;
 }
 
+// Index every preset's regions by key, so note on only looks at the regions that can play
+static int tsf_index_presets(tsf* f)
+{
+	int i, key;
+	for (i = 0; i != f->presetNum; i++)
+	{
+		struct tsf_preset* preset = &f->presets[i];
+		const struct tsf_region *region, *regionEnd = preset->regions + preset->regionNum;
+		int *offsets, *indices;
+		preset->keyRegions = (int*)TSF_MALLOC(129 * sizeof(int));
+		if (!preset->keyRegions) return 0;
+		offsets = preset->keyRegions;
+		TSF_MEMSET(offsets, 0, 129 * sizeof(int));
+		for (region = preset->regions; region != regionEnd; region++)
+			for (key = region->lokey; key <= region->hikey && key < 128; key++) offsets[key + 1]++;
+		for (key = 0; key < 128; key++) offsets[key + 1] += offsets[key];
+		offsets = (int*)TSF_REALLOC(preset->keyRegions, (129 + offsets[128]) * sizeof(int));
+		if (!offsets) return 0;
+		preset->keyRegions = offsets;
+		indices = offsets + 129;
+		// offsets[k] serves as key k's fill position, which leaves it at the start of key k + 1
+		for (region = preset->regions; region != regionEnd; region++)
+			for (key = region->lokey; key <= region->hikey && key < 128; key++) indices[offsets[key]++] = (int)(region - preset->regions);
+		for (key = 128; key > 0; key--) offsets[key] = offsets[key - 1];
+		offsets[0] = 0;
+	}
+	return 1;
+}
+
+// Advance a voice like tsf_voice_render does, without reading samples or filtering
+static void tsf_voice_skip(tsf* f, struct tsf_voice* v, int numSamples)
+{
+	struct tsf_region* region = v->region;
+	TSF_BOOL updateModEnv = (region->modEnvToPitch || region->modEnvToFilterFc);
+	TSF_BOOL updateModLFO = (v->modlfo.delta && (region->modLfoToPitch || region->modLfoToFilterFc || region->modLfoToVolume));
+	TSF_BOOL updateVibLFO = (v->viblfo.delta && (region->vibLfoToPitch));
+	TSF_BOOL dynamicPitchRatio = (region->modLfoToPitch || region->modEnvToPitch || region->vibLfoToPitch);
+	double sampleEndDbl = (double)region->end, loopEndDbl = (double)v->loopEnd + 1.0, loopLength = (double)(v->loopEnd - v->loopStart) + 1.0;
+	TSF_BOOL isLooping = (v->loopStart < v->loopEnd && loopEndDbl <= sampleEndDbl);
+	double position = v->sourceSamplePosition, pitchRatio = tsf_timecents2Secsd(v->pitchInputTimecents) * v->pitchOutputFactor;
+	float outSampleRate = f->outSampleRate;
+
+	while (numSamples)
+	{
+		int blockSamples = (numSamples > TSF_RENDER_EFFECTSAMPLEBLOCK ? TSF_RENDER_EFFECTSAMPLEBLOCK : numSamples);
+		numSamples -= blockSamples;
+
+		if (dynamicPitchRatio)
+			pitchRatio = tsf_timecents2Secsd(v->pitchInputTimecents + (v->modlfo.level * region->modLfoToPitch + v->viblfo.level * region->vibLfoToPitch + v->modenv.level * region->modEnvToPitch)) * v->pitchOutputFactor;
+
+		tsf_voice_envelope_process(&v->ampenv, blockSamples, outSampleRate);
+		if (updateModEnv) tsf_voice_envelope_process(&v->modenv, blockSamples, outSampleRate);
+		if (updateModLFO) tsf_voice_lfo_process(&v->modlfo, blockSamples);
+		if (updateVibLFO) tsf_voice_lfo_process(&v->viblfo, blockSamples);
+
+		// The render loop wraps at the loop end as often as it gets there, unless the sample ends first
+		position += pitchRatio * blockSamples;
+		if (isLooping && position >= loopEndDbl)
+			position -= loopLength * (double)(unsigned int)((position - loopEndDbl) / loopLength + 1.0);
+
+		if (position >= sampleEndDbl || v->ampenv.segment == TSF_SEGMENT_DONE)
+		{
+			tsf_voice_kill(v);
+			return;
+		}
+	}
+	v->sourceSamplePosition = position;
+}
+
+// Rest of a baked font after its magic and version (see struct tsf_baked_header)
+static tsf* tsf_load_baked(struct tsf_stream* stream, tsf_u32 version)
+{
+	tsf* res;
+	tsf_u32 counts[4], regionTotal = 0, bytes; // regionSize, presetNum, regionNum, sampleNum
+	int i;
+	if (version != TSF_BAKED_VERSION || stream->read(stream->data, counts, sizeof(counts)) != (int)sizeof(counts)) return TSF_NULL;
+	if (counts[0] != sizeof(struct tsf_region) || !counts[1] || counts[1] > 0xFFFF || counts[2] > 0xFFFFF || counts[3] < 2 || counts[3] > 0x7FFFFFFF / sizeof(short)) return TSF_NULL;
+	res = (tsf*)TSF_MALLOC(sizeof(tsf));
+	if (!res) return TSF_NULL;
+	TSF_MEMSET(res, 0, sizeof(tsf));
+	res->outSampleRate = 44100.0f;
+	res->presets = (struct tsf_preset*)TSF_MALLOC(counts[1] * sizeof(struct tsf_preset));
+	if (!res->presets) goto error;
+	TSF_MEMSET(res->presets, 0, counts[1] * sizeof(struct tsf_preset));
+	res->presetNum = (int)counts[1];
+
+	for (i = 0; i != res->presetNum; i++)
+	{
+		struct tsf_preset* preset = &res->presets[i];
+		struct tsf_baked_preset record;
+		if (stream->read(stream->data, &record, sizeof(record)) != (int)sizeof(record) || record.regionNum > counts[2] - regionTotal) goto error;
+		TSF_MEMCPY(preset->presetName, record.presetName, sizeof(preset->presetName));
+		preset->presetName[sizeof(preset->presetName) - 1] = '\0';
+		preset->preset = record.preset;
+		preset->bank = record.bank;
+		preset->regionNum = (int)record.regionNum;
+		regionTotal += record.regionNum;
+	}
+	if (regionTotal != counts[2]) goto error;
+
+	for (i = 0; i != res->presetNum; i++)
+	{
+		struct tsf_preset* preset = &res->presets[i];
+		const struct tsf_region *region, *regionEnd;
+		if (!preset->regionNum) continue;
+		bytes = preset->regionNum * (tsf_u32)sizeof(struct tsf_region);
+		if (!(preset->regions = (struct tsf_region*)TSF_MALLOC(bytes)) || stream->read(stream->data, preset->regions, bytes) != (int)bytes) goto error;
+		// Rendering reads one sample past the end, and the font may be hostile
+		for (region = preset->regions, regionEnd = region + preset->regionNum; region != regionEnd; region++)
+			if (region->offset >= counts[3] || region->end >= counts[3] || region->loop_start >= counts[3] || region->loop_end >= counts[3]) goto error;
+	}
+
+	bytes = counts[3] * (tsf_u32)sizeof(short);
+	if (stream->map)
+	{
+		// Use the samples in place when they are aligned, copy them otherwise
+		const void* mapped = stream->map(stream->data, bytes);
+		if (!mapped) goto error;
+		if (!((size_t)mapped & 1)) res->fontSamples = (const short*)mapped;
+		else if (!(res->fontSamplesAlloc = TSF_MALLOC(bytes))) goto error;
+		else TSF_MEMCPY(res->fontSamplesAlloc, mapped, bytes);
+	}
+	else if (!(res->fontSamplesAlloc = TSF_MALLOC(bytes)) || stream->read(stream->data, res->fontSamplesAlloc, bytes) != (int)bytes) goto error;
+	if (!res->fontSamples) res->fontSamples = (const short*)res->fontSamplesAlloc;
+	res->fontSampleNum = counts[3];
+	if (!tsf_index_presets(res)) goto error;
+	return res;
+
+	error:
+	tsf_close(res);
+	return TSF_NULL;
+}
+
 TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 {
 	tsf* res = TSF_NULL;
@@ -1366,9 +1842,12 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 	struct tsf_hydra hydra;
 	void* rawBuffer = TSF_NULL;
 	float* floatBuffer = TSF_NULL;
+	const short* mappedSamples = TSF_NULL;
 	tsf_u32 smplCount = 0;
 
-	if (!tsf_riffchunk_read(TSF_NULL, &chunkHead, stream) || !TSF_FourCCEquals(chunkHead.id, "sfbk"))
+	if (!tsf_riffchunk_read(TSF_NULL, &chunkHead, stream)) return res;
+	if (TSF_FourCCEquals(chunkHead.id, "TSFB")) return tsf_load_baked(stream, chunkHead.size);
+	if (!TSF_FourCCEquals(chunkHead.id, "sfbk"))
 	{
 		//if (e) *e = TSF_INVALID_NOSF2HEADER;
 		return res;
@@ -1412,8 +1891,21 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 						#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
 						|| TSF_FourCCEquals(chunk.id, "smpo")
 						#endif
-					) && !rawBuffer && !floatBuffer && chunk.size >= sizeof(short))
+					) && !rawBuffer && !floatBuffer && !mappedSamples && chunk.size >= sizeof(short))
 				{
+					#ifndef STB_VORBIS_INCLUDE_STB_VORBIS_H
+					if (stream->map)
+					{
+						// Use 16-bit samples in place when they are aligned, copy them otherwise
+						const void* mapped = stream->map(stream->data, chunk.size);
+						if (!mapped) goto out_of_memory;
+						smplCount = chunk.size / (unsigned int)sizeof(short);
+						if (!((size_t)mapped & 1)) mappedSamples = (const short*)mapped;
+						else if (!(rawBuffer = TSF_MALLOC(chunk.size))) goto out_of_memory;
+						else TSF_MEMCPY(rawBuffer, mapped, chunk.size);
+					}
+					else
+					#endif
 					if (!tsf_load_samples(&rawBuffer, &floatBuffer, &smplCount, &chunk, stream)) goto out_of_memory;
 				}
 				else stream->skip(stream->data, chunk.size);
@@ -1425,7 +1917,7 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 	{
 		//if (e) *e = TSF_INVALID_INCOMPLETE;
 	}
-	else if (!rawBuffer && !floatBuffer)
+	else if (!rawBuffer && !floatBuffer && !mappedSamples)
 	{
 		//if (e) *e = TSF_INVALID_NOSAMPLEDATA;
 	}
@@ -1433,13 +1925,19 @@ TSFDEF tsf* tsf_load(struct tsf_stream* stream)
 	{
 		#ifdef STB_VORBIS_INCLUDE_STB_VORBIS_H
 		if (!floatBuffer && !tsf_decode_sf3_samples(rawBuffer, &floatBuffer, &smplCount, &hydra)) goto out_of_memory;
+		TSF_FREE(rawBuffer);
+		rawBuffer = tsf_samples_to_short(floatBuffer, smplCount);
+		floatBuffer = TSF_NULL;
 		#endif
 		res = (tsf*)TSF_MALLOC(sizeof(tsf));
 		if (res) TSF_MEMSET(res, 0, sizeof(tsf));
 		if (!res || !tsf_load_presets(res, &hydra, smplCount)) goto out_of_memory;
 		res->outSampleRate = 44100.0f;
-		res->fontSamples = floatBuffer;
-		floatBuffer = TSF_NULL; // don't free below
+		res->fontSamples = (mappedSamples ? mappedSamples : (const short*)rawBuffer);
+		res->fontSamplesAlloc = rawBuffer;
+		res->fontSampleNum = smplCount;
+		rawBuffer = TSF_NULL; // don't free below
+		if (!tsf_index_presets(res)) { tsf_close(res); res = TSF_NULL; }
 	}
 	if (0)
 	{
@@ -1470,24 +1968,65 @@ TSFDEF tsf* tsf_copy(tsf* f)
 	TSF_MEMCPY(res, f, sizeof(tsf));
 	res->voices = TSF_NULL;
 	res->voiceNum = 0;
+	res->maxVoiceNum = 0;
+	res->stolenVoiceNum = 0;
+	res->peakVoiceNum = 0;
+	res->voiceLimit = 0;
+	res->quietFilterGain = 0.0f;
+	res->nearestSample = TSF_FALSE;
+	res->activeVoices = TSF_NULL;
+	res->activeVoiceNum = 0;
 	res->channels = TSF_NULL;
-	(*res->refCount)++;
+	TSF_REFCOUNT_ADD(res->refCount, 1);
+	return res;
+}
+
+TSFDEF tsf* tsf_copy_playing(tsf* f)
+{
+	tsf* res = tsf_copy(f);
+	if (!res) return TSF_NULL;
+	if (f->voiceNum)
+	{
+		res->voices = (struct tsf_voice*)TSF_MALLOC(f->voiceNum * sizeof(struct tsf_voice));
+		res->activeVoices = (int*)TSF_MALLOC(f->voiceNum * sizeof(int));
+		if (!res->voices || !res->activeVoices) goto error;
+		TSF_MEMCPY(res->voices, f->voices, f->voiceNum * sizeof(struct tsf_voice));
+		TSF_MEMCPY(res->activeVoices, f->activeVoices, f->activeVoiceNum * sizeof(int));
+		res->voiceNum = f->voiceNum;
+		res->activeVoiceNum = f->activeVoiceNum;
+		res->maxVoiceNum = f->maxVoiceNum;
+	}
+	if (f->channels)
+	{
+		unsigned int size = sizeof(struct tsf_channels) + sizeof(struct tsf_channel) * (f->channels->channelNum - 1);
+		res->channels = (struct tsf_channels*)TSF_MALLOC(size);
+		if (!res->channels) goto error;
+		TSF_MEMCPY(res->channels, f->channels, size);
+	}
+	res->voiceLimit = f->voiceLimit;
+	res->quietFilterGain = f->quietFilterGain;
+	res->nearestSample = f->nearestSample;
 	return res;
+
+	error:
+	tsf_close(res);
+	return TSF_NULL;
 }
 
 TSFDEF void tsf_close(tsf* f)
 {
 	if (!f) return;
-	if (!f->refCount || !--(*f->refCount))
+	if (!f->refCount || !TSF_REFCOUNT_ADD(f->refCount, -1))
 	{
 		struct tsf_preset *preset = f->presets, *presetEnd = preset + f->presetNum;
-		for (; preset != presetEnd; preset++) TSF_FREE(preset->regions);
+		for (; preset != presetEnd; preset++) { TSF_FREE(preset->regions); TSF_FREE(preset->keyRegions); }
 		TSF_FREE(f->presets);
-		TSF_FREE(f->fontSamples);
+		TSF_FREE(f->fontSamplesAlloc);
 		TSF_FREE(f->refCount);
 	}
 	TSF_FREE(f->channels);
 	TSF_FREE(f->voices);
+	TSF_FREE(f->activeVoices);
 	TSF_FREE(f);
 }
 
@@ -1525,6 +2064,38 @@ TSFDEF const char* tsf_bank_get_presetname(const tsf* f, int bank, int preset_nu
 	return tsf_get_presetname(f, tsf_get_presetindex(f, bank, preset_number));
 }
 
+TSFDEF int tsf_get_presetbank(const tsf* f, int preset)
+{
+	return (preset < 0 || preset >= f->presetNum ? -1 : f->presets[preset].bank);
+}
+
+TSFDEF int tsf_get_presetnumber(const tsf* f, int preset)
+{
+	return (preset < 0 || preset >= f->presetNum ? -1 : f->presets[preset].preset);
+}
+
+TSFDEF const short* tsf_get_sampledata(const tsf* f, unsigned int* sample_count)
+{
+	if (sample_count) *sample_count = f->fontSampleNum;
+	return f->fontSamples;
+}
+
+TSFDEF int tsf_get_preset_samplespans(const tsf* f, int preset, unsigned int* spans, int max_spans)
+{
+	const struct tsf_region *region, *regionEnd;
+	int n = 0;
+	if (preset < 0 || preset >= f->presetNum) return 0;
+	for (region = f->presets[preset].regions, regionEnd = region + f->presets[preset].regionNum; region != regionEnd; region++, n++)
+	{
+		// Rendering reads up to one sample past the current position
+		unsigned int last = (region->end > region->loop_end ? region->end : region->loop_end) + 1;
+		if (n >= max_spans) continue;
+		spans[n * 2] = region->offset;
+		spans[n * 2 + 1] = (last < f->fontSampleNum ? last : f->fontSampleNum);
+	}
+	return n;
+}
+
 TSFDEF void tsf_set_output(tsf* f, enum TSFOutputMode outputmode, int samplerate, float global_gain_db)
 {
 	f->outputmode = outputmode;
@@ -1537,34 +2108,117 @@ TSFDEF void tsf_set_volume(tsf* f, float global_volume)
 	f->globalGainDB = (global_volume == 1.0f ? 0 : -tsf_gainToDecibels(1.0f / global_volume));
 }
 
+// Keep the active voice list able to hold every voice
+static TSF_BOOL tsf_reserve_active_voices(tsf* f)
+{
+	int* newActiveVoices = (int*)TSF_REALLOC(f->activeVoices, f->voiceNum * sizeof(int));
+	if (!newActiveVoices) return TSF_FALSE;
+	f->activeVoices = newActiveVoices;
+	return TSF_TRUE;
+}
+
 TSFDEF int tsf_set_max_voices(tsf* f, int max_voices)
 {
-	int i = f->voiceNum;
-	int newVoiceNum = (f->voiceNum > max_voices ? f->voiceNum : max_voices);
-	struct tsf_voice *newVoices = (struct tsf_voice*)TSF_REALLOC(f->voices, newVoiceNum * sizeof(struct tsf_voice));
+	int i = f->voiceNum, kept = 0;
+	struct tsf_voice *newVoices;
+	if (max_voices < 1) max_voices = 1;
+	if (max_voices < f->voiceNum)
+	{
+		// Drop the voices above the new maximum from the active list before they go
+		for (i = 0; i < f->activeVoiceNum; i++)
+			if (f->activeVoices[i] < max_voices) f->activeVoices[kept++] = f->activeVoices[i];
+		f->activeVoiceNum = kept;
+		i = max_voices;
+	}
+	newVoices = (struct tsf_voice*)TSF_REALLOC(f->voices, max_voices * sizeof(struct tsf_voice));
 	if (!newVoices) return 0;
 	f->voices = newVoices;
-	f->voiceNum = f->maxVoiceNum = newVoiceNum;
+	f->voiceNum = f->maxVoiceNum = max_voices;
 	for (; i < max_voices; i++)
-		f->voices[i].playingPreset = -1;
-	return 1;
+		f->voices[i].playingPreset = -1, f->voices[i].isListed = TSF_FALSE;
+	return tsf_reserve_active_voices(f);
+}
+
+TSFDEF int tsf_get_stolen_voice_count(tsf* f, int flag_reset)
+{
+	int count = f->stolenVoiceNum;
+	if (flag_reset) f->stolenVoiceNum = 0;
+	return count;
+}
+
+TSFDEF int tsf_get_peak_voice_count(tsf* f, int flag_reset)
+{
+	int count = f->peakVoiceNum;
+	if (flag_reset) f->peakVoiceNum = f->activeVoiceNum;
+	return count;
+}
+
+TSFDEF void tsf_set_render_quality(tsf* f, int voice_limit, float quiet_filter_gain, int flag_nearest)
+{
+	f->voiceLimit = (voice_limit > 0 ? voice_limit : 0);
+	f->quietFilterGain = (quiet_filter_gain > 0.0f ? quiet_filter_gain : 0.0f);
+	f->nearestSample = (flag_nearest ? TSF_TRUE : TSF_FALSE);
+}
+
+TSFDEF int tsf_cull_released_voices(tsf* f, float min_gain)
+{
+	int i, count = 0;
+	for (i = 0; i < f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->activeVoices[i]];
+		if (v->playingPreset == -1 || v->ampenv.segment != TSF_SEGMENT_RELEASE) continue;
+		if (v->ampenv.level * tsf_decibelsToGain(v->noteGainDB) >= min_gain) continue;
+		tsf_voice_kill(v);
+		count++;
+	}
+	return count;
+}
+
+// Voice to take over when the pool is full: the quietest one in its release, else the
+// oldest one on the same key, else the oldest one. Voices started by the current note
+// on (playIndex) are never taken, so a layered note does not cut off its own layers.
+static struct tsf_voice* tsf_voice_steal(tsf* f, int key, unsigned int playIndex)
+{
+	struct tsf_voice *v, *vEnd = f->voices + f->voiceNum, *released = TSF_NULL, *sameKey = TSF_NULL, *oldest = TSF_NULL;
+	unsigned int sameKeyAge = 0, oldestAge = 0;
+	for (v = f->voices; v != vEnd; v++)
+	{
+		unsigned int age = playIndex - v->playIndex;
+		if (v->playingPreset == -1 || !age) continue;
+		if (v->ampenv.segment == TSF_SEGMENT_RELEASE)
+		{
+			if (!released || v->ampenv.level < released->ampenv.level) released = v;
+		}
+		else if (v->playingKey == key)
+		{
+			if (age > sameKeyAge) sameKeyAge = age, sameKey = v;
+		}
+		if (age > oldestAge) oldestAge = age, oldest = v;
+	}
+	return (released ? released : (sameKey ? sameKey : oldest));
 }
 
 TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
 {
 	short midiVelocity = (short)(vel * 127);
 	unsigned int voicePlayIndex;
-	struct tsf_region *region, *regionEnd;
+	struct tsf_preset* preset;
+	const int *regionIndex, *regionIndexEnd;
 
 	if (preset_index < 0 || preset_index >= f->presetNum) return 1;
 	if (vel <= 0.0f) { tsf_note_off(f, preset_index, key); return 1; }
+	if (key < 0 || key > 127) return 1;
 
-	// Play all matching regions.
+	// Play all matching regions, looking only at the ones covering the key.
 	voicePlayIndex = f->voicePlayIndex++;
-	for (region = f->presets[preset_index].regions, regionEnd = region + f->presets[preset_index].regionNum; region != regionEnd; region++)
+	preset = &f->presets[preset_index];
+	regionIndex = preset->keyRegions + 129 + preset->keyRegions[key];
+	regionIndexEnd = preset->keyRegions + 129 + preset->keyRegions[key + 1];
+	for (; regionIndex != regionIndexEnd; regionIndex++)
 	{
+		struct tsf_region* region = &preset->regions[*regionIndex];
 		struct tsf_voice *voice, *v, *vEnd; TSF_BOOL doLoop; float lowpassFilterQDB, lowpassFc;
-		if (key < region->lokey || key > region->hikey || midiVelocity < region->lovel || midiVelocity > region->hivel) continue;
+		if (midiVelocity < region->lovel || midiVelocity > region->hivel) continue;
 
 		voice = TSF_NULL, v = f->voices, vEnd = v + f->voiceNum;
 		if (region->group)
@@ -1575,28 +2229,27 @@ TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
 		}
 		else for (; v != vEnd; v++) if (v->playingPreset == -1) { voice = v; break; }
 
+		if (voice && f->voiceLimit && tsf_active_voice_count(f) >= f->voiceLimit)
+		{
+			// Over the reduced limit, take a voice over even though free ones remain
+			struct tsf_voice* stolen = tsf_voice_steal(f, key, voicePlayIndex);
+			if (stolen)
+			{
+				tsf_voice_kill(stolen);
+				f->stolenVoiceNum++;
+				voice = stolen;
+			}
+		}
+
 		if (!voice)
 		{
 			if (f->maxVoiceNum)
 			{
-				// Voices have been pre-allocated and limited to a maximum, try to kill a voice off in its release envelope
-				int bestKillReleaseSamplePos = -999999999;
-				for (v = f->voices; v != vEnd; v++)
-				{
-					if (v->ampenv.segment == TSF_SEGMENT_RELEASE)
-					{
-						// We're looking for the voice furthest into its release
-						int releaseSamplesDone = tsf_voice_envelope_release_samples(&v->ampenv, f->outSampleRate) - v->ampenv.samplesUntilNextSegment;
-						if (releaseSamplesDone > bestKillReleaseSamplePos)
-						{
-							bestKillReleaseSamplePos = releaseSamplesDone;
-							voice = v;
-						}
-					}
-				}
-				if (!voice)
+				// Voices have been pre-allocated and limited to a maximum, take one over
+				if (!(voice = tsf_voice_steal(f, key, voicePlayIndex)))
 					continue;
 				tsf_voice_kill(voice);
+				f->stolenVoiceNum++;
 			}
 			else
 			{
@@ -1606,11 +2259,19 @@ TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
 				newVoices = (struct tsf_voice*)TSF_REALLOC(f->voices, f->voiceNum * sizeof(struct tsf_voice));
 				if (!newVoices) return 0;
 				f->voices = newVoices;
+				if (!tsf_reserve_active_voices(f)) return 0;
 				voice = &f->voices[f->voiceNum - 4];
 				voice[1].playingPreset = voice[2].playingPreset = voice[3].playingPreset = -1;
+				voice[0].isListed = voice[1].isListed = voice[2].isListed = voice[3].isListed = TSF_FALSE;
 			}
 		}
 
+		if (!voice->isListed)
+		{
+			voice->isListed = TSF_TRUE;
+			f->activeVoices[f->activeVoiceNum++] = (int)(voice - f->voices);
+			if (f->activeVoiceNum > f->peakVoiceNum) f->peakVoiceNum = f->activeVoiceNum;
+		}
 		voice->region = region;
 		voice->playingPreset = preset_index;
 		voice->playingKey = key;
@@ -1647,6 +2308,7 @@ TSFDEF int tsf_note_on(tsf* f, int preset_index, int key, float vel)
 		lowpassFilterQDB = region->initialFilterQ / 10.0f;
 		voice->lowpass.QInv = 1.0 / TSF_POW(10.0, (lowpassFilterQDB / 20.0));
 		voice->lowpass.z1 = voice->lowpass.z2 = 0;
+		voice->lowpass.skipped = TSF_FALSE;
 		voice->lowpass.active = (lowpassFc < 0.499f);
 		if (voice->lowpass.active) tsf_voice_lowpass_setup(&voice->lowpass, lowpassFc);
 
@@ -1694,16 +2356,19 @@ TSFDEF int tsf_bank_note_off(tsf* f, int bank, int preset_number, int key)
 
 TSFDEF void tsf_note_off_all(tsf* f)
 {
-	struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
-	for (; v != vEnd; v++) if (v->playingPreset != -1 && v->ampenv.segment < TSF_SEGMENT_RELEASE)
-		tsf_voice_end(f, v);
+	int i;
+	for (i = 0; i < f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->activeVoices[i]];
+		if (v->playingPreset != -1 && v->ampenv.segment < TSF_SEGMENT_RELEASE)
+			tsf_voice_end(f, v);
+	}
 }
 
 TSFDEF int tsf_active_voice_count(tsf* f)
 {
-	int count = 0;
-	struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
-	for (; v != vEnd; v++) if (v->playingPreset != -1) count++;
+	int count = 0, i;
+	for (i = 0; i < f->activeVoiceNum; i++) if (f->voices[f->activeVoices[i]].playingPreset != -1) count++;
 	return count;
 }
 
@@ -1737,11 +2402,59 @@ TSFDEF void tsf_render_short(tsf* f, short* buffer, int samples, int flag_mixing
 
 TSFDEF void tsf_render_float(tsf* f, float* buffer, int samples, int flag_mixing)
 {
-	struct tsf_voice *v = f->voices, *vEnd = v + f->voiceNum;
+	int i, kept = 0;
 	if (!flag_mixing) TSF_MEMSET(buffer, 0, (f->outputmode == TSF_MONO ? 1 : 2) * sizeof(float) * samples);
-	for (; v != vEnd; v++)
-		if (v->playingPreset != -1)
-			tsf_voice_render(f, v, buffer, samples);
+
+	// Render only listed voices, and drop the ones that finished (here or since the last call)
+	for (i = 0; i < f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->activeVoices[i]];
+		if (v->playingPreset != -1) tsf_voice_render(f, v, buffer, samples);
+		if (v->playingPreset != -1) f->activeVoices[kept++] = f->activeVoices[i];
+		else v->isListed = TSF_FALSE;
+	}
+	f->activeVoiceNum = kept;
+}
+
+TSFDEF void tsf_render_skip(tsf* f, int samples)
+{
+	int i, kept = 0;
+	for (i = 0; i < f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->activeVoices[i]];
+		if (v->playingPreset != -1) tsf_voice_skip(f, v, samples);
+		if (v->playingPreset != -1) f->activeVoices[kept++] = f->activeVoices[i];
+		else v->isListed = TSF_FALSE;
+	}
+	f->activeVoiceNum = kept;
+}
+
+TSFDEF int tsf_render_voice_slots(tsf* f)
+{
+	return f->activeVoiceNum;
+}
+
+TSFDEF void tsf_render_float_voices(tsf* f, float* buffer, int samples, int begin, int end)
+{
+	int i;
+	if (end > f->activeVoiceNum) end = f->activeVoiceNum;
+	for (i = begin; i < end; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->activeVoices[i]];
+		if (v->playingPreset != -1) tsf_voice_render(f, v, buffer, samples);
+	}
+}
+
+TSFDEF void tsf_render_compact(tsf* f)
+{
+	int i, kept = 0;
+	for (i = 0; i < f->activeVoiceNum; i++)
+	{
+		struct tsf_voice* v = &f->voices[f->activeVoices[i]];
+		if (v->playingPreset != -1) f->activeVoices[kept++] = f->activeVoices[i];
+		else v->isListed = TSF_FALSE;
+	}
+	f->activeVoiceNum = kept;
 }
 
 static void tsf_channel_setup_voice(tsf* f, struct tsf_voice* v)
@@ -0,0 +1,18 @@
+// Host stand-in for the NDK's <android/log.h>, so native sources that only
+// log can be built into the host tools. Messages go to stderr.
+#pragma once
+
+#include <cstdio>
+
+enum {
+    ANDROID_LOG_VERBOSE = 2,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR
+};
+
+#define __android_log_print(prio, tag, ...) \
+    ((prio) >= ANDROID_LOG_WARN                 \
+         ? (fprintf(stderr, "%s: ", tag), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr)) \
+         : 0)
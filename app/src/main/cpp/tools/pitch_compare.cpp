@@ -0,0 +1,175 @@
+// Fixed-point vs float pitch detector comparison.
+//
+// Runs the Q15 detector (pitch_detector_fixed.cpp) and the aubio float
+// detector the other ABIs use over a synthetic corpus and checks that they
+// name the same MIDI note for every buffer: sines and harmonic tones across
+// the piano's range, detuned within the note, at several levels over low
+// noise, plus buffers under the silence gate. The Q15 detector gets the
+// 16-bit PCM the app captures on fixed-point ABIs; the float detector gets
+// the same samples as floats.
+//
+// Built with the NDK toolchain for an ARM ABI, the Q15 detector takes its
+// NEON path; run it there (adb push, adb shell) before enabling an ABI in
+// FIXED_POINT_PITCH_ABIS. A host build checks the scalar path.
+//
+//   -v  print every buffer, not only mismatches
+//
+// Usage: pitch_compare [-v]
+// Exits 1 if any buffer gets a different MIDI note.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "../pitch_detector.h"
+
+namespace {
+
+using musicsheetflow::PitchDetector;
+using musicsheetflow::PitchResult;
+
+// Samples per detection, as audio_engine.cpp analyzes the capture
+constexpr int BUFFER_SIZE = 2048;
+
+constexpr int SAMPLE_RATES[] = {44100, 48000};
+
+// Lowest note whose period fits the YIN window at these rates, up to C7
+constexpr int LOWEST_NOTE = 33;
+constexpr int HIGHEST_NOTE = 96;
+
+// Detuning in cents, kept clear of the +-50 cent boundary between notes
+constexpr int DETUNE_CENTS[] = {-30, 0, 30};
+
+// Peak levels in dBFS, all well above the default -50 dB silence gate
+constexpr float LEVELS_DB[] = {-6.0f, -20.0f, -35.0f};
+
+// Peak level of the white noise under every tone, in dBFS
+constexpr float NOISE_DB = -70.0f;
+
+// Levels below the silence gate, where neither detector may name a note
+constexpr float SILENT_LEVELS_DB[] = {-65.0f, -90.0f};
+
+enum class Timbre {
+    Sine,
+    Harmonic  // Six partials falling as 1/k, as a plucked string roughly does
+};
+
+struct Case {
+    int sampleRate;
+    int note;
+    int detuneCents;
+    float levelDb;
+    Timbre timbre;
+};
+
+float dbToGain(float db) {
+    return std::pow(10.0f, db / 20.0f);
+}
+
+// Tone plus noise as 16-bit PCM; the noise generator is seeded per case so
+// every run sees the same corpus
+void synthesize(const Case& c, uint32_t seed, std::vector<int16_t>& pcm) {
+    double freq = 440.0 * std::pow(2.0, (c.note - 69 + c.detuneCents / 100.0) / 12.0);
+    int partials = c.timbre == Timbre::Sine ? 1 : 6;
+    double norm = 0.0;
+    for (int k = 1; k <= partials; ++k) {
+        norm += 1.0 / k;
+    }
+    double gain = dbToGain(c.levelDb) / norm;
+    double noise = dbToGain(NOISE_DB);
+    double phase = (seed % 628) / 100.0;
+
+    for (int i = 0; i < BUFFER_SIZE; ++i) {
+        double t = static_cast<double>(i) / c.sampleRate;
+        double sample = 0.0;
+        for (int k = 1; k <= partials; ++k) {
+            if (freq * k >= c.sampleRate / 2.0) {
+                break;
+            }
+            sample += std::sin(2.0 * M_PI * freq * k * t + phase * k) / k;
+        }
+        seed = seed * 1664525u + 1013904223u;
+        double white = (static_cast<int32_t>(seed) / 2147483648.0) * noise;
+        double scaled = (sample * gain + white) * 32768.0;
+        scaled = scaled > 32767.0 ? 32767.0 : (scaled < -32768.0 ? -32768.0 : scaled);
+        pcm[i] = static_cast<int16_t>(std::lrint(scaled));
+    }
+}
+
+const char* timbreName(Timbre timbre) {
+    return timbre == Timbre::Sine ? "sine" : "harmonic";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    bool verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else {
+            fprintf(stderr, "usage: pitch_compare [-v]\n");
+            return 2;
+        }
+    }
+
+    std::vector<Case> cases;
+    for (int sampleRate : SAMPLE_RATES) {
+        for (Timbre timbre : {Timbre::Sine, Timbre::Harmonic}) {
+            for (int note = LOWEST_NOTE; note <= HIGHEST_NOTE; ++note) {
+                for (int detune : DETUNE_CENTS) {
+                    for (float level : LEVELS_DB) {
+                        cases.push_back({sampleRate, note, detune, level, timbre});
+                    }
+                }
+                for (float level : SILENT_LEVELS_DB) {
+                    cases.push_back({sampleRate, note, 0, level, timbre});
+                }
+            }
+        }
+    }
+
+    std::vector<int16_t> pcm(BUFFER_SIZE);
+    std::vector<float> samples(BUFFER_SIZE);
+    int mismatches = 0;
+    int silent = 0;
+    int currentRate = 0;
+    std::unique_ptr<PitchDetector> fixed;
+    std::unique_ptr<PitchDetector> reference;
+
+    for (size_t n = 0; n < cases.size(); ++n) {
+        const Case& c = cases[n];
+        if (c.sampleRate != currentRate) {
+            currentRate = c.sampleRate;
+            fixed = musicsheetflow::createFixedPointPitchDetector(currentRate, BUFFER_SIZE);
+            reference = musicsheetflow::createFloatPitchDetector(currentRate, BUFFER_SIZE);
+        }
+
+        synthesize(c, static_cast<uint32_t>(n) * 2654435761u + 1, pcm);
+        for (int i = 0; i < BUFFER_SIZE; ++i) {
+            samples[i] = pcm[i] * (1.0f / 32768.0f);
+        }
+        PitchResult q15 = fixed->detect(pcm.data(), BUFFER_SIZE);
+        PitchResult ref = reference->detect(samples.data(), BUFFER_SIZE);
+
+        bool match = q15.midiNote == ref.midiNote;
+        if (ref.midiNote < 0) {
+            ++silent;
+        }
+        if (!match) {
+            ++mismatches;
+        }
+        if (!match || verbose) {
+            printf("%s %5d Hz  note %3d %+3d cents  %6.1f dB  %-8s  q15 %3d (%7.2f Hz, %.3f)  float %3d (%7.2f Hz, %.3f)\n",
+                   match ? "ok  " : "FAIL", c.sampleRate, c.note, c.detuneCents, c.levelDb,
+                   timbreName(c.timbre), q15.midiNote, q15.frequency, q15.confidence,
+                   ref.midiNote, ref.frequency, ref.confidence);
+        }
+    }
+
+    printf("%zu buffers (%d without a note), %d mismatched\n", cases.size(), silent, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
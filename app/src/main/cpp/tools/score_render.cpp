@@ -0,0 +1,192 @@
+// Offline score renderer.
+//
+// Renders a note list with a SoundFont (.sf2 or baked .tsfb) to a WAV file
+// through the same OfflineRenderer the app uses, e.g. to produce reference
+// audio for pitch detector regression tests.
+//
+//   -r rate     output sample rate (default 44100)
+//   -t bpm      tempo (default 120)
+//   -p ch:prog  GM program for a channel (repeatable; channel 9 picks drum kits)
+//   -c seconds  chunk length rendered per job (default 10)
+//   -j threads  render threads (default: one per core)
+//   -f          32-bit float samples instead of 16-bit PCM
+//
+// The note list has one note per line, as the app compiles scores:
+//   onset_beats duration_beats midi_note velocity [channel]
+// with velocity 0-1 and channel 0 by default; '#' starts a comment.
+// A .mid file is read as the app imports one instead, playing at its opening
+// tempo and with its own programs unless -t or -p say otherwise.
+//
+// Usage: score_render [-r rate] [-t bpm] [-p ch:prog]... [-c seconds] [-j threads] [-f]
+//                     font notes.txt output.wav
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#define TSF_IMPLEMENTATION
+#include "../third_party/tsf.h"
+#include "../midi_file.h"
+#include "../offline_render.h"
+
+namespace {
+
+using musicsheetflow::MidiFile;
+using musicsheetflow::MidiFileData;
+using musicsheetflow::OfflineRenderOptions;
+using musicsheetflow::OfflineRenderer;
+using musicsheetflow::SequenceNote;
+
+struct Options {
+    OfflineRenderOptions render;
+    bool floatSamples = false;
+    bool tempoSet = false;
+    bool programsSet[16] = {};
+    const char* font = nullptr;
+    const char* notes = nullptr;
+    const char* output = nullptr;
+};
+
+void usage() {
+    fprintf(stderr, "usage: score_render [-r rate] [-t bpm] [-p ch:prog]... [-c seconds] [-j threads] [-f]\n"
+                    "                    font notes.txt output.wav\n");
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "-r") && i + 1 < argc) {
+            options.render.sampleRate = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-t") && i + 1 < argc) {
+            options.render.tempo = static_cast<float>(atof(argv[++i]));
+            options.tempoSet = true;
+        } else if (!strcmp(arg, "-p") && i + 1 < argc) {
+            int channel, program;
+            if (sscanf(argv[++i], "%d:%d", &channel, &program) != 2 || channel < 0 || channel > 15) return false;
+            options.render.channelPresets[channel] = program;
+            options.programsSet[channel] = true;
+        } else if (!strcmp(arg, "-c") && i + 1 < argc) {
+            options.render.chunkSeconds = atof(argv[++i]);
+        } else if (!strcmp(arg, "-j") && i + 1 < argc) {
+            options.render.threads = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-f")) {
+            options.floatSamples = true;
+        } else if (arg[0] == '-') {
+            return false;
+        } else if (!options.font) {
+            options.font = arg;
+        } else if (!options.notes) {
+            options.notes = arg;
+        } else if (!options.output) {
+            options.output = arg;
+        } else {
+            return false;
+        }
+    }
+    return options.font && options.notes && options.output &&
+           options.render.sampleRate > 0 && options.render.tempo > 0.0f;
+}
+
+bool readNotes(const char* path, std::vector<SequenceNote>& notes) {
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+    char line[256];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        ++lineNumber;
+        if (char* comment = strchr(line, '#')) *comment = '\0';
+        char first;
+        if (sscanf(line, " %c", &first) != 1) continue;  // Blank or comment only
+        double onset;
+        float duration, velocity;
+        int note, channel = 0;
+        int fields = sscanf(line, "%lf %f %d %f %d", &onset, &duration, &note, &velocity, &channel);
+        if (fields < 4 || note < 0 || note > 127 || channel < 0 || channel > 15) {
+            fprintf(stderr, "%s:%d: expected onset duration note velocity [channel]\n", path, lineNumber);
+            ok = false;
+            break;
+        }
+        notes.push_back({onset, duration, velocity, static_cast<uint8_t>(channel), static_cast<uint8_t>(note)});
+    }
+    fclose(file);
+    return ok;
+}
+
+bool endsWith(const char* text, const char* suffix) {
+    size_t length = strlen(text), suffixLength = strlen(suffix);
+    return length >= suffixLength && !strcmp(text + length - suffixLength, suffix);
+}
+
+bool readMidiFile(const char* path, Options& options, std::vector<SequenceNote>& notes) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    std::vector<char> bytes;
+    char buffer[65536];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+    fclose(file);
+
+    MidiFileData midi;
+    if (!MidiFile::parse(bytes.data(), bytes.size(), midi)) return false;
+    if (!options.tempoSet) {
+        options.render.tempo = midi.tempos.front().bpm;
+    }
+    for (int channel = 0; channel < 16; ++channel) {
+        if (!options.programsSet[channel] && midi.programs[channel] >= 0) {
+            options.render.channelPresets[channel] = midi.programs[channel];
+        }
+    }
+    if (midi.tempos.size() > 1) {
+        fprintf(stderr, "%s: %zu tempo changes ignored, playing at %.1f BPM\n", path, midi.tempos.size() - 1,
+                options.render.tempo);
+    }
+    notes = std::move(midi.notes);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<SequenceNote> notes;
+    bool midi = endsWith(options.notes, ".mid") || endsWith(options.notes, ".midi");
+    if (!(midi ? readMidiFile(options.notes, options, notes) : readNotes(options.notes, notes))) {
+        fprintf(stderr, "Could not read %s\n", options.notes);
+        return 1;
+    }
+    tsf* font = tsf_load_filename(options.font);
+    if (!font) {
+        fprintf(stderr, "Could not load %s\n", options.font);
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<float> pcm = OfflineRenderer::render(font, notes.data(), static_cast<int>(notes.size()), options.render);
+    double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    tsf_close(font);
+    if (pcm.empty()) {
+        fprintf(stderr, "Nothing rendered from %s\n", options.notes);
+        return 1;
+    }
+
+    int64_t frames = static_cast<int64_t>(pcm.size() / 2);
+    if (!OfflineRenderer::writeWav(options.output, pcm.data(), frames, options.render.sampleRate, options.floatSamples)) {
+        fprintf(stderr, "Could not write %s\n", options.output);
+        return 1;
+    }
+    double seconds = static_cast<double>(frames) / options.render.sampleRate;
+    printf("%zu notes, %.1f s of audio in %.0f ms (%.0fx real time)\n", notes.size(), seconds, millis,
+           seconds * 1000.0 / millis);
+    return 0;
+}
@@ -0,0 +1,327 @@
+// Offline SoundFont baker.
+//
+// Extracts the presets the app plays from a .sf2 and writes them in tsf's baked
+// format (TSF_BAKED_VERSION in third_party/tsf.h): regions already resolved to
+// struct tsf_region and only the 16-bit samples those regions reach. The result
+// is mapped from the APK and used in place, with nothing to parse at load time.
+//
+//   -p bank:preset  preset to keep (repeatable; default 0:0 piano and 128:0 drums)
+//   -a              keep every preset
+//   -r rate         resample to `rate`, folding fixed pitch offsets in, so notes
+//                   that play a sample at its recorded pitch on a `rate` output
+//                   (root keys, every drum kit hit) skip interpolation
+//   -k              keep the tail after continuous loops (trimmed by default)
+//
+// Usage: soundfont_bake [-p bank:preset]... [-a] [-r rate] [-k] input.sf2 output.tsfb
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#define TSF_IMPLEMENTATION
+#include "../third_party/tsf.h"
+
+namespace {
+
+// Taps on each side of the resampling kernel
+constexpr int LANCZOS_TAPS = 16;
+
+// One cent, as a frequency ratio
+constexpr double MAX_LOOP_DETUNE = 0.000578;
+
+struct Options {
+    std::vector<std::pair<int, int>> presets;  // bank, preset
+    bool allPresets = false;
+    unsigned int rate = 0;
+    bool trimLoops = true;
+    const char* input = nullptr;
+    const char* output = nullptr;
+};
+
+// Source span one or more regions play, and how it is written out
+struct SampleSpan {
+    unsigned int first;      // First source sample
+    unsigned int last;       // Last source sample, including the one read past the end
+    unsigned int anchor;     // Source sample that lands exactly on an output sample
+    unsigned int loopStart;  // Loop wrapped into the tail when the loop was trimmed
+    unsigned int loopEnd;
+    bool periodic;
+    double scale;            // Output samples per source sample
+
+    auto key() const { return std::make_tuple(first, last, anchor, loopStart, loopEnd, periodic, scale); }
+};
+
+struct Placement {
+    unsigned int base;       // Position of the span in the baked sample block
+    unsigned int length;
+    unsigned int anchorOut;  // Output index of the anchor sample
+};
+
+double lanczos(double x) {
+    if (x == 0.0) return 1.0;
+    if (std::fabs(x) >= LANCZOS_TAPS) return 0.0;
+    double px = M_PI * x;
+    return LANCZOS_TAPS * std::sin(px) * std::sin(px / LANCZOS_TAPS) / (px * px);
+}
+
+short clampSample(double value) {
+    long rounded = std::lround(value);
+    return static_cast<short>(rounded < -32768 ? -32768 : (rounded > 32767 ? 32767 : rounded));
+}
+
+class Baker {
+public:
+    Baker(tsf* font, const Options& options) : font_(font), options_(options) {}
+
+    bool bake(const std::vector<int>& presets, FILE* out);
+
+private:
+    short sourceSample(const SampleSpan& span, long index) const;
+    unsigned int outputIndex(const SampleSpan& span, const Placement& place, unsigned int source) const;
+    Placement place(const SampleSpan& span);
+    tsf_region bakeRegion(const tsf_region& region, bool drumKit);
+
+    tsf* font_;
+    const Options& options_;
+    std::map<decltype(std::declval<SampleSpan>().key()), Placement> placed_;
+    std::vector<short> samples_;
+};
+
+short Baker::sourceSample(const SampleSpan& span, long index) const {
+    if (span.periodic && index > static_cast<long>(span.loopEnd)) {
+        long length = static_cast<long>(span.loopEnd - span.loopStart) + 1;
+        index = span.loopStart + (index - span.loopStart) % length;
+    }
+    if (index < static_cast<long>(span.first) || index > static_cast<long>(span.last)) return 0;
+    return font_->fontSamples[index];
+}
+
+unsigned int Baker::outputIndex(const SampleSpan& span, const Placement& place, unsigned int source) const {
+    long relative = place.anchorOut + std::lround((static_cast<double>(source) - span.anchor) * span.scale);
+    if (relative < 0) relative = 0;
+    if (relative >= static_cast<long>(place.length)) relative = place.length - 1;
+    return place.base + static_cast<unsigned int>(relative);
+}
+
+Placement Baker::place(const SampleSpan& span) {
+    auto found = placed_.find(span.key());
+    if (found != placed_.end()) return found->second;
+
+    Placement result;
+    result.base = static_cast<unsigned int>(samples_.size());
+    result.anchorOut = static_cast<unsigned int>(std::lround((span.anchor - span.first) * span.scale));
+    result.length = result.anchorOut + static_cast<unsigned int>(std::lround((span.last - span.anchor) * span.scale)) + 1;
+    for (unsigned int j = 0; j < result.length; ++j) {
+        if (span.scale == 1.0) {
+            samples_.push_back(sourceSample(span, static_cast<long>(span.first) + j));
+            continue;
+        }
+        // Band-limited to the lower of the two rates
+        double cutoff = std::min(1.0, span.scale);
+        double x = span.anchor + (static_cast<double>(j) - result.anchorOut) / span.scale;
+        long reach = static_cast<long>(std::ceil(LANCZOS_TAPS / cutoff));
+        long center = static_cast<long>(std::floor(x));
+        double value = 0.0;
+        for (long k = center - reach + 1; k <= center + reach; ++k) {
+            value += sourceSample(span, k) * cutoff * lanczos((x - k) * cutoff);
+        }
+        samples_.push_back(clampSample(value));
+    }
+    placed_.emplace(span.key(), result);
+    return result;
+}
+
+tsf_region Baker::bakeRegion(const tsf_region& region, bool drumKit) {
+    tsf_region baked = region;
+    unsigned int lastSource = font_->fontSampleNum - 1;
+    bool looping = (region.loop_mode != TSF_LOOPMODE_NONE && region.loop_start < region.loop_end);
+    // A continuous loop never leaves the loop once inside it, so the tail is dead weight
+    bool trim = (options_.trimLoops && looping && region.loop_mode == TSF_LOOPMODE_CONTINUOUS &&
+                 region.loop_end + 1 < region.end && region.offset <= region.loop_end);
+    unsigned int end = (trim ? region.loop_end + 1 : region.end);
+
+    SampleSpan span;
+    span.first = (looping ? std::min(region.offset, region.loop_start) : region.offset);
+    span.last = std::min(looping ? std::max(end, region.loop_end + 1) : end, lastSource);
+    span.anchor = (looping ? region.loop_start : span.first);
+    span.loopStart = (trim ? region.loop_start : 0);
+    span.loopEnd = (trim ? region.loop_end : 0);
+    span.periodic = trim;
+    span.scale = 1.0;
+    if (options_.rate && region.sample_rate) {
+        // Pitch offsets that are constant for the region go into the resampling,
+        // so notes that play the sample at its recorded pitch run at exactly 1:1
+        double semitones = 0.0;
+        if (drumKit && region.lokey == region.hikey) {
+            // A kit key always plays the same pitch. Melodic presets keep theirs:
+            // neighbouring keys share samples and each would need its own copy.
+            semitones = (region.lokey + region.transpose + region.tune / 100.0 - region.pitch_keycenter) *
+                        region.pitch_keytrack / 100.0;
+            baked.pitch_keycenter = region.lokey;
+            baked.transpose = 0;
+            baked.tune = 0;
+        } else if (region.pitch_keytrack == 100) {
+            // Fine tuning is a constant offset under normal key tracking
+            semitones = region.tune / 100.0;
+            baked.tune = 0;
+        }
+        double ideal = options_.rate / (region.sample_rate * std::pow(2.0, semitones / 12.0));
+        span.scale = ideal;
+        baked.sample_rate = options_.rate;
+        if (looping) {
+            // Loops need a whole number of samples. Under a cent of detuning is
+            // kept for the 1:1 path; short loops get a compensating rate instead.
+            double length = region.loop_end - region.loop_start + 1.0;
+            span.scale = std::max(1.0, std::round(length * ideal)) / length;
+            if (std::fabs(span.scale / ideal - 1.0) > MAX_LOOP_DETUNE) {
+                baked.sample_rate = static_cast<unsigned int>(std::lround(options_.rate * span.scale / ideal));
+            }
+        }
+    }
+
+    Placement placement = place(span);
+    baked.offset = outputIndex(span, placement, region.offset);
+    baked.end = outputIndex(span, placement, std::min(end, lastSource));
+    if (looping) {
+        baked.loop_start = outputIndex(span, placement, region.loop_start);
+        baked.loop_end = placement.base + placement.anchorOut +
+            static_cast<unsigned int>(std::lround((region.loop_end - region.loop_start + 1.0) * span.scale)) - 1;
+    } else {
+        baked.loop_start = baked.loop_end = 0;
+    }
+    return baked;
+}
+
+bool Baker::bake(const std::vector<int>& presets, FILE* out) {
+    std::vector<tsf_baked_preset> records;
+    std::vector<tsf_region> regions;
+    for (int index : presets) {
+        const tsf_preset& preset = font_->presets[index];
+        tsf_baked_preset record{};
+        memcpy(record.presetName, preset.presetName, sizeof(record.presetName));
+        record.preset = preset.preset;
+        record.bank = preset.bank;
+        record.regionNum = static_cast<tsf_u32>(preset.regionNum);
+        records.push_back(record);
+        for (int i = 0; i < preset.regionNum; ++i) {
+            regions.push_back(bakeRegion(preset.regions[i], preset.bank == 128));
+        }
+    }
+    // Rendering reads one sample past a region's end
+    samples_.push_back(0);
+
+    tsf_baked_header header{};
+    memcpy(header.magic, "TSFB", sizeof(header.magic));
+    header.version = TSF_BAKED_VERSION;
+    header.regionSize = sizeof(tsf_region);
+    header.presetNum = static_cast<tsf_u32>(records.size());
+    header.regionNum = static_cast<tsf_u32>(regions.size());
+    header.sampleNum = static_cast<tsf_u32>(samples_.size());
+    return fwrite(&header, sizeof(header), 1, out) == 1 &&
+           fwrite(records.data(), sizeof(tsf_baked_preset), records.size(), out) == records.size() &&
+           fwrite(regions.data(), sizeof(tsf_region), regions.size(), out) == regions.size() &&
+           fwrite(samples_.data(), sizeof(short), samples_.size(), out) == samples_.size();
+}
+
+void usage() {
+    fprintf(stderr, "usage: soundfont_bake [-p bank:preset]... [-a] [-r rate] [-k] input.sf2 output.tsfb\n");
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "-p") && i + 1 < argc) {
+            int bank, preset;
+            if (sscanf(argv[++i], "%d:%d", &bank, &preset) != 2) return false;
+            options.presets.emplace_back(bank, preset);
+        } else if (!strcmp(arg, "-a")) {
+            options.allPresets = true;
+        } else if (!strcmp(arg, "-r") && i + 1 < argc) {
+            options.rate = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+        } else if (!strcmp(arg, "-k")) {
+            options.trimLoops = false;
+        } else if (arg[0] == '-') {
+            return false;
+        } else if (!options.input) {
+            options.input = arg;
+        } else if (!options.output) {
+            options.output = arg;
+        } else {
+            return false;
+        }
+    }
+    if (options.presets.empty()) {
+        options.presets = {{0, 0}, {128, 0}};
+    }
+    return options.input && options.output;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    const uint16_t probe = 1;
+    if (*reinterpret_cast<const unsigned char*>(&probe) != 1) {
+        fprintf(stderr, "Baked fonts are little-endian; bake on a little-endian host\n");
+        return 1;
+    }
+
+    tsf* font = tsf_load_filename(options.input);
+    if (!font) {
+        fprintf(stderr, "Could not load %s\n", options.input);
+        return 1;
+    }
+
+    std::vector<int> presets;
+    if (options.allPresets) {
+        for (int i = 0; i < tsf_get_presetcount(font); ++i) presets.push_back(i);
+    } else {
+        for (const auto& wanted : options.presets) {
+            int index = tsf_get_presetindex(font, wanted.first, wanted.second);
+            if (index < 0) {
+                fprintf(stderr, "No preset %d:%d in %s\n", wanted.first, wanted.second, options.input);
+                tsf_close(font);
+                return 1;
+            }
+            presets.push_back(index);
+        }
+    }
+
+    FILE* out = fopen(options.output, "wb");
+    Baker baker(font, options);
+    bool written = out && baker.bake(presets, out);
+    if (out && fclose(out) != 0) written = false;
+    if (!written) {
+        fprintf(stderr, "Could not write %s\n", options.output);
+        tsf_close(font);
+        return 1;
+    }
+
+    tsf* check = tsf_load_filename(options.output);
+    if (!check) {
+        fprintf(stderr, "Baked font %s does not load back\n", options.output);
+        tsf_close(font);
+        return 1;
+    }
+    unsigned int sourceSamples = 0, bakedSamples = 0;
+    tsf_get_sampledata(font, &sourceSamples);
+    tsf_get_sampledata(check, &bakedSamples);
+    for (int i = 0; i < tsf_get_presetcount(check); ++i) {
+        printf("%3d:%-3d %s\n", tsf_get_presetbank(check, i), tsf_get_presetnumber(check, i), tsf_get_presetname(check, i));
+    }
+    printf("%d presets, %u KB of samples (source font %u KB)\n", tsf_get_presetcount(check),
+           bakedSamples * 2 / 1024, sourceSamples * 2 / 1024);
+    tsf_close(check);
+    tsf_close(font);
+    return 0;
+}
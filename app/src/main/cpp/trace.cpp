@@ -0,0 +1,452 @@
+#include "trace.h"
+#include <android/log.h>
+#include <android/trace.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define LOG_TAG "Trace"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+namespace musicsheetflow {
+
+// Perfetto proto field numbers (protos/perfetto/trace/*.proto)
+static constexpr int TRACE_PACKET = 1;
+static constexpr int PACKET_TIMESTAMP = 8;
+static constexpr int PACKET_SEQUENCE_ID = 10;
+static constexpr int PACKET_TRACK_EVENT = 11;
+static constexpr int PACKET_SEQUENCE_FLAGS = 13;
+static constexpr int PACKET_TRACK_DESCRIPTOR = 60;
+static constexpr int TRACK_UUID = 1;
+static constexpr int TRACK_NAME = 2;
+static constexpr int TRACK_PROCESS = 3;
+static constexpr int TRACK_THREAD = 4;
+static constexpr int TRACK_PARENT_UUID = 5;
+static constexpr int TRACK_COUNTER = 8;
+static constexpr int PROCESS_PID = 1;
+static constexpr int PROCESS_NAME = 6;
+static constexpr int THREAD_PID = 1;
+static constexpr int THREAD_TID = 2;
+static constexpr int THREAD_NAME = 5;
+static constexpr int EVENT_TYPE = 9;
+static constexpr int EVENT_TRACK_UUID = 11;
+static constexpr int EVENT_NAME = 23;
+static constexpr int EVENT_COUNTER_VALUE = 30;
+
+// TrackEvent.Type
+static constexpr int SLICE_BEGIN = 1;
+static constexpr int SLICE_END = 2;
+static constexpr int INSTANT = 3;
+static constexpr int COUNTER = 4;
+
+// TracePacket.SEQ_INCREMENTAL_STATE_CLEARED, on the first packet
+static constexpr int SEQUENCE_CLEARED = 1;
+
+// ATrace_setCounter is API 29, above minSdk
+using SetCounterFn = void (*)(const char*, int64_t);
+static const auto g_atraceSetCounter =
+    reinterpret_cast<SetCounterFn>(dlsym(RTLD_DEFAULT, "ATrace_setCounter"));
+
+static TraceRing g_rings[MAX_TRACE_THREADS];
+static std::atomic<int> g_claimedRings{0};
+
+// Bumped by start(), so threads claim a ring afresh: audio streams get a
+// new callback thread every time they open
+static std::atomic<uint32_t> g_session{0};
+
+struct ThreadRing {
+    uint32_t session = 0;
+    TraceRing* ring = nullptr;
+};
+static thread_local ThreadRing t_ring;
+
+std::atomic<bool> Trace::recording_{false};
+
+static int64_t bootNanos() {
+    timespec now{};
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static TraceRing* threadRing() {
+    uint32_t session = g_session.load(std::memory_order_acquire);
+    if (t_ring.session == session) {
+        return t_ring.ring;
+    }
+    t_ring.session = session;
+    int index = g_claimedRings.fetch_add(1, std::memory_order_relaxed);
+    t_ring.ring = index < MAX_TRACE_THREADS ? &g_rings[index] : nullptr;
+    if (t_ring.ring) {
+        // Published to readers by the first event's release
+        t_ring.ring->tid = gettid();
+        pthread_getname_np(pthread_self(), t_ring.ring->threadName, sizeof(t_ring.ring->threadName));
+    }
+    return t_ring.ring;
+}
+
+static bool append(TraceEventType type, const char* name, int64_t value) {
+    TraceRing* ring = threadRing();
+    if (!ring) {
+        return false;
+    }
+    uint64_t index = ring->written.load(std::memory_order_relaxed);
+    ring->events[index % TRACE_RING_EVENTS] = {bootNanos(), name, value, type};
+    ring->written.store(index + 1, std::memory_order_release);
+    return true;
+}
+
+void Trace::start() {
+    if (recording_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    for (TraceRing& ring : g_rings) {
+        if (!ring.events) {
+            // Left uninitialized: pages are only touched as threads fill them
+            ring.events.reset(new TraceEvent[TRACE_RING_EVENTS]);
+        }
+        ring.written.store(0, std::memory_order_relaxed);
+        ring.tid = 0;
+        ring.threadName[0] = '\0';
+    }
+    g_claimedRings.store(0, std::memory_order_relaxed);
+    g_session.fetch_add(1, std::memory_order_release);
+    recording_.store(true, std::memory_order_release);
+    LOGI("Recording started");
+}
+
+void Trace::stop() {
+    if (recording_.exchange(false, std::memory_order_relaxed)) {
+        LOGI("Recording stopped");
+    }
+}
+
+int Trace::begin(const char* name) {
+    int flags = 0;
+    if (recording_.load(std::memory_order_relaxed) && append(TraceEventType::Begin, name, 0)) {
+        flags |= RECORDED;
+    }
+    if (ATrace_isEnabled()) {
+        ATrace_beginSection(name);
+        flags |= ATRACE;
+    }
+    return flags;
+}
+
+void Trace::end(int flags) {
+    if (flags & ATRACE) {
+        ATrace_endSection();
+    }
+    if (flags & RECORDED) {
+        append(TraceEventType::End, nullptr, 0);
+    }
+}
+
+void Trace::counter(const char* name, int64_t value) {
+    if (recording_.load(std::memory_order_relaxed)) {
+        append(TraceEventType::Counter, name, value);
+    }
+    if (g_atraceSetCounter && ATrace_isEnabled()) {
+        g_atraceSetCounter(name, value);
+    }
+}
+
+void Trace::instant(const char* name) {
+    if (recording_.load(std::memory_order_relaxed)) {
+        append(TraceEventType::Instant, name, 0);
+    }
+    if (ATrace_isEnabled()) {
+        ATrace_beginSection(name);
+        ATrace_endSection();
+    }
+}
+
+// Events one ring holds, oldest first
+struct RingSnapshot {
+    int32_t tid;
+    std::string threadName;
+    std::vector<TraceEvent> events;
+};
+
+static std::vector<RingSnapshot> snapshotRings() {
+    std::vector<RingSnapshot> snapshots;
+    if (!g_rings[0].events) {
+        return snapshots;  // Never started
+    }
+    int rings = std::min(g_claimedRings.load(std::memory_order_relaxed), MAX_TRACE_THREADS);
+    for (int i = 0; i < rings; i++) {
+        TraceRing& ring = g_rings[i];
+        uint64_t end = ring.written.load(std::memory_order_acquire);
+        if (end == 0) {
+            continue;  // Claimed, first event not written yet
+        }
+        uint64_t first = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+        std::vector<TraceEvent> events;
+        events.reserve(end - first);
+        for (uint64_t index = first; index < end; index++) {
+            events.push_back(ring.events[index % TRACE_RING_EVENTS]);
+        }
+
+        // Drop what the writer reached during the copy, including the slot
+        // it may be in the middle of
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring.written.load(std::memory_order_relaxed);
+        uint64_t valid = after + 1 > TRACE_RING_EVENTS ? after + 1 - TRACE_RING_EVENTS : 0;
+        if (valid > first) {
+            events.erase(events.begin(), events.begin() + std::min<uint64_t>(valid - first, events.size()));
+        }
+
+        // The ring may have wrapped inside a slice: drop ends of slices
+        // whose begin was overwritten
+        int depth = 0;
+        events.erase(std::remove_if(events.begin(), events.end(), [&depth](const TraceEvent& event) {
+            if (event.type == TraceEventType::Begin) {
+                depth++;
+            } else if (event.type == TraceEventType::End) {
+                if (depth == 0) {
+                    return true;
+                }
+                depth--;
+            }
+            return false;
+        }), events.end());
+
+        snapshots.push_back({ring.tid, ring.threadName, std::move(events)});
+    }
+    return snapshots;
+}
+
+static std::string processName() {
+    char name[256] = {};
+    FILE* file = fopen("/proc/self/cmdline", "r");
+    if (file) {
+        fread(name, 1, sizeof(name) - 1, file);
+        fclose(file);
+    }
+    return name;
+}
+
+static void writeJsonString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', file);
+            fputc(*c, file);
+        } else if (static_cast<unsigned char>(*c) < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// Chrome trace event format, for chrome://tracing and ui.perfetto.dev
+bool Trace::writeChromeJson(const char* path) {
+    std::vector<RingSnapshot> rings = snapshotRings();
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        LOGE("Cannot write trace to %s", path);
+        return false;
+    }
+    int pid = getpid();
+    size_t count = 0;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":", pid);
+    writeJsonString(file, processName().c_str());
+    fputs("}}", file);
+    for (const RingSnapshot& ring : rings) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                pid, ring.tid);
+        writeJsonString(file, ring.threadName.c_str());
+        fputs("}}", file);
+        for (const TraceEvent& event : ring.events) {
+            double micros = event.timestampNs / 1000.0;
+            switch (event.type) {
+                case TraceEventType::Begin:
+                    fputs(",\n{\"ph\":\"B\",\"name\":", file);
+                    writeJsonString(file, event.name);
+                    fprintf(file, ",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", micros, pid, ring.tid);
+                    break;
+                case TraceEventType::End:
+                    fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", micros, pid, ring.tid);
+                    break;
+                case TraceEventType::Counter:
+                    fputs(",\n{\"ph\":\"C\",\"name\":", file);
+                    writeJsonString(file, event.name);
+                    fprintf(file, ",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"value\":%lld}}",
+                            micros, pid, ring.tid, static_cast<long long>(event.value));
+                    break;
+                case TraceEventType::Instant:
+                    fputs(",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":", file);
+                    writeJsonString(file, event.name);
+                    fprintf(file, ",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", micros, pid, ring.tid);
+                    break;
+            }
+            count++;
+        }
+    }
+    fputs("\n]}\n", file);
+    bool ok = fclose(file) == 0;
+    LOGI("Wrote %zu trace events to %s", count, path);
+    return ok;
+}
+
+// Protobuf wire format, enough for the trace packets below
+class ProtoWriter {
+public:
+    void varint(int field, uint64_t value) {
+        key(field, 0);
+        putVarint(value);
+    }
+    void string(int field, const char* text) {
+        bytes(field, text, strlen(text));
+    }
+    void message(int field, const ProtoWriter& message) {
+        bytes(field, message.data_.data(), message.data_.size());
+    }
+    const std::string& data() const { return data_; }
+    void clear() { data_.clear(); }
+
+private:
+    void key(int field, int wireType) {
+        putVarint(static_cast<uint64_t>(field) << 3 | wireType);
+    }
+    void bytes(int field, const char* data, size_t size) {
+        key(field, 2);
+        putVarint(size);
+        data_.append(data, size);
+    }
+    void putVarint(uint64_t value) {
+        while (value >= 0x80) {
+            data_.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        data_.push_back(static_cast<char>(value));
+    }
+
+    std::string data_;
+};
+
+// Perfetto trace: one track per thread for its slices, one per counter
+// name for the process, all packets on one sequence
+bool Trace::writePerfetto(const char* path) {
+    std::vector<RingSnapshot> rings = snapshotRings();
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        LOGE("Cannot write trace to %s", path);
+        return false;
+    }
+    int pid = getpid();
+    uint64_t processUuid = static_cast<uint64_t>(pid) << 20;
+    uint64_t counterUuid = processUuid + MAX_TRACE_THREADS + 1;
+    bool firstPacket = true;
+
+    ProtoWriter packet;
+    ProtoWriter trace;
+    auto writePacket = [&]() {
+        packet.varint(PACKET_SEQUENCE_ID, 1);
+        if (firstPacket) {
+            packet.varint(PACKET_SEQUENCE_FLAGS, SEQUENCE_CLEARED);
+            firstPacket = false;
+        }
+        trace.clear();
+        trace.message(TRACE_PACKET, packet);
+        fwrite(trace.data().data(), 1, trace.data().size(), file);
+        packet.clear();
+    };
+    ProtoWriter descriptor;
+    ProtoWriter inner;
+
+    // Process
+    inner.varint(PROCESS_PID, pid);
+    inner.string(PROCESS_NAME, processName().c_str());
+    descriptor.varint(TRACK_UUID, processUuid);
+    descriptor.message(TRACK_PROCESS, inner);
+    packet.message(PACKET_TRACK_DESCRIPTOR, descriptor);
+    writePacket();
+
+    // Threads
+    for (size_t i = 0; i < rings.size(); i++) {
+        inner.clear();
+        inner.varint(THREAD_PID, pid);
+        inner.varint(THREAD_TID, rings[i].tid);
+        inner.string(THREAD_NAME, rings[i].threadName.c_str());
+        descriptor.clear();
+        descriptor.varint(TRACK_UUID, processUuid + 1 + i);
+        descriptor.varint(TRACK_PARENT_UUID, processUuid);
+        descriptor.message(TRACK_THREAD, inner);
+        packet.message(PACKET_TRACK_DESCRIPTOR, descriptor);
+        writePacket();
+    }
+
+    // All events in time order, each on its thread or counter track
+    struct Entry {
+        const TraceEvent* event;
+        uint64_t track;
+    };
+    std::vector<Entry> entries;
+    std::vector<const char*> counters;
+    for (size_t i = 0; i < rings.size(); i++) {
+        for (const TraceEvent& event : rings[i].events) {
+            uint64_t track = processUuid + 1 + i;
+            if (event.type == TraceEventType::Counter) {
+                auto it = std::find_if(counters.begin(), counters.end(),
+                                       [&event](const char* name) { return strcmp(name, event.name) == 0; });
+                if (it == counters.end()) {
+                    descriptor.clear();
+                    descriptor.varint(TRACK_UUID, counterUuid + counters.size());
+                    descriptor.varint(TRACK_PARENT_UUID, processUuid);
+                    descriptor.string(TRACK_NAME, event.name);
+                    descriptor.message(TRACK_COUNTER, ProtoWriter());
+                    packet.message(PACKET_TRACK_DESCRIPTOR, descriptor);
+                    writePacket();
+                    it = counters.insert(counters.end(), event.name);
+                }
+                track = counterUuid + (it - counters.begin());
+            }
+            entries.push_back({&event, track});
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.event->timestampNs < b.event->timestampNs;
+    });
+
+    for (const Entry& entry : entries) {
+        const TraceEvent& event = *entry.event;
+        ProtoWriter trackEvent;
+        switch (event.type) {
+            case TraceEventType::Begin:
+                trackEvent.varint(EVENT_TYPE, SLICE_BEGIN);
+                trackEvent.string(EVENT_NAME, event.name);
+                break;
+            case TraceEventType::End:
+                trackEvent.varint(EVENT_TYPE, SLICE_END);
+                break;
+            case TraceEventType::Counter:
+                trackEvent.varint(EVENT_TYPE, COUNTER);
+                trackEvent.varint(EVENT_COUNTER_VALUE, static_cast<uint64_t>(event.value));
+                break;
+            case TraceEventType::Instant:
+                trackEvent.varint(EVENT_TYPE, INSTANT);
+                trackEvent.string(EVENT_NAME, event.name);
+                break;
+        }
+        trackEvent.varint(EVENT_TRACK_UUID, entry.track);
+        packet.varint(PACKET_TIMESTAMP, static_cast<uint64_t>(event.timestampNs));
+        packet.message(PACKET_TRACK_EVENT, trackEvent);
+        writePacket();
+    }
+
+    bool ok = fclose(file) == 0;
+    LOGI("Wrote %zu trace events to %s", entries.size(), path);
+    return ok;
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace musicsheetflow {
+
+// Threads that can record at once; events from further threads are dropped
+static constexpr int MAX_TRACE_THREADS = 16;
+
+// Events kept per thread, oldest overwritten first (a few seconds of the
+// output callback)
+static constexpr int TRACE_RING_EVENTS = 16384;
+
+enum class TraceEventType : uint8_t {
+    Begin,
+    End,
+    Counter,
+    Instant
+};
+
+// `name` is a string literal: events hold the pointer, never a copy
+struct TraceEvent {
+    int64_t timestampNs;  // CLOCK_BOOTTIME, the clock of system traces
+    const char* name;
+    int64_t value;        // Counter value
+    TraceEventType type;
+};
+
+// Events of one thread. Only that thread writes; an export copies it while
+// it goes on and drops anything overwritten during the copy.
+struct TraceRing {
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> written{0};  // Events ever written; slot is written % TRACE_RING_EVENTS
+    int32_t tid = 0;
+    char threadName[16] = {};
+};
+
+/**
+ * Timeline of what the audio threads did, for diagnosing callback overruns
+ * from a capture instead of guesswork.
+ *
+ * Always compiled in. Scopes and counters cost one relaxed load while
+ * nothing is listening. While recording, each thread appends to its own
+ * flight-recorder ring with no locks or allocation, so the callbacks can
+ * trace themselves; writeChromeJson() and writePerfetto() export the rings
+ * on demand. While a system trace (systrace/Perfetto with the app category)
+ * is running, the same scopes and counters also go to ATrace, so they show
+ * up next to the scheduler and the audio HAL.
+ */
+class Trace {
+public:
+    // Start recording into fresh rings, allocated on first use. Control
+    // thread, while not recording.
+    static void start();
+    static void stop();
+    static bool isRecording() { return recording_.load(std::memory_order_relaxed); }
+
+    // Export what the rings hold. May run while recording.
+    static bool writeChromeJson(const char* path);
+    static bool writePerfetto(const char* path);
+
+    // Flags for end(): where the matching begin() went
+    static constexpr int RECORDED = 1;
+    static constexpr int ATRACE = 2;
+
+    static int begin(const char* name);
+    static void end(int flags);
+    static void counter(const char* name, int64_t value);
+    static void instant(const char* name);
+
+private:
+    static std::atomic<bool> recording_;
+};
+
+// Begin and end of a slice, from construction to the end of the scope
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : flags_(Trace::begin(name)) {}
+    ~TraceScope() {
+        if (flags_) {
+            Trace::end(flags_);
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    int flags_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Slice covering the rest of the enclosing scope; `name` is a string literal
+#define TRACE_SCOPE(name) ::musicsheetflow::TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) ::musicsheetflow::Trace::counter(name, static_cast<int64_t>(value))
+#define TRACE_INSTANT(name) ::musicsheetflow::Trace::instant(name)
+
+}  // namespace musicsheetflow
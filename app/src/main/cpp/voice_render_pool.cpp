@@ -0,0 +1,241 @@
+#include "voice_render_pool.h"
+#include "trace.h"
+#include <android/log.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "third_party/tsf.h"
+
+#define LOG_TAG "VoiceRenderPool"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+namespace musicsheetflow {
+
+static constexpr int MAX_WORKERS = 3;
+
+// Voices per claim: small enough that a preempted worker holds little back
+static constexpr int CHUNK_VOICES = 4;
+
+// Below these the handoff costs more than it saves
+static constexpr int MIN_PARALLEL_VOICES = 12;
+static constexpr int32_t MIN_PARALLEL_FRAMES = 64;
+
+// Scratch bus size; longer callbacks render serially
+static constexpr int32_t MAX_BUS_FRAMES = 4096;
+
+// Callback spins this long on in-flight chunks before yielding
+static constexpr int SPINS_BEFORE_YIELD = 256;
+
+// THREAD_PRIORITY_URGENT_AUDIO, used when SCHED_FIFO is not granted
+static constexpr int URGENT_AUDIO_NICE = -19;
+
+static constexpr int32_t BENCHMARK_FRAMES = 192;
+static constexpr int BENCHMARK_BLOCKS = 400;
+
+static void raiseWorkerPriority() {
+    sched_param param{};
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) {
+        return;
+    }
+    if (setpriority(PRIO_PROCESS, gettid(), URGENT_AUDIO_NICE) != 0) {
+        LOGW("Could not raise render worker priority");
+    }
+}
+
+VoiceRenderPool::~VoiceRenderPool() {
+    stop();
+}
+
+int VoiceRenderPool::recommendedWorkers() {
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (cores < 4) {
+        return 0;
+    }
+    // Leave half the cores to the UI, pitch detection and the callback itself
+    return std::min(MAX_WORKERS, cores / 2 - 1);
+}
+
+bool VoiceRenderPool::start(int workers) {
+    if (running_.load(std::memory_order_acquire)) {
+        return true;
+    }
+    workers = std::min(workers, MAX_WORKERS);
+    if (workers <= 0) {
+        return false;
+    }
+
+    running_.store(true, std::memory_order_release);
+    for (int i = 0; i < workers; ++i) {
+        auto worker = std::make_unique<Worker>();
+        sem_init(&worker->wake, 0, 0);
+        worker->bus.assign(static_cast<size_t>(MAX_BUS_FRAMES) * 2, 0.0f);
+        workers_.push_back(std::move(worker));
+    }
+    for (int i = 0; i < workers; ++i) {
+        Worker* worker = workers_[i].get();
+        worker->thread = std::thread([this, worker, i] {
+            char name[16];
+            snprintf(name, sizeof(name), "VoiceRender%d", i);
+            pthread_setname_np(pthread_self(), name);
+            raiseWorkerPriority();
+            workerLoop(worker);
+        });
+    }
+
+    LOGI("Voice render pool started: %d workers, %u cores", workers,
+         std::thread::hardware_concurrency());
+    return true;
+}
+
+void VoiceRenderPool::stop() {
+    enabled_.store(false, std::memory_order_release);
+    if (!running_.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    for (auto& worker : workers_) {
+        sem_post(&worker->wake);
+    }
+    for (auto& worker : workers_) {
+        worker->thread.join();
+        sem_destroy(&worker->wake);
+    }
+    workers_.clear();
+}
+
+void VoiceRenderPool::workerLoop(Worker* worker) {
+    for (;;) {
+        sem_wait(&worker->wake);
+        if (!running_.load(std::memory_order_acquire)) {
+            return;
+        }
+        TRACE_SCOPE("Voice chunks");
+        renderWorkerChunks(worker);
+    }
+}
+
+void VoiceRenderPool::render(tsf* synth, float* output, int32_t numFrames) {
+    // Enabled only once start() has finished, so workers_ is stable from here
+    int slots = tsf_render_voice_slots(synth);
+    if (!isEnabled() || workers_.empty() || slots < MIN_PARALLEL_VOICES ||
+        numFrames < MIN_PARALLEL_FRAMES || numFrames > MAX_BUS_FRAMES) {
+        tsf_render_float(synth, output, numFrames, 0);
+        return;
+    }
+
+    memset(output, 0, numFrames * 2 * sizeof(float));
+    jobSynth_ = synth;
+    jobFrames_ = numFrames;
+    work_.store(static_cast<uint64_t>(slots) << 32);
+    for (auto& worker : workers_) {
+        sem_post(&worker->wake);
+    }
+
+    // Take chunks alongside the workers; whatever they have not claimed by
+    // now is rendered here
+    renderChunks(output);
+    {
+        TRACE_SCOPE("Wait for voice chunks");
+        for (int spins = 0; inFlight_.load() != 0; ++spins) {
+            if (spins >= SPINS_BEFORE_YIELD) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    int32_t samples = numFrames * 2;
+    for (auto& worker : workers_) {
+        if (!worker->busUsed) {
+            continue;
+        }
+        const float* bus = worker->bus.data();
+        for (int32_t i = 0; i < samples; ++i) {
+            output[i] += bus[i];
+        }
+        worker->busUsed = false;
+    }
+    tsf_render_compact(synth);
+}
+
+// Callback thread share: no in-flight accounting, it waits for nobody but itself
+void VoiceRenderPool::renderChunks(float* output) {
+    for (;;) {
+        uint64_t word = work_.fetch_add(CHUNK_VOICES);
+        auto begin = static_cast<int>(word & 0xFFFFFFFFu);
+        auto slots = static_cast<int>(word >> 32);
+        if (begin >= slots) {
+            return;
+        }
+        tsf_render_float_voices(jobSynth_, output, jobFrames_, begin, std::min(begin + CHUNK_VOICES, slots));
+    }
+}
+
+void VoiceRenderPool::renderWorkerChunks(Worker* worker) {
+    for (;;) {
+        // Announce the claim first, so a callback that sees the job drained
+        // also sees this chunk in flight
+        inFlight_.fetch_add(1);
+        uint64_t word = work_.fetch_add(CHUNK_VOICES);
+        auto begin = static_cast<int>(word & 0xFFFFFFFFu);
+        auto slots = static_cast<int>(word >> 32);
+        if (begin >= slots) {
+            inFlight_.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+
+        if (!worker->busUsed) {
+            memset(worker->bus.data(), 0, jobFrames_ * 2 * sizeof(float));
+            worker->busUsed = true;
+        }
+        tsf_render_float_voices(jobSynth_, worker->bus.data(), jobFrames_,
+                                begin, std::min(begin + CHUNK_VOICES, slots));
+        inFlight_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+RenderBenchmark VoiceRenderPool::benchmark(tsf* synth, int voices, int workers) {
+    RenderBenchmark result;
+    VoiceRenderPool pool;
+    if (pool.start(workers)) {
+        pool.setEnabled(true);
+    }
+    result.workers = pool.workerCount();
+
+    // Held cluster on the first preset; layered regions give more voices than keys
+    for (int note = 36; note < 108 && tsf_active_voice_count(synth) < voices; ++note) {
+        tsf_note_on(synth, 0, note, 0.8f);
+    }
+    result.voices = tsf_active_voice_count(synth);
+
+    using Clock = std::chrono::steady_clock;
+    std::vector<float> buffer(static_cast<size_t>(BENCHMARK_FRAMES) * 2);
+    Clock::duration serial{};
+    Clock::duration parallel{};
+    for (int block = 0; block < BENCHMARK_BLOCKS; ++block) {
+        auto begin = Clock::now();
+        if (block & 1) {
+            pool.render(synth, buffer.data(), BENCHMARK_FRAMES);
+            parallel += Clock::now() - begin;
+        } else {
+            tsf_render_float(synth, buffer.data(), BENCHMARK_FRAMES, 0);
+            serial += Clock::now() - begin;
+        }
+    }
+    pool.stop();
+
+    double blocksEach = BENCHMARK_BLOCKS / 2.0;
+    result.serialMicros = std::chrono::duration<double, std::micro>(serial).count() / blocksEach;
+    result.parallelMicros = std::chrono::duration<double, std::micro>(parallel).count() / blocksEach;
+    LOGI("Render benchmark: %d voices, %d workers, serial %.1f us, parallel %.1f us per %d frames",
+         result.voices, result.workers, result.serialMicros, result.parallelMicros, BENCHMARK_FRAMES);
+    return result;
+}
+
+}  // namespace musicsheetflow
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <semaphore.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+struct tsf;
+
+namespace musicsheetflow {
+
+// Serial vs parallel cost of rendering one callback-sized block
+struct RenderBenchmark {
+    int voices = 0;             // Voices actually sounding during the run
+    int workers = 0;            // 0: parallel pass fell back to serial
+    double serialMicros = 0.0;  // Mean per block
+    double parallelMicros = 0.0;
+};
+
+/**
+ * Splits synth voice rendering across a few worker threads.
+ *
+ * Each render call cuts the active voice list into small chunks that the
+ * callback thread and the workers claim from a shared counter. Workers mix
+ * into their own scratch bus, which the callback sums at the end. The
+ * callback never waits for a worker to wake up: any chunk still unclaimed
+ * when it runs out of its own work is rendered on the callback thread, so
+ * a late worker costs at most the one chunk it is holding.
+ */
+class VoiceRenderPool {
+public:
+    VoiceRenderPool() = default;
+    ~VoiceRenderPool();
+
+    VoiceRenderPool(const VoiceRenderPool&) = delete;
+    VoiceRenderPool& operator=(const VoiceRenderPool&) = delete;
+
+    // Workers worth running on this device; 0 below four cores
+    static int recommendedWorkers();
+
+    // Control thread API. start() and stop() must not overlap a render call;
+    // setEnabled() may be switched at any time.
+    bool start(int workers);
+    void stop();
+    void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_release); }
+    bool isEnabled() const { return enabled_.load(std::memory_order_acquire); }
+    int workerCount() const { return static_cast<int>(workers_.size()); }
+
+    // Audio thread API: same result as tsf_render_float(synth, output, numFrames, 0)
+    void render(tsf* synth, float* output, int32_t numFrames);
+
+    // Render a dense chord on `synth` (a private tsf_copy with its output set),
+    // alternating serial and parallel blocks so both see the same voices
+    static RenderBenchmark benchmark(tsf* synth, int voices, int workers);
+
+private:
+    struct alignas(64) Worker {
+        std::thread thread;
+        sem_t wake;
+        std::vector<float> bus;
+        bool busUsed = false;  // Written by the worker, read and cleared by the callback
+    };
+
+    void workerLoop(Worker* worker);
+    void renderChunks(float* output);
+    void renderWorkerChunks(Worker* worker);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> enabled_{false};
+
+    // Current job. The counter packs the slot count (high half) with the next
+    // unclaimed slot (low half), so a stale claim can never pass as valid.
+    std::atomic<uint64_t> work_{0};
+    std::atomic<int> inFlight_{0};  // Chunks claimed by workers and not yet mixed
+    tsf* jobSynth_ = nullptr;
+    int32_t jobFrames_ = 0;
+};
+
+}  // namespace musicsheetflow
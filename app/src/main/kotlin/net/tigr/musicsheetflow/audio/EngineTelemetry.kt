@@ -0,0 +1,132 @@
+package net.tigr.musicsheetflow.audio
+
+import dalvik.annotation.optimization.CriticalNative
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import javax.inject.Inject
+import javax.inject.Singleton
+
+/**
+ * Microphone analysis, as of the last analysis window
+ */
+data class InputTelemetry(
+    val gateOpen: Boolean,
+    val rms: Float,              // Linear, 0.0-1.0
+    val peak: Float,             // Highest |sample| since the previous window
+    val frequency: Float,        // Hz, 0 without a pitch
+    val confidence: Float,       // 0 without a pitch
+    val analysisLoad: Float,     // Callback time as a share of the audio it took in
+    val xruns: Int,              // Input overruns since the stream opened
+    val latencyMs: Float,        // Input stream latency, 0 if unknown
+    val timestampNs: Long,       // System.nanoTime() of the window
+    val hasSpectrum: Boolean     // The spectrum array passed to read was filled
+)
+
+/**
+ * Synth output, updated about ten times a second
+ */
+data class OutputTelemetry(
+    val activeVoices: Int,
+    val renderLoad: Float,       // Callback time as a share of its period, smoothed
+    val xruns: Int,              // Output underruns since the stream opened
+    val latencyMs: Float,
+    val peak: Float,             // Highest output sample since the previous update
+    val frame: Long              // Output frames played
+)
+
+/**
+ * Engine state published by the native audio callbacks into shared memory
+ * (EngineTelemetry in telemetry.h). Each read takes one @CriticalNative
+ * call, which copies the block under its seqlock into a snapshot that is
+ * then read with plain memory loads, so a level meter, spectrum or debug
+ * overlay can poll it every frame. (Kotlin cannot order its own loads
+ * against the seqlock below API 33.) The spectrum is only published while
+ * [NativeAudioEngine.setSpectrumEnabled] is on.
+ */
+@Singleton
+class EngineTelemetry @Inject constructor() {
+
+    companion object {
+        const val SPECTRUM_BANDS = 64      // Log-spaced, 50 Hz - 8 kHz, in dBFS
+
+        // InputTelemetry field offsets
+        private const val INPUT_GATE_OPEN = 4
+        private const val INPUT_RMS = 8
+        private const val INPUT_PEAK = 12
+        private const val INPUT_FREQUENCY = 16
+        private const val INPUT_CONFIDENCE = 20
+        private const val INPUT_ANALYSIS_LOAD = 24
+        private const val INPUT_XRUNS = 28
+        private const val INPUT_LATENCY = 32
+        private const val INPUT_SPECTRUM_VALID = 36
+        private const val INPUT_TIMESTAMP = 40
+        private const val INPUT_SPECTRUM = 48
+
+        // OutputTelemetry field offsets
+        private const val OUTPUT_ACTIVE_VOICES = 308
+        private const val OUTPUT_RENDER_LOAD = 312
+        private const val OUTPUT_XRUNS = 316
+        private const val OUTPUT_LATENCY = 320
+        private const val OUTPUT_PEAK = 324
+        private const val OUTPUT_FRAME = 328
+
+        init {
+            System.loadLibrary("musicsheetflow_native")
+        }
+
+        @JvmStatic @CriticalNative
+        private external fun nativeSnapshotInput()
+
+        @JvmStatic @CriticalNative
+        private external fun nativeSnapshotOutput()
+    }
+
+    private val block: ByteBuffer = nativeGetBuffer().order(ByteOrder.nativeOrder())
+
+    /**
+     * Read the latest input analysis. Never blocks the callback; the copy
+     * retries while the callback is in the middle of an update. Readers on
+     * several threads take turns on the one snapshot.
+     * @param spectrum Filled with [SPECTRUM_BANDS] band levels when published
+     */
+    @Synchronized
+    fun readInput(spectrum: FloatArray? = null): InputTelemetry {
+        nativeSnapshotInput()
+        val hasSpectrum = spectrum != null && block.getInt(INPUT_SPECTRUM_VALID) != 0
+        if (spectrum != null && hasSpectrum) {
+            for (band in 0 until minOf(SPECTRUM_BANDS, spectrum.size)) {
+                spectrum[band] = block.getFloat(INPUT_SPECTRUM + band * 4)
+            }
+        }
+        return InputTelemetry(
+            gateOpen = block.getInt(INPUT_GATE_OPEN) != 0,
+            rms = block.getFloat(INPUT_RMS),
+            peak = block.getFloat(INPUT_PEAK),
+            frequency = block.getFloat(INPUT_FREQUENCY),
+            confidence = block.getFloat(INPUT_CONFIDENCE),
+            analysisLoad = block.getFloat(INPUT_ANALYSIS_LOAD),
+            xruns = block.getInt(INPUT_XRUNS),
+            latencyMs = block.getFloat(INPUT_LATENCY),
+            timestampNs = block.getLong(INPUT_TIMESTAMP),
+            hasSpectrum = hasSpectrum
+        )
+    }
+
+    /**
+     * Read the latest output state, like [readInput]
+     */
+    @Synchronized
+    fun readOutput(): OutputTelemetry {
+        nativeSnapshotOutput()
+        return OutputTelemetry(
+            activeVoices = block.getInt(OUTPUT_ACTIVE_VOICES),
+            renderLoad = block.getFloat(OUTPUT_RENDER_LOAD),
+            xruns = block.getInt(OUTPUT_XRUNS),
+            latencyMs = block.getFloat(OUTPUT_LATENCY),
+            peak = block.getFloat(OUTPUT_PEAK),
+            frame = block.getLong(OUTPUT_FRAME)
+        )
+    }
+
+    private external fun nativeGetBuffer(): ByteBuffer
+}
@@ -0,0 +1,87 @@
+package net.tigr.musicsheetflow.audio
+
+import java.nio.ByteBuffer
+
+/**
+ * Packs synth commands into the native command buffer, so a chord, a
+ * glissando step or a run of scheduled notes crosses JNI once.
+ *
+ * Records follow MidiCommand in midi_command.h. Use it through
+ * [NativeMidiEngine.commands], which serializes writers and submits the
+ * batch; a batch larger than the buffer goes out in several submits.
+ * Invalid channels and notes are dropped natively.
+ */
+class MidiCommandBuffer internal constructor(
+    private val buffer: ByteBuffer,
+    private val submit: (Int) -> Unit
+) {
+    private val capacity = buffer.capacity() / RECORD_BYTES
+    private var count = 0
+
+    /**
+     * Start a note now, or on an exact output frame
+     * @param frame Target frame on the output clock; past frames play immediately
+     */
+    fun noteOn(channel: Int, note: Int, velocity: Float, frame: Long = IMMEDIATE) {
+        put(TYPE_NOTE_ON, channel, note, velocity, frame)
+    }
+
+    /**
+     * Release a note now, or on an exact output frame
+     */
+    fun noteOff(channel: Int, note: Int, frame: Long = IMMEDIATE) {
+        put(TYPE_NOTE_OFF, channel, note, 0f, frame)
+    }
+
+    /**
+     * Stop all sounding notes and cancel scheduled ones queued before it
+     */
+    fun allNotesOff() {
+        put(TYPE_ALL_NOTES_OFF, 0, 0, 0f, IMMEDIATE)
+    }
+
+    /**
+     * Set the output volume (0.0 - 1.0)
+     */
+    fun setVolume(volume: Float) {
+        put(TYPE_SET_VOLUME, 0, 0, volume, IMMEDIATE)
+    }
+
+    internal fun flush() {
+        if (count > 0) {
+            submit(count)
+            count = 0
+        }
+    }
+
+    private fun put(type: Int, channel: Int, data1: Int, value: Float, frame: Long) {
+        if (count == capacity) flush()
+        val offset = count * RECORD_BYTES
+        buffer.put(offset + OFFSET_TYPE, type.toByte())
+        buffer.put(offset + OFFSET_CHANNEL, channel.toByte())
+        buffer.putShort(offset + OFFSET_DATA1, data1.toShort())
+        buffer.putShort(offset + OFFSET_DATA2, 0)
+        buffer.putFloat(offset + OFFSET_VALUE, value)
+        buffer.putLong(offset + OFFSET_FRAME, frame)
+        count++
+    }
+
+    companion object {
+        const val IMMEDIATE = 0L
+
+        // MidiCommand layout
+        private const val RECORD_BYTES = 24
+        private const val OFFSET_TYPE = 0
+        private const val OFFSET_CHANNEL = 1
+        private const val OFFSET_DATA1 = 2
+        private const val OFFSET_DATA2 = 4
+        private const val OFFSET_VALUE = 8
+        private const val OFFSET_FRAME = 16
+
+        // MidiCommand::Type
+        private const val TYPE_NOTE_ON = 0
+        private const val TYPE_NOTE_OFF = 1
+        private const val TYPE_ALL_NOTES_OFF = 2
+        private const val TYPE_SET_VOLUME = 4
+    }
+}
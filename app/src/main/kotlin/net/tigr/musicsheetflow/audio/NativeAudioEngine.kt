@@ -1,6 +1,7 @@
 package net.tigr.musicsheetflow.audio
 
 import android.util.Log
+import dalvik.annotation.optimization.CriticalNative
 import kotlinx.coroutines.flow.MutableSharedFlow
 import kotlinx.coroutines.flow.SharedFlow
 import kotlinx.coroutines.flow.asSharedFlow
@@ -12,7 +13,9 @@ data class PitchEvent(
     val confidence: Float,
     val midiNote: Int,
     val centDeviation: Int,
-    val timestampNs: Long
+    val timestampNs: Long,       // System.nanoTime() when detection finished
+    val captureNs: Long = 0,     // When the analyzed sound reached the microphone
+    val deliveredNs: Long = 0    // When the event reached Kotlin
 ) {
     /**
      * Get note name from MIDI note number using locale-aware naming.
@@ -28,19 +31,71 @@ interface PitchCallback {
         confidence: Float,
         midiNote: Int,
         centDeviation: Int,
-        timestampNs: Long
+        timestampNs: Long,
+        captureNs: Long
     )
 }
 
+/**
+ * Stages of a pitch event from the microphone to the UI (LatencyStage in
+ * latency_stats.h)
+ */
+enum class LatencyStage {
+    BUFFERING,   // Sound captured -> detection starts (window fill + input latency)
+    DETECTION,   // Pitch detection
+    DELIVERY,    // Detection done -> Kotlin callback (JNI)
+    DISPATCH,    // Kotlin callback -> consumed by the UI collector
+    TOTAL        // Captured -> consumed
+}
+
+/**
+ * Latency distribution of one stage, in milliseconds
+ */
+data class StageLatency(
+    val stage: LatencyStage,
+    val count: Long,
+    val meanMs: Double,
+    val maxMs: Double,
+    val p50Ms: Double,
+    val p90Ms: Double,
+    val p99Ms: Double,
+    val p999Ms: Double
+)
+
+/**
+ * Per-stage latency since the last reset. Percentiles are kept within
+ * 1/16 of their value (see LatencyHistogram).
+ */
+data class LatencyReport(val stages: List<StageLatency>) {
+    val total: StageLatency get() = stages[LatencyStage.TOTAL.ordinal]
+
+    /** True while 99% of events reach the UI within [budgetMs] */
+    fun withinBudget(budgetMs: Double = LATENCY_BUDGET_MS): Boolean = total.p99Ms <= budgetMs
+
+    override fun toString(): String = stages.joinToString("\n") {
+        "%-9s n=%d mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f ms".format(
+            it.stage.name, it.count, it.meanMs, it.p50Ms, it.p90Ms, it.p99Ms, it.p999Ms, it.maxMs)
+    }
+
+    companion object {
+        const val LATENCY_BUDGET_MS = 100.0   // Sound to visual feedback (ARCHITECTURE.md)
+    }
+}
+
 @Singleton
 class NativeAudioEngine @Inject constructor() {
 
     companion object {
         private const val TAG = "NativeAudioEngine"
+        private const val LATENCY_FIELDS = 7   // Per stage in nativeGetLatencyStats
 
         init {
             System.loadLibrary("musicsheetflow_native")
         }
+
+        // Registered in JNI_OnLoad; runs for every pitch event
+        @JvmStatic @CriticalNative
+        private external fun nativeRecordLatency(stage: Int, nanos: Long)
     }
 
     private val _pitchEvents = MutableSharedFlow<PitchEvent>(extraBufferCapacity = 64)
@@ -52,10 +107,13 @@ class NativeAudioEngine @Inject constructor() {
             confidence: Float,
             midiNote: Int,
             centDeviation: Int,
-            timestampNs: Long
+            timestampNs: Long,
+            captureNs: Long
         ) {
+            val now = System.nanoTime()
+            nativeRecordLatency(LatencyStage.DELIVERY.ordinal, now - timestampNs)
             _pitchEvents.tryEmit(
-                PitchEvent(frequency, confidence, midiNote, centDeviation, timestampNs)
+                PitchEvent(frequency, confidence, midiNote, centDeviation, timestampNs, captureNs, now)
             )
         }
     }
@@ -90,10 +148,48 @@ class NativeAudioEngine @Inject constructor() {
         nativeSetSilenceThreshold(thresholdDb.coerceIn(-70f, -20f))
     }
 
+    /**
+     * Record that the UI has consumed a pitch event, closing its latency
+     * measurement. Call it first thing where the event is collected.
+     */
+    fun recordConsumed(event: PitchEvent) {
+        val now = System.nanoTime()
+        if (event.deliveredNs > 0) {
+            nativeRecordLatency(LatencyStage.DISPATCH.ordinal, now - event.deliveredNs)
+        }
+        if (event.captureNs > 0) {
+            nativeRecordLatency(LatencyStage.TOTAL.ordinal, now - event.captureNs)
+        }
+    }
+
+    /**
+     * Latency percentiles per stage since the last reset
+     * @param reset Start a new measurement period after reading
+     */
+    fun getLatencyReport(reset: Boolean = false): LatencyReport {
+        val values = nativeGetLatencyStats(reset)
+        val stages = LatencyStage.entries.map { stage ->
+            val i = stage.ordinal * LATENCY_FIELDS
+            StageLatency(stage, values[i].toLong(), values[i + 1], values[i + 2],
+                values[i + 3], values[i + 4], values[i + 5], values[i + 6])
+        }
+        return LatencyReport(stages)
+    }
+
+    /**
+     * Publish the input spectrum to [EngineTelemetry]. Off by default: it
+     * costs an FFT per analysis window, so enable it only while shown.
+     */
+    fun setSpectrumEnabled(enabled: Boolean) {
+        nativeSetSpectrumEnabled(enabled)
+    }
+
     private external fun nativeStart(): Boolean
     private external fun nativeStop()
     private external fun nativeSetNoiseGate(thresholdDb: Float)
     private external fun nativeSetConfidenceThreshold(threshold: Float)
     private external fun nativeSetSilenceThreshold(thresholdDb: Float)
+    private external fun nativeSetSpectrumEnabled(enabled: Boolean)
+    private external fun nativeGetLatencyStats(reset: Boolean): DoubleArray
     private external fun nativeSetCallback(callback: PitchCallback?)
 }
@@ -1,44 +1,174 @@
 package net.tigr.musicsheetflow.audio
 
 import android.content.Context
+import android.content.res.AssetManager
 import android.util.Log
+import dalvik.annotation.optimization.CriticalNative
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.withContext
 import java.io.File
-import java.io.FileOutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Snapshot of the native sequencer playhead.
+ */
+data class SequencerPosition(
+    val isPlaying: Boolean,
+    val beat: Double,
+    val frame: Long,
+    val noteIndex: Int,   // Last started note, -1 before the first
+    val tempo: Float
+)
+
+/**
+ * Metronome beat with its exact output time. Negative beats are count-in.
+ */
+data class MetronomeBeat(
+    val beat: Int,
+    val frame: Long,
+    val timestampNs: Long   // System.nanoTime() clock, when the click is heard
+)
+
+/**
+ * Mean cost of rendering one 192-frame block, serially and across the
+ * render workers. Workers is 0 when the device is not multi-core enough.
+ */
+data class RenderBenchmark(
+    val voices: Int,
+    val workers: Int,
+    val serialMicros: Double,
+    val parallelMicros: Double
+)
+
+/**
+ * Sample memory of one SoundFont preset. Mapped fonts page samples in when
+ * a channel selects the preset, so unused presets stay out of RAM.
+ */
+data class PresetMemory(
+    val bank: Int,
+    val preset: Int,
+    val sampleBytes: Long,
+    val residentBytes: Long
+)
+
+/**
+ * Synth voice pool usage. Notes beyond the pool steal a voice (quietest
+ * releasing one first, then the oldest on the same key, then the oldest).
+ */
+data class VoiceStats(
+    val active: Int,
+    val peak: Int,      // Since the last reset
+    val stolen: Int,
+    val capacity: Int
+)
+
+/**
+ * Synth render time against its budget. Level counts the savings in effect:
+ * 0 full quality, 1 inaudible release tails cut, 2 quiet voices unfiltered,
+ * 3 half the voice pool, 4 nearest-sample playback.
+ */
+data class RenderLoad(
+    val level: Int,
+    val load: Double,       // Smoothed share of the callback period
+    val peakLoad: Double,   // Slowest callback since the last reset
+    val budget: Double,
+    val overBudget: Long,   // Callbacks that took longer than the budget
+    val degraded: Long,
+    val restored: Long,
+    val culledVoices: Long
+)
+
+/**
+ * Output mixer buses. Notes played with [NativeMidiEngine.noteOn] sound on
+ * KEYBOARD; the sequencer, scheduled notes and woodblock clicks on SCORE;
+ * the synthesized metronome click on CLICK.
+ */
+enum class MixBus(val id: Int) {
+    SCORE(0),
+    KEYBOARD(1),
+    CLICK(2)
+}
+
+/**
+ * Level and render cost of one mixer bus since the last reset.
+ */
+data class BusStats(
+    val gain: Double,
+    val pan: Double,
+    val peak: Double,   // Highest sample after gain, 1.0 = full scale
+    val load: Double    // Render time as a share of the audio it produced
+)
+
+data class MixStats(
+    val buses: Map<MixBus, BusStats>,
+    val limiterGain: Double   // Lowest gain the output limiter applied, 1.0 = untouched
+)
+
+/**
+ * Tempo in force from [beat] on. With [ramp] the tempo glides to the next
+ * change's tempo instead of holding until it.
+ */
+data class TempoChange(
+    val beat: Double,
+    val bpm: Float,
+    val ramp: Boolean = false
+)
+
+/**
+ * A MIDI file as the native sequencer plays it. Note arrays are indexed by
+ * note in onset order, like the arguments of [NativeMidiEngine.loadSequence],
+ * so the playhead's note index points into them.
+ */
+class MidiSequence(
+    val onsetBeats: DoubleArray,
+    val durationBeats: FloatArray,
+    val notes: IntArray,
+    val velocities: FloatArray,
+    val channels: IntArray,
+    val tempos: List<TempoChange>,   // Starts at beat 0
+    val programs: IntArray,          // GM program per channel, -1 where no notes play
+    val lengthBeats: Double
+)
+
+enum class MetronomeSound(val id: Int) {
+    SYNTH(0),       // Sine click mixed into the output
+    WOODBLOCK(1)    // SoundFont percussion woodblock
+}
 
 class NativeMidiEngine {
 
     private var isStarted = false
 
+    // Reused by pollMetronomeBeats
+    private val beatBuffer = IntArray(BEAT_POLL_CAPACITY)
+    private val beatFrameBuffer = LongArray(BEAT_POLL_CAPACITY)
+    private val beatTimeBuffer = LongArray(BEAT_POLL_CAPACITY)
+
     /**
-     * Load a SoundFont file from the given path
+     * Load a SoundFont file from the given path: an .sf2, or a .tsfb baked
+     * from one by the native soundfont_bake tool. Parsing runs on the IO
+     * dispatcher while playback continues; the new font takes over between
+     * two audio callbacks and notes already sounding finish on the old one.
      */
-    fun loadSoundFont(path: String): Boolean {
-        return nativeLoadSoundFont(path)
+    suspend fun loadSoundFont(path: String): Boolean = withContext(Dispatchers.IO) {
+        nativeLoadSoundFont(path)
     }
 
     /**
-     * Load the bundled SoundFont from assets
+     * Load the bundled SoundFont from assets, off the main thread like
+     * [loadSoundFont]. The APK stores it uncompressed (see noCompress in
+     * build.gradle.kts), so the engine maps it in place.
      */
-    fun loadBundledSoundFont(context: Context): Boolean {
-        return try {
-            // Copy from assets to cache directory (TSF needs file path)
-            val cacheFile = File(context.cacheDir, "TimGM6mb.sf2")
-
-            if (!cacheFile.exists()) {
-                Log.i(TAG, "Copying SoundFont to cache...")
-                context.assets.open("soundfonts/TimGM6mb.sf2").use { input ->
-                    FileOutputStream(cacheFile).use { output ->
-                        input.copyTo(output)
-                    }
-                }
-                Log.i(TAG, "SoundFont copied: ${cacheFile.absolutePath}")
-            }
+    suspend fun loadBundledSoundFont(context: Context): Boolean = withContext(Dispatchers.IO) {
+        // Earlier versions copied the font to the cache directory first
+        File(context.cacheDir, BUNDLED_SOUNDFONT_CACHE_NAME).delete()
 
-            loadSoundFont(cacheFile.absolutePath)
-        } catch (e: Exception) {
-            Log.e(TAG, "Failed to load bundled SoundFont", e)
-            false
+        val loaded = nativeLoadSoundFontAsset(context.assets, BUNDLED_SOUNDFONT_ASSET)
+        if (!loaded) {
+            Log.e(TAG, "Failed to load bundled SoundFont")
         }
+        loaded
     }
 
     /**
@@ -66,39 +196,52 @@ class NativeMidiEngine {
      * @param velocity Note velocity 0.0-1.0
      */
     fun noteOn(note: Int, velocity: Float = 0.8f) {
-        nativeNoteOn(note, velocity)
+        commands { noteOn(0, note, velocity) }
     }
 
     /**
      * Stop a note
      */
     fun noteOff(note: Int) {
-        nativeNoteOff(note)
+        commands { noteOff(0, note) }
     }
 
     /**
-     * Stop all currently playing notes
+     * Stop all currently playing notes and cancel scheduled ones
      */
     fun allNotesOff() {
-        nativeAllNotesOff()
+        commands { allNotesOff() }
     }
 
     /**
-     * Play multiple notes simultaneously (single mutex lock for better performance)
+     * Play multiple notes simultaneously (single JNI call, applied in the same render callback)
      * @param notes List of Pair(midiNote, velocity)
      */
     fun batchNoteOn(notes: List<Pair<Int, Float>>) {
         if (notes.isEmpty()) return
-        val noteArray = notes.map { it.first }.toIntArray()
-        val velocityArray = notes.map { it.second }.toFloatArray()
-        nativeBatchNoteOn(noteArray, velocityArray)
+        commands {
+            for ((note, velocity) in notes) noteOn(0, note, velocity)
+        }
+    }
+
+    /**
+     * Queue several synth commands with one native call, e.g. a chord, or the
+     * note-off and next note-on of a glissando. Commands in one batch reach
+     * the audio thread together, so its notes start in the same callback.
+     */
+    inline fun commands(block: MidiCommandBuffer.() -> Unit) {
+        val buffer = commandBuffer
+        synchronized(buffer) {
+            buffer.block()
+            buffer.flush()
+        }
     }
 
     /**
      * Set the output volume (0.0 - 1.0)
      */
     fun setVolume(volume: Float) {
-        nativeSetVolume(volume.coerceIn(0f, 1f))
+        commands { setVolume(volume.coerceIn(0f, 1f)) }
     }
 
     /**
@@ -108,18 +251,19 @@ class NativeMidiEngine {
      * @param velocity Note velocity 0.0-1.0
      */
     fun noteOnChannel(channel: Int, note: Int, velocity: Float = 0.8f) {
-        nativeNoteOnChannel(channel, note, velocity)
+        commands { noteOn(channel, note, velocity) }
     }
 
     /**
      * Stop a note on a specific MIDI channel
      */
     fun noteOffChannel(channel: Int, note: Int) {
-        nativeNoteOffChannel(channel, note)
+        commands { noteOff(channel, note) }
     }
 
     /**
-     * Set the instrument preset for a MIDI channel
+     * Set the instrument preset for a MIDI channel. Pages the preset's samples
+     * in before returning; presets other than piano and drums may block on I/O.
      * @param channel MIDI channel (0-15)
      * @param preset GM preset number (0-127)
      * @param bank Bank number (usually 0 for GM)
@@ -128,6 +272,362 @@ class NativeMidiEngine {
         nativeSetChannelPreset(channel, preset, bank)
     }
 
+    /**
+     * Current position of the output frame clock (frames rendered since the
+     * engine was created). Scheduled events use this timeline.
+     */
+    fun getFramePosition(): Long = nativeGetFramePosition()
+
+    /**
+     * Output sample rate, for converting between frames and time
+     */
+    fun getSampleRate(): Int = nativeGetSampleRate()
+
+    /**
+     * Output latency in milliseconds: time from rendering a frame to hearing
+     * it. Shrinks to the smallest glitch-free buffer while the engine runs.
+     */
+    fun getOutputLatencyMs(): Double = nativeGetOutputLatencyMillis()
+
+    /**
+     * Per-preset sample memory of the loaded SoundFont
+     */
+    fun getPresetMemory(): List<PresetMemory> {
+        val values = nativeGetPresetMemory()
+        return List(values.size / 4) {
+            PresetMemory(values[it * 4].toInt(), values[it * 4 + 1].toInt(), values[it * 4 + 2], values[it * 4 + 3])
+        }
+    }
+
+    /**
+     * Size the synth voice pool (8-256, default 64). A resized synth takes
+     * over like a newly loaded font, so this is safe during playback.
+     */
+    fun setMaxVoices(voices: Int) = nativeSetMaxVoices(voices)
+
+    /**
+     * Voice pool usage; resetPeak starts a new peak measurement.
+     */
+    fun getVoiceStats(resetPeak: Boolean = false): VoiceStats {
+        val values = nativeGetVoiceStats(resetPeak)
+        return VoiceStats(values[0], values[1], values[2], values[3])
+    }
+
+    /**
+     * Share of each audio callback the synth may spend rendering (0.25-1.0,
+     * default 0.75). Above it the synth steps its quality down, and steps
+     * back up once load stays low for a couple of seconds.
+     */
+    fun setRenderBudget(fraction: Float) = nativeSetRenderBudget(fraction)
+
+    /**
+     * Render load and the quality steps taken for it; resetPeak starts a new
+     * peak measurement.
+     */
+    fun getRenderLoad(resetPeak: Boolean = false): RenderLoad {
+        val v = nativeGetRenderLoad(resetPeak)
+        return RenderLoad(
+            v[0].toInt(), v[1], v[2], v[3],
+            v[4].toLong(), v[5].toLong(), v[6].toLong(), v[7].toLong()
+        )
+    }
+
+    /**
+     * Bus volume (0.0-2.0, default 1.0); changes glide over 10 ms.
+     */
+    fun setBusGain(bus: MixBus, gain: Float) = nativeSetBusGain(bus.id, gain)
+
+    /**
+     * Bus balance from -1.0 (left) to 1.0 (right), default centred.
+     */
+    fun setBusPan(bus: MixBus, pan: Float) = nativeSetBusPan(bus.id, pan)
+
+    /**
+     * Per-bus levels and render cost, and how hard the output limiter has
+     * worked; reset starts a new measurement.
+     */
+    fun getMixStats(reset: Boolean = false): MixStats {
+        val v = nativeGetMixStats(reset)
+        val buses = MixBus.entries.associateWith {
+            val i = it.id * 4
+            BusStats(v[i], v[i + 1], v[i + 2], v[i + 3])
+        }
+        return MixStats(buses, v[v.size - 1])
+    }
+
+    /**
+     * Render dense polyphony on worker threads as well as the audio thread.
+     * @return true if enabled; devices with fewer than four cores stay serial
+     */
+    fun setParallelRender(enabled: Boolean): Boolean = nativeSetParallelRender(enabled)
+
+    /**
+     * Render scheduled playback this many bursts ahead on a synth thread
+     * (0-8, default 0: render in the audio callback). 2-4 rides out render
+     * spikes on weak devices for a few ms more playback latency; notes played
+     * with [noteOn] stay immediate. Takes effect at the next [start].
+     */
+    fun setRenderAhead(bursts: Int) = nativeSetRenderAhead(bursts)
+
+    /**
+     * Time rendering `voices` held notes with and without the render workers.
+     * Runs on a copy of the synth for about a second; call off the main thread.
+     */
+    fun benchmarkRender(voices: Int = 48): RenderBenchmark {
+        val result = DoubleArray(4)
+        nativeBenchmarkRender(voices, result)
+        return RenderBenchmark(result[0].toInt(), result[1].toInt(), result[2], result[3])
+    }
+
+    /**
+     * Start a note on an exact output frame
+     * @param frame Target frame on the output clock; past frames play immediately
+     */
+    fun scheduleNoteOn(channel: Int, note: Int, velocity: Float, frame: Long) {
+        commands { noteOn(channel, note, velocity, frame) }
+    }
+
+    /**
+     * Release a note on an exact output frame
+     */
+    fun scheduleNoteOff(channel: Int, note: Int, frame: Long) {
+        commands { noteOff(channel, note, frame) }
+    }
+
+    /**
+     * Load a compiled score into the native sequencer, replacing the
+     * previous one. All arrays are indexed by note; onsets are in beats.
+     */
+    fun loadSequence(
+        onsetBeats: DoubleArray,
+        durationBeats: FloatArray,
+        notes: IntArray,
+        velocities: FloatArray,
+        channels: IntArray
+    ) {
+        nativeLoadSequence(onsetBeats, durationBeats, notes, velocities, channels)
+    }
+
+    /**
+     * Load a Standard MIDI File (.mid) into the native sequencer, replacing
+     * the previous sequence. The file is parsed natively and never crosses
+     * JNI per message; channels get the file's programs and the tempo map its
+     * tempo changes.
+     * @return The notes as loaded, or null if the file cannot be read
+     */
+    suspend fun loadMidiFile(data: ByteArray): MidiSequence? = withContext(Dispatchers.IO) {
+        val values = nativeLoadMidiFile(data) ?: return@withContext null
+        val noteCount = values[0].toInt()
+        val tempoCount = values[1].toInt()
+        val tempoBase = 3 + MIDI_CHANNELS
+        val noteBase = tempoBase + tempoCount * 2
+        MidiSequence(
+            onsetBeats = DoubleArray(noteCount) { values[noteBase + it * 5] },
+            durationBeats = FloatArray(noteCount) { values[noteBase + it * 5 + 1].toFloat() },
+            notes = IntArray(noteCount) { values[noteBase + it * 5 + 2].toInt() },
+            velocities = FloatArray(noteCount) { values[noteBase + it * 5 + 3].toFloat() },
+            channels = IntArray(noteCount) { values[noteBase + it * 5 + 4].toInt() },
+            tempos = List(tempoCount) {
+                TempoChange(values[tempoBase + it * 2], values[tempoBase + it * 2 + 1].toFloat())
+            },
+            programs = IntArray(MIDI_CHANNELS) { values[3 + it].toInt() },
+            lengthBeats = values[2]
+        )
+    }
+
+    /**
+     * Render a compiled score (arrays as for loadSequence) with the loaded
+     * SoundFont, without the output stream and far faster than real time.
+     * Long scores render in parallel chunks. Blocks until done; call off the
+     * main thread.
+     * @param programs GM program per channel, piano when null; channel 9 plays drum kits
+     * @return Stereo interleaved samples, or null without a SoundFont or notes
+     */
+    fun renderOffline(
+        onsetBeats: DoubleArray,
+        durationBeats: FloatArray,
+        notes: IntArray,
+        velocities: FloatArray,
+        channels: IntArray,
+        tempo: Float,
+        sampleRate: Int = 44100,
+        programs: IntArray? = null
+    ): FloatArray? {
+        return nativeRenderOffline(onsetBeats, durationBeats, notes, velocities, channels, tempo, sampleRate, programs)
+    }
+
+    /**
+     * Same as renderOffline, written to a stereo WAV file
+     * @param floatSamples 32-bit float samples instead of 16-bit PCM
+     * @return true if the file was written
+     */
+    fun renderOfflineToWav(
+        onsetBeats: DoubleArray,
+        durationBeats: FloatArray,
+        notes: IntArray,
+        velocities: FloatArray,
+        channels: IntArray,
+        tempo: Float,
+        path: String,
+        sampleRate: Int = 44100,
+        programs: IntArray? = null,
+        floatSamples: Boolean = false
+    ): Boolean {
+        return nativeRenderOfflineWav(
+            onsetBeats, durationBeats, notes, velocities, channels, tempo, sampleRate, programs, path, floatSamples
+        )
+    }
+
+    /**
+     * Start or resume the sequencer from its current position
+     */
+    fun sequencerPlay() {
+        nativeSequencerPlay()
+    }
+
+    /**
+     * Pause the sequencer, releasing its sounding notes
+     */
+    fun sequencerPause() {
+        nativeSequencerPause()
+    }
+
+    /**
+     * Stop the sequencer and rewind to the first note
+     */
+    fun sequencerStop() {
+        nativeSequencerStop()
+    }
+
+    /**
+     * Move the sequencer to a beat position (keeps playing if it was)
+     */
+    fun sequencerSeek(beat: Double) {
+        nativeSequencerSeek(beat)
+    }
+
+    /**
+     * Play the tempo map at a speed that opens at [bpm]; later tempo changes
+     * keep their proportion. Shared with the metronome and takes effect at
+     * the next render block.
+     */
+    fun sequencerSetTempo(bpm: Float) {
+        nativeSequencerSetTempo(bpm)
+    }
+
+    /**
+     * Replace the tempo map shared by the sequencer and the metronome, in
+     * score beats from beat 0. The map plays as written until the tempo or
+     * scale is changed; the first change applies from beat 0 and to the
+     * count-in. Positions are kept in beats, so nothing is rescheduled.
+     */
+    fun setTempoMap(changes: List<TempoChange>) {
+        nativeSetTempoMap(
+            DoubleArray(changes.size) { changes[it].beat },
+            FloatArray(changes.size) { changes[it].bpm },
+            BooleanArray(changes.size) { changes[it].ramp }
+        )
+    }
+
+    /**
+     * Practice speed: 1.0 plays the tempo map as written, 0.5 at half speed
+     */
+    fun setTempoScale(scale: Float) {
+        nativeSetTempoScale(scale)
+    }
+
+    /**
+     * Loop playback between two beat positions
+     */
+    fun sequencerSetLoop(startBeat: Double, endBeat: Double) {
+        nativeSequencerSetLoop(startBeat, endBeat)
+    }
+
+    /**
+     * Play through to the end instead of looping
+     */
+    fun sequencerClearLoop() {
+        nativeSequencerClearLoop()
+    }
+
+    /**
+     * Read the playhead published by the audio thread. One critical native
+     * call copies it under its seqlock (Kotlin cannot order its own loads
+     * against it below API 33); the audio thread never waits on the reader.
+     */
+    fun readSequencerPosition(): SequencerPosition {
+        val buffer = playhead
+        synchronized(buffer) {
+            nativeSnapshotPlayhead()
+            return SequencerPosition(
+                isPlaying = buffer.getInt(PLAYHEAD_PLAYING) != 0,
+                beat = buffer.getDouble(PLAYHEAD_BEAT),
+                frame = buffer.getLong(PLAYHEAD_FRAME),
+                noteIndex = buffer.getInt(PLAYHEAD_NOTE_INDEX),
+                tempo = buffer.getFloat(PLAYHEAD_TEMPO)
+            )
+        }
+    }
+
+    /**
+     * Start the native metronome at the next audio callback
+     * @param countInBeats Beats numbered -countInBeats..-1 before beat 0; always audible
+     */
+    fun metronomeStart(countInBeats: Int = 0) {
+        nativeMetronomeStart(countInBeats)
+    }
+
+    /**
+     * Stop the native metronome
+     */
+    fun metronomeStop() {
+        nativeMetronomeStop()
+    }
+
+    /**
+     * Same as [sequencerSetTempo]; the current beat is stretched, not restarted
+     */
+    fun metronomeSetTempo(bpm: Float) {
+        nativeMetronomeSetTempo(bpm)
+    }
+
+    /**
+     * When a metronome beat is heard, through the tempo map from the latest
+     * rendered position, on the System.nanoTime() clock. Fractional beats
+     * time notes between clicks.
+     * @return null while the metronome is stopped
+     */
+    fun metronomeBeatTimeNanos(beat: Double): Long? {
+        val time = nativeMetronomeBeatTimeNanos(beat)
+        return if (time < 0) null else time
+    }
+
+    /**
+     * Set the meter used for the accented downbeat
+     */
+    fun metronomeSetBeatsPerMeasure(beats: Int) {
+        nativeMetronomeSetBeatsPerMeasure(beats)
+    }
+
+    fun metronomeSetSound(sound: MetronomeSound) {
+        nativeMetronomeSetSound(sound.id)
+    }
+
+    /**
+     * Click on beats after the count-in (beats are reported either way)
+     */
+    fun metronomeSetAudible(audible: Boolean) {
+        nativeMetronomeSetAudible(audible)
+    }
+
+    /**
+     * Collect metronome beats rendered since the last call
+     */
+    fun pollMetronomeBeats(): List<MetronomeBeat> {
+        val count = nativePollBeatEvents(beatBuffer, beatFrameBuffer, beatTimeBuffer)
+        return List(count) { MetronomeBeat(beatBuffer[it], beatFrameBuffer[it], beatTimeBuffer[it]) }
+    }
+
     /**
      * Play a metronome click using percussion channel
      * Uses woodblock (MIDI note 76/77) for click sound
@@ -136,30 +636,129 @@ class NativeMidiEngine {
     fun playMetronomeClick(isDownbeat: Boolean = false) {
         val note = if (isDownbeat) HIGH_WOODBLOCK else LOW_WOODBLOCK
         val velocity = if (isDownbeat) 1.0f else 0.7f
-        nativeNoteOnChannel(PERCUSSION_CHANNEL, note, velocity)
+        commands { noteOn(PERCUSSION_CHANNEL, note, velocity) }
     }
 
     companion object {
         private const val TAG = "NativeMidiEngine"
+        private const val BUNDLED_SOUNDFONT_ASSET = "soundfonts/TimGM6mb.sf2"
+        private const val BUNDLED_SOUNDFONT_CACHE_NAME = "TimGM6mb.sf2"
         private const val PERCUSSION_CHANNEL = 9  // GM percussion channel
         private const val LOW_WOODBLOCK = 76      // GM percussion note
         private const val HIGH_WOODBLOCK = 77     // GM percussion note (accented)
 
+        private const val BEAT_POLL_CAPACITY = 64
+        private const val MIDI_CHANNELS = 16
+
+        // SequencerPlayhead field offsets
+        private const val PLAYHEAD_PLAYING = 4
+        private const val PLAYHEAD_BEAT = 8
+        private const val PLAYHEAD_FRAME = 16
+        private const val PLAYHEAD_NOTE_INDEX = 24
+        private const val PLAYHEAD_TEMPO = 28
+
         init {
             System.loadLibrary("musicsheetflow_native")
         }
+
+        // Native command buffer, shared by every engine instance as the
+        // native side has one; also the lock that serializes its writers
+        @PublishedApi
+        internal val commandBuffer: MidiCommandBuffer by lazy {
+            MidiCommandBuffer(nativeGetCommandBuffer().order(ByteOrder.nativeOrder())) {
+                nativeSubmitCommands(it)
+            }
+        }
+
+        // Copy of the playhead that nativeSnapshotPlayhead fills, one for
+        // the process like the native side; also the lock its readers take
+        private val playhead: ByteBuffer by lazy {
+            nativeGetPlayheadBuffer().order(ByteOrder.nativeOrder())
+        }
+
+        // Registered in JNI_OnLoad. Critical natives skip the JNIEnv and
+        // thread state switch, so a submit costs little more than a C call.
+        @JvmStatic
+        private external fun nativeGetCommandBuffer(): ByteBuffer
+        @JvmStatic @CriticalNative
+        private external fun nativeSubmitCommands(count: Int): Int
+        @JvmStatic @CriticalNative
+        private external fun nativeGetFramePosition(): Long
+        @JvmStatic @CriticalNative
+        private external fun nativeGetSampleRate(): Int
+        @JvmStatic
+        private external fun nativeGetPlayheadBuffer(): ByteBuffer
+        @JvmStatic @CriticalNative
+        private external fun nativeSnapshotPlayhead()
     }
 
     // Native methods
     private external fun nativeLoadSoundFont(path: String): Boolean
+    private external fun nativeLoadSoundFontAsset(assets: AssetManager, name: String): Boolean
     private external fun nativeStart(): Boolean
     private external fun nativeStop()
-    private external fun nativeNoteOn(note: Int, velocity: Float)
-    private external fun nativeNoteOff(note: Int)
-    private external fun nativeAllNotesOff()
-    private external fun nativeSetVolume(volume: Float)
-    private external fun nativeNoteOnChannel(channel: Int, note: Int, velocity: Float)
-    private external fun nativeNoteOffChannel(channel: Int, note: Int)
     private external fun nativeSetChannelPreset(channel: Int, preset: Int, bank: Int)
-    private external fun nativeBatchNoteOn(notes: IntArray, velocities: FloatArray)
+    private external fun nativeGetOutputLatencyMillis(): Double
+    private external fun nativeSetParallelRender(enabled: Boolean): Boolean
+    private external fun nativeSetRenderAhead(bursts: Int)
+    private external fun nativeSetBusGain(bus: Int, gain: Float)
+    private external fun nativeSetBusPan(bus: Int, pan: Float)
+    private external fun nativeGetMixStats(reset: Boolean): DoubleArray
+    private external fun nativeBenchmarkRender(voices: Int, result: DoubleArray)
+    private external fun nativeGetPresetMemory(): LongArray
+    private external fun nativeSetMaxVoices(voices: Int)
+    private external fun nativeGetVoiceStats(resetPeak: Boolean): IntArray
+    private external fun nativeRenderOffline(
+        onsetBeats: DoubleArray,
+        durationBeats: FloatArray,
+        notes: IntArray,
+        velocities: FloatArray,
+        channels: IntArray,
+        tempo: Float,
+        sampleRate: Int,
+        programs: IntArray?
+    ): FloatArray?
+    private external fun nativeRenderOfflineWav(
+        onsetBeats: DoubleArray,
+        durationBeats: FloatArray,
+        notes: IntArray,
+        velocities: FloatArray,
+        channels: IntArray,
+        tempo: Float,
+        sampleRate: Int,
+        programs: IntArray?,
+        path: String,
+        floatSamples: Boolean
+    ): Boolean
+    private external fun nativeSetRenderBudget(fraction: Float)
+    private external fun nativeGetRenderLoad(resetPeak: Boolean): DoubleArray
+    private external fun nativeLoadSequence(
+        onsetBeats: DoubleArray,
+        durationBeats: FloatArray,
+        notes: IntArray,
+        velocities: FloatArray,
+        channels: IntArray
+    )
+    private external fun nativeLoadMidiFile(data: ByteArray): DoubleArray?
+    private external fun nativeSequencerPlay()
+    private external fun nativeSequencerPause()
+    private external fun nativeSequencerStop()
+    private external fun nativeSequencerSeek(beat: Double)
+    private external fun nativeSequencerSetTempo(bpm: Float)
+    private external fun nativeSetTempoMap(beats: DoubleArray, bpms: FloatArray, ramps: BooleanArray)
+    private external fun nativeSetTempoScale(scale: Float)
+    private external fun nativeSequencerSetLoop(startBeat: Double, endBeat: Double)
+    private external fun nativeSequencerClearLoop()
+    private external fun nativeMetronomeStart(countInBeats: Int)
+    private external fun nativeMetronomeStop()
+    private external fun nativeMetronomeSetTempo(bpm: Float)
+    private external fun nativeMetronomeSetBeatsPerMeasure(beats: Int)
+    private external fun nativeMetronomeBeatTimeNanos(beat: Double): Long
+    private external fun nativeMetronomeSetSound(sound: Int)
+    private external fun nativeMetronomeSetAudible(audible: Boolean)
+    private external fun nativePollBeatEvents(
+        beats: IntArray,
+        frames: LongArray,
+        timesNanos: LongArray
+    ): Int
 }
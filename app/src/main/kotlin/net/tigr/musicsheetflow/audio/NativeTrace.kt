@@ -0,0 +1,61 @@
+package net.tigr.musicsheetflow.audio
+
+import java.io.File
+import javax.inject.Inject
+import javax.inject.Singleton
+
+/**
+ * Trace file formats; both open in ui.perfetto.dev
+ */
+enum class TraceFormat(val extension: String) {
+    CHROME_JSON("json"),         // Also chrome://tracing
+    PERFETTO("perfetto-trace")   // Merges with a system trace of the same device
+}
+
+/**
+ * Timeline of the native audio pipeline (trace.h): input and output
+ * callbacks, pitch detection and delivery, synthesis, command queue drains,
+ * voice counts and xruns, per thread.
+ *
+ * While recording, each audio thread keeps its last few seconds in memory,
+ * so a trace written right after a glitch shows the callbacks around it.
+ * The same events go to systrace whenever a system trace is running,
+ * recording or not.
+ */
+@Singleton
+class NativeTrace @Inject constructor() {
+
+    companion object {
+        init {
+            System.loadLibrary("musicsheetflow_native")
+        }
+    }
+
+    val isRecording: Boolean
+        get() = nativeIsRecording()
+
+    /**
+     * Start recording, dropping what an earlier recording held
+     */
+    fun start() = nativeStart()
+
+    /**
+     * Stop recording; what was recorded can still be written
+     */
+    fun stop() = nativeStop()
+
+    /**
+     * Write the recorded events to a file. Blocks for the export (a few MB
+     * at most), so call it off the main thread; recording goes on meanwhile.
+     * @return false if the file could not be written
+     */
+    fun write(file: File, format: TraceFormat = TraceFormat.PERFETTO): Boolean {
+        file.parentFile?.mkdirs()
+        return nativeWrite(file.absolutePath, format == TraceFormat.PERFETTO)
+    }
+
+    private external fun nativeStart()
+    private external fun nativeStop()
+    private external fun nativeIsRecording(): Boolean
+    private external fun nativeWrite(path: String, perfetto: Boolean): Boolean
+}
@@ -5,6 +5,8 @@ import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.coroutines.flow.asStateFlow
 import net.tigr.musicsheetflow.audio.NativeMidiEngine
+import net.tigr.musicsheetflow.audio.TempoChange
+import net.tigr.musicsheetflow.score.parser.MidiScoreBuilder
 import net.tigr.musicsheetflow.score.model.Note
 import net.tigr.musicsheetflow.score.model.Score
 
@@ -31,20 +33,19 @@ private data class ScheduledNote(
     val timestampBeats: Float
 )
 
-/**
- * Group of notes that should play simultaneously.
- */
-private data class NoteGroup(
-    val timestampBeats: Float,
-    val notes: List<ScheduledNote>
-)
-
 /**
  * Plays back a musical score using the MIDI engine.
  *
+ * The score is compiled once into a note list and handed to the native
+ * sequencer, which plays it from the audio callback on the output frame
+ * clock. This class only sends transport commands and polls the shared
+ * playhead to update the UI state.
+ *
  * Features:
- * - Tempo-aware playback
- * - Note scheduling based on score timing
+ * - MusicXML scores and MIDI files
+ * - Tempo-aware playback (live tempo changes)
+ * - Per-note durations (note-offs scheduled natively)
+ * - Seek and loop ranges
  * - Current position tracking for UI
  */
 class ScorePlayer(
@@ -52,18 +53,18 @@ class ScorePlayer(
 ) {
     companion object {
         private const val DEFAULT_TEMPO = 120f
-        private const val MS_PER_MINUTE = 60_000f
-        private const val MIN_NOTE_DURATION_MS = 50L
+        private const val DEFAULT_VELOCITY = 0.8f
+        private const val DEFAULT_CHANNEL = 0
+        private const val UI_POLL_INTERVAL_MS = 16L
     }
 
     private var tempo: Float = DEFAULT_TEMPO
     private var beatsPerMeasure: Int = 4
     private var divisions: Int = 4
     private var scheduledNotes: List<ScheduledNote> = emptyList()
-    private var noteGroups: List<NoteGroup> = emptyList()
+    private var maxDurationBeats: Float = 0f
     private var playbackJob: Job? = null
-    private var startTimeMs: Long = 0
-    private var activeScope: CoroutineScope? = null
+    private var midiProgramsLoaded = false   // A MIDI file set the channel programs
 
     private val _state = MutableStateFlow(PlaybackState())
     val state: StateFlow<PlaybackState> = _state.asStateFlow()
@@ -79,11 +80,17 @@ class ScorePlayer(
         val firstPart = score.parts.first()
         val firstMeasure = firstPart.measures.firstOrNull() ?: return
 
+        if (midiProgramsLoaded) {
+            midiEngine.setChannelPreset(DEFAULT_CHANNEL, 0)
+            midiProgramsLoaded = false
+        }
+
         tempo = (firstMeasure.tempo ?: 120).toFloat()
         beatsPerMeasure = firstMeasure.attributes?.timeBeats ?: 4
         divisions = firstMeasure.attributes?.divisions ?: 4
 
         val notes = mutableListOf<ScheduledNote>()
+        val tempoChanges = mutableListOf(TempoChange(0.0, tempo))
         var globalNoteIndex = 0
 
         // Collect notes from ALL parts
@@ -94,7 +101,10 @@ class ScorePlayer(
                 val measureDivisions = measure.attributes?.divisions ?: divisions
                 val measureBeats = measure.attributes?.timeBeats ?: beatsPerMeasure
 
-                measure.tempo?.let { tempo = it.toFloat() }
+                // Tempo marks come from the first part, as MusicXML places them
+                if (part === firstPart && measureIndex > 0) {
+                    measure.tempo?.let { tempoChanges.add(TempoChange(cumulativeBeats.toDouble(), it.toFloat())) }
+                }
 
                 // Include chord notes (isChord) - they should play with the main note
                 val playableNotes = measure.notes.filter { !it.isRest && !it.isTiedStop }
@@ -127,106 +137,103 @@ class ScorePlayer(
         scheduledNotes = sortedNotes.mapIndexed { idx, note ->
             note.copy(index = idx)
         }
+        maxDurationBeats = scheduledNotes.maxOfOrNull { it.durationBeats } ?: 0f
+
+        // Hand the whole sequence to the native sequencer in one call; it
+        // starts at the first note, so pickups and leading rests are skipped
+        midiEngine.setTempoMap(tempoChanges)
+        midiEngine.loadSequence(
+            onsetBeats = DoubleArray(scheduledNotes.size) { scheduledNotes[it].timestampBeats.toDouble() },
+            durationBeats = FloatArray(scheduledNotes.size) { scheduledNotes[it].durationBeats },
+            notes = IntArray(scheduledNotes.size) { scheduledNotes[it].midiNote },
+            velocities = FloatArray(scheduledNotes.size) { DEFAULT_VELOCITY },
+            channels = IntArray(scheduledNotes.size) { DEFAULT_CHANNEL }
+        )
 
-        // Group notes by timestamp (within 0.01 beats tolerance for simultaneous notes)
-        val groups = mutableListOf<NoteGroup>()
-        var currentGroup = mutableListOf<ScheduledNote>()
-        var currentTimestamp = -1f
-
-        scheduledNotes.forEach { note ->
-            if (currentTimestamp < 0 || kotlin.math.abs(note.timestampBeats - currentTimestamp) < 0.01f) {
-                currentGroup.add(note)
-                if (currentTimestamp < 0) currentTimestamp = note.timestampBeats
-            } else {
-                if (currentGroup.isNotEmpty()) {
-                    groups.add(NoteGroup(currentTimestamp, currentGroup.toList()))
-                }
-                currentGroup = mutableListOf(note)
-                currentTimestamp = note.timestampBeats
-            }
-        }
-        if (currentGroup.isNotEmpty()) {
-            groups.add(NoteGroup(currentTimestamp, currentGroup.toList()))
+        _state.value = PlaybackState(
+            isPlaying = false,
+            currentNoteIndex = 0,
+            totalNotes = scheduledNotes.size
+        )
+    }
+
+    /**
+     * Load a Standard MIDI File for playback. The native engine parses it and
+     * loads its sequencer directly; the notes come back for the UI state.
+     * @return A score built from the file for tracking and display, or null
+     *         if the file cannot be read
+     */
+    suspend fun loadMidiFile(data: ByteArray, title: String): Score? {
+        stop()
+
+        val sequence = midiEngine.loadMidiFile(data) ?: return null
+        midiProgramsLoaded = true
+
+        tempo = sequence.tempos.first().bpm
+        scheduledNotes = List(sequence.notes.size) {
+            ScheduledNote(
+                index = it,
+                midiNote = sequence.notes[it],
+                durationBeats = sequence.durationBeats[it],
+                timestampBeats = sequence.onsetBeats[it].toFloat()
+            )
         }
-        noteGroups = groups
+        maxDurationBeats = scheduledNotes.maxOfOrNull { it.durationBeats } ?: 0f
 
         _state.value = PlaybackState(
             isPlaying = false,
             currentNoteIndex = 0,
             totalNotes = scheduledNotes.size
         )
+        return MidiScoreBuilder().build(title, sequence)
     }
 
     /**
-     * Set playback tempo in BPM.
-     * Note: Timing is stored in beats, so tempo changes apply automatically.
+     * Set playback tempo in BPM for the opening of the piece; later tempo
+     * marks scale with it. The sequencer keeps its position in beats, so
+     * this applies live.
      */
     fun setTempo(bpm: Float) {
-        val wasPlaying = _state.value.isPlaying
-        val savedScope = activeScope
-        if (wasPlaying) {
-            stop()
-        }
-
         tempo = bpm.coerceIn(20f, 300f)
-
-        if (wasPlaying && savedScope != null) {
-            start(savedScope)
-        }
+        midiEngine.sequencerSetTempo(tempo)
     }
 
     /**
      * Start playback from current position.
-     * Groups simultaneous notes together to reduce mutex contention.
+     * The scope only runs the UI position polling; timing is native.
      */
     fun start(scope: CoroutineScope) {
         if (_state.value.isPlaying) return
-        if (noteGroups.isEmpty()) return
+        if (scheduledNotes.isEmpty()) return
 
-        activeScope = scope
+        // Snapshots published before the play command was consumed are stale
+        val commandFrame = midiEngine.readSequencerPosition().frame
+        midiEngine.sequencerPlay()
         _state.value = _state.value.copy(isPlaying = true)
-        startTimeMs = System.currentTimeMillis()
 
+        playbackJob?.cancel()
         playbackJob = scope.launch {
-            if (noteGroups.isEmpty()) {
-                stop()
-                return@launch
-            }
-
-            val baseTimestampBeats = noteGroups.first().timestampBeats
-
-            noteGroups.forEach { group ->
-                val groupTimestampMs = beatToMs(group.timestampBeats - baseTimestampBeats)
-                val delayMs = groupTimestampMs - (System.currentTimeMillis() - startTimeMs)
+            var lastFrame = -1L
+            var elapsedMs = _state.value.elapsedMs
+
+            while (isActive) {
+                val position = midiEngine.readSequencerPosition()
+                if (position.frame > commandFrame) {
+                    if (lastFrame >= 0) {
+                        val sampleRate = midiEngine.getSampleRate().coerceAtLeast(1)
+                        elapsedMs += (position.frame - lastFrame) * 1000 / sampleRate
+                    }
+                    lastFrame = position.frame
 
-                if (delayMs > 0) {
-                    delay(delayMs)
+                    if (!position.isPlaying) {
+                        // Sequencer reached the end and released every note
+                        stop()
+                        return@launch
+                    }
+                    updatePosition(position.beat, position.noteIndex, elapsedMs)
                 }
-
-                if (!isActive) return@launch
-
-                // Play all notes in this group using batch method (single mutex lock)
-                // This significantly reduces audio dropouts from mutex contention
-                val midiNotes = group.notes.map { it.midiNote }
-                val notesToPlay = midiNotes.map { it to 0.8f }
-                midiEngine.batchNoteOn(notesToPlay)
-
-                // Update UI state with currently playing notes
-                _state.value = _state.value.copy(
-                    currentBeat = group.timestampBeats,
-                    elapsedMs = System.currentTimeMillis() - startTimeMs,
-                    playingMidiNotes = midiNotes.toSet()
-                )
-            }
-
-            // Wait a bit for final notes to sound, then stop
-            val lastGroup = noteGroups.lastOrNull()
-            if (lastGroup != null) {
-                val avgDuration = lastGroup.notes.map { it.durationBeats }.average().toFloat()
-                delay(beatToMs(avgDuration).coerceAtLeast(500L))
+                delay(UI_POLL_INTERVAL_MS)
             }
-
-            stop()
         }
     }
 
@@ -236,7 +243,7 @@ class ScorePlayer(
     fun pause() {
         playbackJob?.cancel()
         playbackJob = null
-        midiEngine.allNotesOff()
+        midiEngine.sequencerPause()
         _state.value = _state.value.copy(
             isPlaying = false,
             playingMidiNotes = emptySet()
@@ -247,10 +254,9 @@ class ScorePlayer(
      * Stop playback and reset to beginning.
      */
     fun stop() {
-        activeScope = null
         playbackJob?.cancel()
         playbackJob = null
-        midiEngine.allNotesOff()
+        midiEngine.sequencerStop()
         _state.value = _state.value.copy(
             isPlaying = false,
             currentNoteIndex = 0,
@@ -260,18 +266,40 @@ class ScorePlayer(
     }
 
     /**
-     * Seek to a specific note index.
+     * Seek to a specific note index. Playback continues from there if running.
      */
     fun seekToNote(index: Int) {
-        val wasPlaying = _state.value.isPlaying
-        if (wasPlaying) {
-            pause()
-        }
+        if (scheduledNotes.isEmpty()) return
+        val target = index.coerceIn(0, scheduledNotes.size - 1)
+        val beat = scheduledNotes[target].timestampBeats
+        midiEngine.sequencerSeek(beat.toDouble())
         _state.value = _state.value.copy(
-            currentNoteIndex = index.coerceIn(0, scheduledNotes.size - 1)
+            currentNoteIndex = target,
+            currentBeat = beat,
+            playingMidiNotes = emptySet()
         )
     }
 
+    /**
+     * Loop playback over a range of notes (inclusive), ending when the last
+     * note of the range is released.
+     */
+    fun setLoop(fromNote: Int, toNote: Int) {
+        if (scheduledNotes.isEmpty()) return
+        val first = scheduledNotes[fromNote.coerceIn(0, scheduledNotes.size - 1)]
+        val last = scheduledNotes[toNote.coerceIn(0, scheduledNotes.size - 1)]
+        val startBeat = first.timestampBeats
+        val endBeat = last.timestampBeats + last.durationBeats
+        midiEngine.sequencerSetLoop(startBeat.toDouble(), endBeat.toDouble())
+    }
+
+    /**
+     * Remove the loop range; playback runs to the end of the score.
+     */
+    fun clearLoop() {
+        midiEngine.sequencerClearLoop()
+    }
+
     /**
      * Toggle play/pause.
      */
@@ -283,7 +311,25 @@ class ScorePlayer(
         }
     }
 
-    private fun beatToMs(beats: Float): Long {
-        return ((beats / tempo) * MS_PER_MINUTE).toLong()
+    private fun updatePosition(sequenceBeat: Double, noteIndex: Int, elapsedMs: Long) {
+        val beat = sequenceBeat.toFloat()
+
+        // Notes sounding at this beat: started already and not yet released
+        val sounding = mutableSetOf<Int>()
+        var i = noteIndex
+        while (i >= 0 && scheduledNotes[i].timestampBeats >= beat - maxDurationBeats) {
+            val note = scheduledNotes[i]
+            if (note.timestampBeats + note.durationBeats > beat) {
+                sounding.add(note.midiNote)
+            }
+            i--
+        }
+
+        _state.value = _state.value.copy(
+            currentNoteIndex = noteIndex.coerceAtLeast(0),
+            currentBeat = beat,
+            elapsedMs = elapsedMs,
+            playingMidiNotes = sounding
+        )
     }
 }
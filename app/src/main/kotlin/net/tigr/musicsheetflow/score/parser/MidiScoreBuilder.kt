@@ -0,0 +1,101 @@
+package net.tigr.musicsheetflow.score.parser
+
+import net.tigr.musicsheetflow.audio.MidiSequence
+import net.tigr.musicsheetflow.score.model.*
+import kotlin.math.roundToInt
+
+/**
+ * Builds a [Score] from a MIDI file's notes, so MIDI pieces can be tracked
+ * and displayed like MusicXML ones.
+ *
+ * MIDI carries no notation, so the score is an approximation: measures are
+ * 4/4 (tml drops time signatures), pitches are spelled with sharps, notes
+ * from middle C up go on the treble staff, and at each onset the highest
+ * note leads and the rest are chord notes. Percussion is left out.
+ */
+class MidiScoreBuilder {
+
+    companion object {
+        private const val DIVISIONS = 96          // Per quarter note; matches the native beat grid
+        private const val BEATS_PER_MEASURE = 4
+        private const val PERCUSSION_CHANNEL = 9
+        private const val MIDDLE_C = 60
+
+        private val STEPS = charArrayOf('C', 'C', 'D', 'D', 'E', 'F', 'F', 'G', 'G', 'A', 'A', 'B')
+        private val ALTERS = intArrayOf(0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 1, 0)
+    }
+
+    fun build(title: String, sequence: MidiSequence): Score {
+        val measureDivisions = DIVISIONS * BEATS_PER_MEASURE
+        val measureCount = maxOf(1, (sequence.lengthBeats / BEATS_PER_MEASURE).toInt() + 1)
+
+        // Highest note first at each onset, so it leads its chord
+        val order = sequence.onsetBeats.indices
+            .filter { sequence.channels[it] != PERCUSSION_CHANNEL }
+            .sortedWith(compareBy({ sequence.onsetBeats[it] }, { -sequence.notes[it] }))
+
+        val measureNotes = List(measureCount) { mutableListOf<Note>() }
+        var previousOnset = -1
+        for (i in order) {
+            val onset = (sequence.onsetBeats[i] * DIVISIONS).roundToInt()
+            val measureIndex = (onset / measureDivisions).coerceAtMost(measureCount - 1)
+            val midi = sequence.notes[i]
+            val duration = maxOf(1, (sequence.durationBeats[i] * DIVISIONS).roundToInt())
+            measureNotes[measureIndex].add(Note(
+                pitch = Pitch(STEPS[midi % 12], midi / 12 - 1, ALTERS[midi % 12]),
+                duration = duration,
+                voice = 1,
+                staff = if (midi >= MIDDLE_C) 1 else 2,
+                type = noteType(duration),
+                isRest = false,
+                isChord = onset == previousOnset,
+                isTiedStart = false,
+                isTiedStop = false,
+                measureNumber = measureIndex + 1,
+                positionInMeasure = onset - measureIndex * measureDivisions
+            ))
+            previousOnset = onset
+        }
+
+        val measures = measureNotes.mapIndexed { index, notes ->
+            Measure(
+                number = index + 1,
+                attributes = if (index == 0) firstAttributes() else null,
+                notes = notes,
+                tempo = tempoInMeasure(sequence, index)
+            )
+        }
+        return Score(
+            title = title,
+            composer = "",
+            parts = listOf(Part(id = "P1", name = "MIDI", measures = measures))
+        )
+    }
+
+    private fun firstAttributes() = MeasureAttributes(
+        divisions = DIVISIONS,
+        keyFifths = 0,
+        timeBeats = BEATS_PER_MEASURE,
+        timeBeatType = 4,
+        staves = 2,
+        clefs = listOf(Clef(1, "G", 2), Clef(2, "F", 4))
+    )
+
+    // The first tempo change inside a measure, as MusicXML marks it
+    private fun tempoInMeasure(sequence: MidiSequence, index: Int): Int? {
+        val start = index * BEATS_PER_MEASURE.toDouble()
+        return sequence.tempos
+            .firstOrNull { it.beat >= start && it.beat < start + BEATS_PER_MEASURE }
+            ?.bpm?.roundToInt()
+    }
+
+    private fun noteType(duration: Int): NoteType = when {
+        duration >= DIVISIONS * 4 -> NoteType.WHOLE
+        duration >= DIVISIONS * 2 -> NoteType.HALF
+        duration >= DIVISIONS -> NoteType.QUARTER
+        duration >= DIVISIONS / 2 -> NoteType.EIGHTH
+        duration >= DIVISIONS / 4 -> NoteType.SIXTEENTH
+        duration >= DIVISIONS / 8 -> NoteType.THIRTY_SECOND
+        else -> NoteType.SIXTY_FOURTH
+    }
+}
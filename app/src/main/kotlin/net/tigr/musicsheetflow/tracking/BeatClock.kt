@@ -48,6 +48,11 @@ data class BeatClockState(
  * - Current beat position
  * - Expected timestamps for each note
  * - Timing offsets when notes are played
+ *
+ * Tempo marks in the score change the beat length from their measure on;
+ * the tempo set here is the opening tempo and scales the later marks.
+ * When [beatTimeSource] is set, expected times come from it instead, so
+ * judgements follow the audio clock that plays the clicks.
  */
 class BeatClock {
 
@@ -57,6 +62,8 @@ class BeatClock {
     }
 
     private var tempo: Float = DEFAULT_TEMPO
+    private var scoreTempo: Float = DEFAULT_TEMPO   // Opening tempo as written
+    private var tempoChanges: List<Pair<Float, Float>> = emptyList()  // (beat, BPM) as written
     private var beatsPerMeasure: Int = 4
     private var divisions: Int = 4  // Divisions per quarter note
     private var startTimeNs: Long = 0
@@ -79,6 +86,13 @@ class BeatClock {
     private val _beatTicks = MutableSharedFlow<BeatTick>(extraBufferCapacity = 16)
     val beatTicks: SharedFlow<BeatTick> = _beatTicks.asSharedFlow()
 
+    /**
+     * When a score beat is heard, in System.nanoTime(), or null if unknown,
+     * e.g. NativeMidiEngine.metronomeBeatTimeNanos. Falls back to the
+     * clock's own tempo timeline when unset or null.
+     */
+    var beatTimeSource: ((Double) -> Long?)? = null
+
     /**
      * Load a score and calculate expected timing for each note.
      */
@@ -91,18 +105,28 @@ class BeatClock {
         beatsPerMeasure = firstMeasure.attributes?.timeBeats ?: 4
         divisions = firstMeasure.attributes?.divisions ?: 4
 
+        scoreTempo = tempo
+
+        // Tempo marks after the opening change the beat length from their measure on
+        val changes = mutableListOf(0f to tempo)
+        var markBeats = 0f
+        part.measures.forEachIndexed { measureIndex, measure ->
+            if (measureIndex > 0) {
+                measure.tempo?.let { changes.add(markBeats to it.toFloat()) }
+            }
+            markBeats += measure.attributes?.timeBeats ?: beatsPerMeasure
+        }
+        tempoChanges = changes
+
         // Calculate timing for each playable note
         val timings = mutableListOf<NoteTiming>()
         var globalNoteIndex = 0
         var cumulativeBeats = 0f
 
-        part.measures.forEachIndexed { measureIndex, measure ->
+        part.measures.forEach { measure ->
             val measureDivisions = measure.attributes?.divisions ?: divisions
             val measureBeats = measure.attributes?.timeBeats ?: beatsPerMeasure
 
-            // Update tempo if changed
-            measure.tempo?.let { tempo = it.toFloat() }
-
             val playableNotes = measure.notes.filter { !it.isRest && !it.isChord && !it.isTiedStop }
 
             playableNotes.forEach { note ->
@@ -131,7 +155,7 @@ class BeatClock {
     }
 
     /**
-     * Set the tempo in BPM.
+     * Set the opening tempo in BPM; later tempo marks scale with it.
      */
     fun setTempo(bpm: Float) {
         tempo = bpm.coerceIn(20f, 300f)
@@ -146,12 +170,13 @@ class BeatClock {
 
     /**
      * Start the beat clock.
+     * @param startTimeNs When beat 0 is heard, e.g. from a native metronome beat
      */
-    fun start(scope: CoroutineScope) {
+    fun start(scope: CoroutineScope, startTimeNs: Long = System.nanoTime()) {
         if (isRunning) return
 
         isRunning = true
-        startTimeNs = System.nanoTime()
+        this.startTimeNs = startTimeNs
         currentNoteIndex = 0
 
         _state.value = _state.value.copy(
@@ -167,7 +192,7 @@ class BeatClock {
                 val elapsedNs = System.nanoTime() - startTimeNs
                 val currentBeat = timestampToBeat(elapsedNs).toInt()
 
-                if (currentBeat > lastBeat) {
+                if (elapsedNs >= 0 && currentBeat > lastBeat) {
                     lastBeat = currentBeat
                     val measure = (currentBeat / beatsPerMeasure) + 1
                     val beatInMeasure = (currentBeat % beatsPerMeasure) + 1
@@ -239,8 +264,7 @@ class BeatClock {
     fun calculateTimingOffset(noteIndex: Int, playedTimestampNs: Long): Int {
         val timing = noteTimings.getOrNull(noteIndex) ?: return 0
 
-        // Calculate expected timestamp relative to start time
-        val expectedAbsoluteNs = startTimeNs + timing.expectedTimestampNs
+        val expectedAbsoluteNs = expectedTimeNs(timing)
         val offsetNs = playedTimestampNs - expectedAbsoluteNs
 
         return (offsetNs / 1_000_000).toInt()  // Convert to milliseconds
@@ -269,7 +293,7 @@ class BeatClock {
         if (!isRunning) return 0
 
         val timing = noteTimings.getOrNull(currentNoteIndex) ?: return 0
-        val expectedAbsoluteNs = startTimeNs + timing.expectedTimestampNs
+        val expectedAbsoluteNs = expectedTimeNs(timing)
         val nowNs = System.nanoTime()
 
         return ((expectedAbsoluteNs - nowNs) / 1_000_000).coerceAtLeast(0)
@@ -285,19 +309,46 @@ class BeatClock {
      */
     fun getTempo(): Float = tempo
 
+    /**
+     * When a note is expected, in System.nanoTime().
+     */
+    private fun expectedTimeNs(timing: NoteTiming): Long {
+        return beatTimeSource?.invoke(timing.expectedBeat.toDouble())
+            ?: (startTimeNs + timing.expectedTimestampNs)
+    }
+
+    /**
+     * Nanoseconds per beat for a written tempo at the current practice tempo.
+     */
+    private fun nsPerBeat(bpm: Float): Float = NS_PER_MINUTE / (bpm * tempo / scoreTempo)
+
     /**
      * Convert beat number to timestamp in nanoseconds.
      */
     private fun beatToTimestamp(beat: Float): Long {
-        val nsPerBeat = NS_PER_MINUTE / tempo
-        return (beat * nsPerBeat).toLong()
+        var ns = 0f
+        for ((index, change) in tempoChanges.withIndex()) {
+            val end = tempoChanges.getOrNull(index + 1)?.first ?: Float.MAX_VALUE
+            if (beat <= change.first) break
+            ns += (minOf(beat, end) - change.first) * nsPerBeat(change.second)
+        }
+        // Beats before the start (none in a score) run at the opening tempo
+        return if (beat < 0f) (beat * nsPerBeat(scoreTempo)).toLong() else ns.toLong()
     }
 
     /**
      * Convert timestamp to beat number.
      */
     private fun timestampToBeat(timestampNs: Long): Float {
-        val nsPerBeat = NS_PER_MINUTE / tempo
-        return timestampNs / nsPerBeat
+        var remainingNs = timestampNs.toFloat()
+        for ((index, change) in tempoChanges.withIndex()) {
+            val end = tempoChanges.getOrNull(index + 1)?.first ?: Float.MAX_VALUE
+            val segmentNs = (end - change.first) * nsPerBeat(change.second)
+            if (remainingNs < segmentNs || index == tempoChanges.size - 1) {
+                return change.first + remainingNs / nsPerBeat(change.second)
+            }
+            remainingNs -= segmentNs
+        }
+        return timestampNs / nsPerBeat(scoreTempo)
     }
 }
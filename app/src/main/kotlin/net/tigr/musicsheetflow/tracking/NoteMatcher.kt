@@ -85,9 +85,9 @@ class NoteMatcher(
     /**
      * Start accepting pitch events.
      */
-    fun start(scope: CoroutineScope) {
+    fun start(scope: CoroutineScope, startTimeNs: Long = System.nanoTime()) {
         isActive = true
-        beatClock.start(scope)
+        beatClock.start(scope, startTimeNs)
     }
 
     /**
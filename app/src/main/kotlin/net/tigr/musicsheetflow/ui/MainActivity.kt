@@ -39,6 +39,7 @@ import dagger.hilt.android.AndroidEntryPoint
 import kotlinx.coroutines.launch
 import net.tigr.musicsheetflow.audio.NativeAudioEngine
 import net.tigr.musicsheetflow.audio.NativeMidiEngine
+import net.tigr.musicsheetflow.audio.NativeTrace
 import net.tigr.musicsheetflow.audio.PitchEvent
 import net.tigr.musicsheetflow.score.ScoreRepository
 import net.tigr.musicsheetflow.score.model.Score
@@ -194,6 +195,7 @@ fun MainScreen(
 
     // Initialize Audio engine for pitch detection
     val audioEngine = remember { NativeAudioEngine() }
+    val nativeTrace = remember { NativeTrace() }
     var audioStarted by remember { mutableStateOf(false) }
     var currentPitch by remember { mutableStateOf<PitchEvent?>(null) }
 
@@ -232,6 +234,7 @@ fun MainScreen(
     var confidenceThreshold by remember { mutableFloatStateOf(0.3f) }
     var silenceThreshold by remember { mutableFloatStateOf(-50f) }
     var noiseGateThreshold by remember { mutableFloatStateOf(-46f) }
+    var recordAudioTrace by remember { mutableStateOf(false) }  // Diagnostics, off by default
 
     // Score playback
     val scorePlayer = remember { ScorePlayer(midiEngine) }
@@ -243,7 +246,11 @@ fun MainScreen(
         midiReady = midiEngine.loadBundledSoundFont(context)
         if (midiReady) {
             midiEngine.start()
-            android.util.Log.i("MainScreen", "MIDI engine started")
+            // Judge timing against the metronome's clock and the score's tempo map
+            noteMatcher.getBeatClock().beatTimeSource = { midiEngine.metronomeBeatTimeNanos(it) }
+            val parallelRender = midiEngine.setParallelRender(true)
+            android.util.Log.i("MainScreen", "MIDI engine started: latency=%.1f ms, parallel render=%s".format(
+                midiEngine.getOutputLatencyMs(), parallelRender))
         }
     }
 
@@ -289,6 +296,7 @@ fun MainScreen(
         if (audioStarted) {
             android.util.Log.i("MainScreen", "Starting pitch events collection")
             audioEngine.pitchEvents.collect { event ->
+                audioEngine.recordConsumed(event)
                 currentPitch = event
                 // Clear wrong note highlight when new pitch is detected (will be re-evaluated by feedback)
                 if (isPracticeMode && event.midiNote >= 0) {
@@ -301,6 +309,34 @@ fun MainScreen(
         }
     }
 
+    // Audio thread trace, recorded only while opted in from the pitch settings
+    // and the microphone runs
+    DisposableEffect(audioStarted, recordAudioTrace) {
+        if (audioStarted && recordAudioTrace) nativeTrace.start()
+        onDispose { nativeTrace.stop() }
+    }
+
+    // Check the sound-to-feedback latency budget in the field, per interval.
+    // While the trace records, an interval over budget writes out its last
+    // few seconds, keeping the newest MAX_LATENCY_TRACES files.
+    LaunchedEffect(audioStarted) {
+        while (audioStarted) {
+            kotlinx.coroutines.delay(30_000)
+            val report = audioEngine.getLatencyReport(reset = true)
+            if (report.total.count == 0L) continue
+            if (report.withinBudget()) {
+                android.util.Log.i("MainScreen", "Pitch latency:\n$report")
+            } else {
+                android.util.Log.w("MainScreen", "Pitch latency over budget:\n$report")
+                if (!nativeTrace.isRecording) continue
+                val file = kotlinx.coroutines.withContext(kotlinx.coroutines.Dispatchers.IO) {
+                    writeLatencyTrace(nativeTrace, java.io.File(context.cacheDir, "traces"))
+                }
+                if (file != null) android.util.Log.w("MainScreen", "Audio trace written to $file")
+            }
+        }
+    }
+
     // Collect match feedback and update session stats
     LaunchedEffect(Unit) {
         noteMatcher.feedback.collect { feedback ->
@@ -333,13 +369,11 @@ fun MainScreen(
         }
     }
 
-    // Collect beat ticks for metronome
+    // Metronome clicks are generated natively on the audio clock; the
+    // toggle only controls whether practice beats are audible
     LaunchedEffect(isMetronomeEnabled, midiReady) {
-        if (isMetronomeEnabled && midiReady) {
-            noteMatcher.getBeatClock().beatTicks.collect { tick ->
-                val isDownbeat = tick.beatInMeasure == 1
-                midiEngine.playMetronomeClick(isDownbeat)
-            }
+        if (midiReady) {
+            midiEngine.metronomeSetAudible(isMetronomeEnabled)
         }
     }
 
@@ -380,47 +414,63 @@ fun MainScreen(
             isCountingIn = false
             countInBeat = 0
             isPracticeMode = false
+            midiEngine.metronomeStop()
             noteMatcher.stop()
             return
         }
 
         // Reset session stats for new practice
         sessionStats = SessionStats()
+        noteMatcher.reset()
 
-        // Start count-in if enabled
-        if (countInMeasures > 0 && midiReady) {
-            isCountingIn = true
-            noteMatcher.reset()
-
-            val beatsPerMeasure = currentScore?.parts?.firstOrNull()?.measures?.firstOrNull()
-                ?.attributes?.timeBeats ?: 4
-            val tempo = beatClockState?.tempo ?: 120f
-            val beatDurationMs = (60_000f / tempo).toLong()
-            val totalBeats = countInMeasures * beatsPerMeasure
-
-            countInJobRef["job"] = scope.launch {
-                try {
-                    for (beat in 1..totalBeats) {
-                        countInBeat = beat
-                        val isDownbeat = (beat - 1) % beatsPerMeasure == 0
-                        midiEngine.playMetronomeClick(isDownbeat)
-                        kotlinx.coroutines.delay(beatDurationMs)
-                    }
+        if (!midiReady) {
+            // No audio output, so no metronome: start practice immediately
+            isPracticeMode = true
+            noteMatcher.start(scope)
+            return
+        }
 
-                    // Count-in finished, start practice
-                    isCountingIn = false
-                    countInBeat = 0
-                    isPracticeMode = true
-                    noteMatcher.start(scope)
-                } finally {
-                    countInJobRef["job"] = null
+        // Count-in and practice beats come from the native metronome. Practice
+        // starts at the time beat 0 is heard, so timing offsets line up with
+        // the clicks regardless of UI thread delays.
+        val beatsPerMeasure = currentScore?.parts?.firstOrNull()?.measures?.firstOrNull()
+            ?.attributes?.timeBeats ?: 4
+        val tempo = beatClockState?.tempo ?: 120f
+        val totalBeats = countInMeasures * beatsPerMeasure
+
+        midiEngine.pollMetronomeBeats()  // Discard beats left from a previous run
+        midiEngine.metronomeSetTempo(tempo)
+        midiEngine.metronomeSetBeatsPerMeasure(beatsPerMeasure)
+        midiEngine.metronomeSetAudible(isMetronomeEnabled)
+        midiEngine.metronomeStart(countInBeats = totalBeats)
+        isCountingIn = totalBeats > 0
+
+        countInJobRef["job"] = scope.launch {
+            try {
+                while (true) {
+                    for (beat in midiEngine.pollMetronomeBeats()) {
+                        // Beats are reported when rendered; show them when heard
+                        val untilHeardMs = (beat.timestampNs - System.nanoTime()) / 1_000_000
+                        if (untilHeardMs > 0) {
+                            kotlinx.coroutines.delay(untilHeardMs)
+                        }
+
+                        if (beat.beat < 0) {
+                            countInBeat = beat.beat + totalBeats + 1
+                        } else {
+                            // Count-in finished, start practice
+                            isCountingIn = false
+                            countInBeat = 0
+                            isPracticeMode = true
+                            noteMatcher.start(scope, startTimeNs = beat.timestampNs)
+                            return@launch
+                        }
+                    }
+                    kotlinx.coroutines.delay(10)
                 }
+            } finally {
+                countInJobRef["job"] = null
             }
-        } else {
-            // No count-in, start practice immediately
-            noteMatcher.reset()
-            isPracticeMode = true
-            noteMatcher.start(scope)
         }
     }
 
@@ -429,6 +479,7 @@ fun MainScreen(
         // Stop practice mode if active
         if (isPracticeMode) {
             isPracticeMode = false
+            midiEngine.metronomeStop()
             noteMatcher.stop()
         }
         scorePlayer.togglePlayback(scope)
@@ -520,11 +571,13 @@ fun MainScreen(
             onSkipNote = { noteMatcher.skipCurrentNote(scope) },
             onRestart = {
                 scorePlayer.stop()
+                midiEngine.metronomeStop()
                 noteMatcher.reset()
                 lastFeedback = null
             },
             onTempoChange = { newTempo ->
                 noteMatcher.getBeatClock().setTempo(newTempo)
+                midiEngine.metronomeSetTempo(newTempo)
                 scorePlayer.setTempo(newTempo)
             },
             onToggleMetronome = { isMetronomeEnabled = !isMetronomeEnabled },
@@ -549,6 +602,7 @@ fun MainScreen(
                 confidenceThreshold = confidenceThreshold,
                 silenceThreshold = silenceThreshold,
                 noiseGateThreshold = noiseGateThreshold,
+                recordAudioTrace = recordAudioTrace,
                 onConfidenceChange = { value ->
                     confidenceThreshold = value
                     audioEngine.setConfidenceThreshold(value)
@@ -561,12 +615,32 @@ fun MainScreen(
                     noiseGateThreshold = value
                     audioEngine.setNoiseGateThreshold(value)
                 },
+                onRecordAudioTraceChange = { recordAudioTrace = it },
                 onDismiss = { showPitchSettings = false }
             )
         }
     }
 }
 
+// Over-budget audio traces kept in the cache, oldest deleted first
+private const val MAX_LATENCY_TRACES = 3
+
+/**
+ * Write the recorded audio trace to a new timestamped file in [dir], then
+ * delete all but the newest [MAX_LATENCY_TRACES]. Blocks for the export.
+ * @return the file written, or null if it could not be
+ */
+private fun writeLatencyTrace(trace: NativeTrace, dir: java.io.File): java.io.File? {
+    val stamp = java.text.SimpleDateFormat("yyyyMMdd-HHmmss", java.util.Locale.US).format(java.util.Date())
+    val file = java.io.File(dir, "pitch-latency-$stamp.perfetto-trace")
+    if (!trace.write(file)) return null
+    dir.listFiles { f -> f.name.startsWith("pitch-latency") }
+        ?.sortedByDescending { it.lastModified() }
+        ?.drop(MAX_LATENCY_TRACES)
+        ?.forEach { it.delete() }
+    return file
+}
+
 @Composable
 fun SessionSummaryDialog(
     stats: SessionStats,
@@ -1204,12 +1278,13 @@ fun InteractiveKeyboard(
                         isPlaying = midiNote in playingMidiNotes,  // Show playback notes
                         enabled = midiReady,
                         onKeyPress = {
-                            // Turn off previous note first
-                            if (pressedKey >= 0) {
-                                midiEngine?.noteOff(pressedKey)
+                            // Turn off previous note first, in the same native call
+                            val previousKey = pressedKey
+                            midiEngine?.commands {
+                                if (previousKey >= 0) noteOff(0, previousKey)
+                                noteOn(0, midiNote, 0.8f)
                             }
                             pressedKey = midiNote
-                            midiEngine?.noteOn(midiNote, 0.8f)
                         }
                     )
                 }
@@ -1358,9 +1433,12 @@ fun FullPianoKeyboard(
                                     RoundedCornerShape(bottomStart = 4.dp, bottomEnd = 4.dp)
                                 )
                                 .clickable(enabled = midiReady) {
-                                    if (pressedKey >= 0) midiEngine?.noteOff(pressedKey)
+                                    val previousKey = pressedKey
+                                    midiEngine?.commands {
+                                        if (previousKey >= 0) noteOff(0, previousKey)
+                                        noteOn(0, midiNote, 0.8f)
+                                    }
                                     pressedKey = midiNote
-                                    midiEngine?.noteOn(midiNote, 0.8f)
                                 },
                             contentAlignment = Alignment.BottomCenter
                         ) {
@@ -1416,9 +1494,12 @@ fun FullPianoKeyboard(
                                         RoundedCornerShape(bottomStart = 3.dp, bottomEnd = 3.dp)
                                     )
                                     .clickable(enabled = midiReady) {
-                                        if (pressedKey >= 0) midiEngine?.noteOff(pressedKey)
+                                        val previousKey = pressedKey
+                                        midiEngine?.commands {
+                                            if (previousKey >= 0) noteOff(0, previousKey)
+                                            noteOn(0, blackNote, 0.8f)
+                                        }
                                         pressedKey = blackNote
-                                        midiEngine?.noteOn(blackNote, 0.8f)
                                     }
                             )
                         }
@@ -1958,9 +2039,11 @@ fun PitchSettingsDialog(
     confidenceThreshold: Float,
     silenceThreshold: Float,
     noiseGateThreshold: Float,
+    recordAudioTrace: Boolean,
     onConfidenceChange: (Float) -> Unit,
     onSilenceChange: (Float) -> Unit,
     onNoiseGateChange: (Float) -> Unit,
+    onRecordAudioTraceChange: (Boolean) -> Unit,
     onDismiss: () -> Unit
 ) {
     AlertDialog(
@@ -2066,6 +2149,31 @@ fun PitchSettingsDialog(
                         )
                     )
                 }
+
+                HorizontalDivider()
+
+                // Audio trace recording (diagnostics)
+                Row(
+                    modifier = Modifier.fillMaxWidth(),
+                    horizontalArrangement = Arrangement.SpaceBetween,
+                    verticalAlignment = Alignment.CenterVertically
+                ) {
+                    Column(modifier = Modifier.weight(1f)) {
+                        Text("Record Audio Trace", fontSize = 14.sp)
+                        Text(
+                            "Saves a trace when latency goes over budget",
+                            fontSize = 10.sp,
+                            color = Color.Gray
+                        )
+                    }
+                    Switch(
+                        checked = recordAudioTrace,
+                        onCheckedChange = onRecordAudioTraceChange,
+                        colors = SwitchDefaults.colors(
+                            checkedTrackColor = MusicSheetFlowColors.CurrentNote
+                        )
+                    )
+                }
             }
         },
         confirmButton = {